@@ -5,16 +5,97 @@ uniform sampler2D backTexture;
 uniform sampler2D frontDepth;
 uniform sampler2D backDepth;
 
+// Upsampling of the cloud image, see CloudUpsample: 0 bilinear, 1 bilateral.
+uniform int upsampleMode = 1;
+uniform float depthTolerance = 0.1;
+uniform float maxDepth = 750;
+
 in vec2 textureCoords;
 
 out vec3 color;
 
+float relativeDifference(float a, float b) {
+  a = min(a, maxDepth);
+  b = min(b, maxDepth);
+
+  return abs(a - b) / max(min(a, b), 1e-3);
+}
+
+// Cloud layer premultiplied by alpha, weighted by agreement of the scene
+// depth each cloud sample was marched against with the depth of the pixel.
+vec4 upsampleBilateral(ivec2 pixel, float pixelDepth) {
+  ivec2 screenSize = textureSize(backDepth, 0);
+  ivec2 cloudSize = textureSize(frontTexture, 0);
+  int downsample = int(ceil(float(screenSize.x) / float(cloudSize.x)));
+
+  // Cloud sample x, y is marched along the ray of pixel x, y * downsample.
+  vec2 u = vec2(pixel) * vec2(cloudSize) / vec2(screenSize);
+  ivec2 base = ivec2(floor(u));
+  vec2 f = u - vec2(base);
+
+  float weights[4] = float[4](
+    (1 - f.x) * (1 - f.y), f.x * (1 - f.y),
+    (1 - f.x) * f.y, f.x * f.y);
+  ivec2 samples[4];
+
+  float total = 0;
+  float nearest = 1e30;
+  int nearestSample = 0;
+
+  for(int i = 0; i < 4; i++) {
+    samples[i] = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), cloudSize - 1);
+
+    // The march reads zero outside of the screen.
+    ivec2 p = samples[i] * downsample + downsample / 2;
+    float sampleDepth = all(lessThan(p, screenSize)) ? texelFetch(backDepth, p, 0).x : 0.0;
+
+    float difference = relativeDifference(pixelDepth, sampleDepth);
+    float agreement = difference / depthTolerance;
+
+    weights[i] *= exp(-agreement * agreement);
+    total += weights[i];
+
+    if(difference < nearest) {
+      nearest = difference;
+      nearestSample = i;
+    }
+  }
+
+  if(total < 1e-3) {
+    for(int i = 0; i < 4; i++) {
+      weights[i] = i == nearestSample ? 1.0 : 0.0;
+    }
+    total = 1;
+  }
+
+  vec4 layer = vec4(0);
+
+  for(int i = 0; i < 4; i++) {
+    vec4 c = texelFetch(frontTexture, samples[i], 0);
+
+    if(pixelDepth > texelFetch(frontDepth, samples[i], 0).x) {
+      layer += weights[i] * vec4(c.rgb * c.a, c.a);
+    }
+  }
+
+  return layer / total;
+}
+
 void main() {
-  vec4 front = texture2D(frontTexture, textureCoords);
-  vec4 back = texture2D(backTexture, textureCoords);
+  vec4 back = texture(backTexture, textureCoords);
+
+  if(upsampleMode == 1) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 layer = upsampleBilateral(pixel, texelFetch(backDepth, pixel, 0).x);
+
+    color = back.rgb * (1 - layer.a) + layer.rgb;
+    return;
+  }
+
+  vec4 front = texture(frontTexture, textureCoords);
 
-  vec4 frontD = texture2D(frontDepth, textureCoords);
-  vec4 backD = texture2D(backDepth, textureCoords);
+  vec4 frontD = texture(frontDepth, textureCoords);
+  vec4 backD = texture(backDepth, textureCoords);
 
   if(backD.x <= frontD.x) {
     color = back.rgb;
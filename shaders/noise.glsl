@@ -0,0 +1,176 @@
+// Generated from src/Noise.hpp by bin/noise-glsl, do not edit.
+// Hash and value noise used by clouds.comp, the same as Noise on CPU.
+// Expects PI and UINT_MAX to be defined.
+
+float hash(uint key) {
+  key = key * key + 77433u;
+  uint n = key * 37u;
+
+  return ((((n * 3342687u + 1144763u) & 0xf2fcf7ddu) - 77663544u) * 4294967183u * n) / float(UINT_MAX);
+}
+
+float mixFactor(float a) {
+  return (1 - cos(a * PI)) * 0.5;
+}
+
+float mixCos(float x, float y, float a) {
+  return mix(x, y, mixFactor(a));
+}
+
+uint cellKey(int q) {
+  uint key = 0u;
+  key += uint(q);
+  return key;
+}
+
+float hash(int q) {
+  return hash(cellKey(q));
+}
+
+uint cellKey(ivec2 q) {
+  uint key = 0u;
+  key += uint(q.x) * 79u + 74344645u;
+  key += uint(q.y) * 317u - 6324441u;
+  return key;
+}
+
+float hash(ivec2 q) {
+  return hash(cellKey(q));
+}
+
+uint cellKey(ivec3 q) {
+  uint key = 0u;
+  key += uint(q.x) * 7779u + 764343u;
+  key += uint(q.y) * 312217u - 63654641u;
+  key += uint(q.z) * 124547u + 9963u;
+  return key;
+}
+
+float hash(ivec3 q) {
+  return hash(cellKey(q));
+}
+
+uint cellKey(ivec4 q) {
+  uint key = 0u;
+  key += uint(q.x) * 79u + 743u;
+  key += uint(q.y) * 317u - 631u;
+  key += uint(q.z) * 1247u + 9963u;
+  key += uint(q.w) * uint(-436) - 25u;
+  return key;
+}
+
+float hash(ivec4 q) {
+  return hash(cellKey(q));
+}
+
+float noise(float q) {
+  int q0 = int(floor(q));
+  float r = q - float(q0);
+  uint key = cellKey(q0);
+
+  float c0 = hash(key);
+  float c1 = hash(key + 1u);
+
+  float f = mixFactor(r);
+  c0 = mix(c0, c1, f);
+
+  return c0;
+}
+
+float noise(vec2 q) {
+  ivec2 q0 = ivec2(floor(q));
+  vec2 r = q - vec2(q0);
+  uint key = cellKey(q0);
+
+  float c0 = hash(key);
+  float c1 = hash(key + 79u);
+  float c2 = hash(key + 317u);
+  float c3 = hash(key + 396u);
+
+  float f = mixFactor(r.x);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+
+  f = mixFactor(r.y);
+  c0 = mix(c0, c1, f);
+
+  return c0;
+}
+
+float noise(vec3 q) {
+  ivec3 q0 = ivec3(floor(q));
+  vec3 r = q - vec3(q0);
+  uint key = cellKey(q0);
+
+  float c0 = hash(key);
+  float c1 = hash(key + 7779u);
+  float c2 = hash(key + 312217u);
+  float c3 = hash(key + 319996u);
+  float c4 = hash(key + 124547u);
+  float c5 = hash(key + 132326u);
+  float c6 = hash(key + 436764u);
+  float c7 = hash(key + 444543u);
+
+  float f = mixFactor(r.x);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+  c2 = mix(c4, c5, f);
+  c3 = mix(c6, c7, f);
+
+  f = mixFactor(r.y);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+
+  f = mixFactor(r.z);
+  c0 = mix(c0, c1, f);
+
+  return c0;
+}
+
+float noise(vec4 q) {
+  ivec4 q0 = ivec4(floor(q));
+  vec4 r = q - vec4(q0);
+  uint key = cellKey(q0);
+
+  float c0 = hash(key);
+  float c1 = hash(key + 79u);
+  float c2 = hash(key + 317u);
+  float c3 = hash(key + 396u);
+  float c4 = hash(key + 1247u);
+  float c5 = hash(key + 1326u);
+  float c6 = hash(key + 1564u);
+  float c7 = hash(key + 1643u);
+  float c8 = hash(key - 436u);
+  float c9 = hash(key - 357u);
+  float c10 = hash(key - 119u);
+  float c11 = hash(key - 40u);
+  float c12 = hash(key + 811u);
+  float c13 = hash(key + 890u);
+  float c14 = hash(key + 1128u);
+  float c15 = hash(key + 1207u);
+
+  float f = mixFactor(r.x);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+  c2 = mix(c4, c5, f);
+  c3 = mix(c6, c7, f);
+  c4 = mix(c8, c9, f);
+  c5 = mix(c10, c11, f);
+  c6 = mix(c12, c13, f);
+  c7 = mix(c14, c15, f);
+
+  f = mixFactor(r.y);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+  c2 = mix(c4, c5, f);
+  c3 = mix(c6, c7, f);
+
+  f = mixFactor(r.z);
+  c0 = mix(c0, c1, f);
+  c1 = mix(c2, c3, f);
+
+  f = mixFactor(r.w);
+  c0 = mix(c0, c1, f);
+
+  return c0;
+}
@@ -1,6 +1,4 @@
 #include <GL/glew.h>
-#include <fstream>
-#include <iterator>
 
 #include "BaseShaderProgram.hpp"
 #include "Exceptions.hpp"
@@ -21,13 +19,7 @@ GLuint BaseShaderProgram::getProgram() {
 }
 
 string BaseShaderProgram::getFileContents(string &filename) {
-    ifstream fileStream(filename.c_str());
-
-    if (!fileStream) {
-        throw string("Could not load file '" + filename + "'.");
-    }
-
-    return string(istream_iterator<char>(fileStream >> noskipws), istream_iterator<char>());
+    return ShaderPreprocessor::readFile(filename);
 }
 
 GLuint BaseShaderProgram::createShaderFromSource(string &source, GLenum type) {
@@ -58,6 +50,12 @@ GLuint BaseShaderProgram::createShaderFromFile(string &filename, GLenum type) {
     return createShaderFromSource(source, type);
 }
 
+GLuint BaseShaderProgram::createShaderFromFile(string &filename, GLenum type, const ShaderPreprocessor &preprocessor) {
+    string source = preprocessor.process(filename);
+
+    return createShaderFromSource(source, type);
+}
+
 string BaseShaderProgram::getShaderInfo(GLuint shader) {
     GLint infoLength = 0;
     glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLength);
@@ -3,6 +3,8 @@
 #include <GL/gl.h>
 #include <string>
 
+#include "ShaderPreprocessor.hpp"
+
 namespace pgp {
 
     using std::string;
@@ -41,6 +43,11 @@ namespace pgp {
         static string getFileContents(string &filename);
         static GLuint createShaderFromSource(string &source, GLenum shaderType);
         static GLuint createShaderFromFile(string &filename, GLenum shaderType);
+
+        /**
+         * Compiles the file with includes and defines of preprocessor.
+         */
+        static GLuint createShaderFromFile(string &filename, GLenum shaderType, const ShaderPreprocessor &preprocessor);
         static string getShaderInfo(GLuint shader);
         static string getProgramInfo(GLuint program);
     };
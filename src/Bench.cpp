@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ClipmapTerrain.hpp"
+#include "CloudMarcher.hpp"
+#include "CloudNoise.hpp"
+#include "CloudNoiseSimd.hpp"
+#include "HeightPyramid.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "TerrainChunkCache.hpp"
+#include "TerrainGenerator.hpp"
+#include "ThreadPool.hpp"
+#include "ToroidalTerrain.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Microbenchmarks of terrain and cloud noise hot paths and shader loading.
+ *
+ * Every benchmark is timed in RUNS runs of at least RUN_SECONDS after one
+ * warm-up call. Prints a table and, when a file name is given, writes the
+ * same results as JSON, so runs of different versions can be compared.
+ * Median is the figure to compare, min and max show the noise of the run.
+ */
+
+#define BATCH_SIZE 4096
+#define RUNS 5
+#define RUN_SECONDS 0.2
+#define TERRAIN_STEP 1.5f
+// Heights of rays above the highest sample of the pyramid grid.
+#define RAY_HEIGHT_MIN 2.0f
+#define RAY_HEIGHT_MAX 40.0f
+
+// Makefile passes the flags the benchmark was compiled with.
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+struct Result {
+    string name;
+    // Operations done by one call of the kernel.
+    double operations;
+    // Nanoseconds per operation of each run, sorted.
+    vector<double> runs;
+
+    inline double median() const {
+        return runs[runs.size() / 2];
+    }
+};
+
+// Kernels add their results here, so the compiler cannot drop them.
+static volatile float sink;
+
+static Result measure(const string &name, double operations, function<void()> kernel) {
+    typedef chrono::steady_clock clock;
+
+    Result result;
+    result.name = name;
+    result.operations = operations;
+
+    kernel();
+
+    for (int run = 0; run < RUNS; run++) {
+        size_t calls = 0;
+        double seconds = 0;
+        clock::time_point start = clock::now();
+
+        do {
+            kernel();
+            calls++;
+            seconds = chrono::duration<double>(clock::now() - start).count();
+        } while (seconds < RUN_SECONDS);
+
+        result.runs.push_back(seconds * 1e9 / (calls * operations));
+    }
+
+    sort(result.runs.begin(), result.runs.end());
+
+    printf("%-28s %14.2f %14.2f %14.2f %16.0f\n", name.c_str(), result.median(),
+            result.runs.front(), result.runs.back(), 1e9 / result.median());
+    fflush(stdout);
+
+    return result;
+}
+
+static string jsonEscape(const string &text) {
+    string escaped;
+
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+static bool writeJson(const char *filename, const vector<Result> &results, unsigned threads) {
+    FILE *file = fopen(filename, "w");
+
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"runs\": %d,\n", RUNS);
+    fprintf(file, "  \"threads\": %u,\n", threads);
+    fprintf(file, "  \"isa\": \"%s\",\n", CloudNoiseSimd::getIsaName(CloudNoiseSimd::getBestIsa()));
+    fprintf(file, "  \"compiler\": \"%s\",\n", jsonEscape(__VERSION__).c_str());
+    fprintf(file, "  \"flags\": \"%s\",\n", jsonEscape(BUILD_FLAGS).c_str());
+    fprintf(file, "  \"benchmarks\": [\n");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+
+        fprintf(file, "    {\"name\": \"%s\", \"operations\": %.0f, \"ns_per_op\": %.4f, "
+                "\"min_ns_per_op\": %.4f, \"max_ns_per_op\": %.4f, \"ops_per_second\": %.1f}%s\n",
+                r.name.c_str(), r.operations, r.median(), r.runs.front(), r.runs.back(),
+                1e9 / r.median(), i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Moves the camera by TERRAIN_STEP per build, like a flight over the
+ * terrain, so the sources reuse what they would reuse in the program.
+ */
+static Result measureSource(const string &name, ITerrainSource *source) {
+    TerrainMesh mesh;
+    float z = 0;
+
+    Result result = measure(name, 1, [&] {
+        source->build(vec3(0, 0, z), mesh);
+        z += TERRAIN_STEP;
+        sink = sink + mesh.vertices[0].position.y;
+    });
+
+    delete source;
+
+    return result;
+}
+
+/**
+ * Builds a pyramid over size x size lattice heights and measures its build,
+ * batched height queries and batched rays cast from above the terrain in
+ * random directions, mostly towards the ground, from the middle half.
+ */
+static void measurePyramid(int size, ThreadPool *pool, vector<Result> &results) {
+    string name = "terrain.pyramid." + to_string(size);
+    vector<float> heights(size * size);
+    float maxHeight = -INFINITY;
+
+    for (int x = 0; x < size; x++) {
+        for (int z = 0; z < size; z++) {
+            heights[x * size + z] = TerrainGenerator::latticeHeight(x, z);
+            maxHeight = std::max(maxHeight, heights[x * size + z]);
+        }
+    }
+
+    float extent = (size - 1) * RESOLUTION;
+    HeightPyramid pyramid(pool);
+
+    results.push_back(measure(name + ".build", 1, [&] {
+        pyramid.build(&heights[0], ivec2(size), vec2(0), RESOLUTION);
+        sink = sink + pyramid.getLevelCount();
+    }));
+
+    mt19937 rng(size);
+    uniform_real_distribution<float> position(0.0f, extent);
+    uniform_real_distribution<float> above(RAY_HEIGHT_MIN, RAY_HEIGHT_MAX);
+    uniform_real_distribution<float> angle(0.0f, float(2 * M_PI));
+    uniform_real_distribution<float> slope(-0.6f, 0.1f);
+
+    vector<vec2> points(BATCH_SIZE);
+    vector<vec3> origins(BATCH_SIZE), directions(BATCH_SIZE);
+    vector<float> out(BATCH_SIZE);
+
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        float a = angle(rng);
+
+        points[i] = vec2(position(rng), position(rng));
+        origins[i] = vec3(extent / 4 + position(rng) / 2, maxHeight + above(rng), extent / 4 + position(rng) / 2);
+        directions[i] = normalize(vec3(cosf(a), slope(rng), sinf(a)));
+    }
+
+    results.push_back(measure(name + ".height", BATCH_SIZE, [&] {
+        pyramid.height(&points[0], &out[0], BATCH_SIZE);
+        sink = sink + out[0];
+    }));
+
+    results.push_back(measure(name + ".ray", BATCH_SIZE, [&] {
+        pyramid.intersect(&origins[0], &directions[0], &out[0], BATCH_SIZE);
+        sink = sink + out[0];
+    }));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [RESULT.json]\n", argv[0]);
+        return 1;
+    }
+
+    ThreadPool pool;
+    vector<Result> results;
+
+    mt19937 rng(1103);
+    uniform_real_distribution<float> horizontal(-1000.0f, 1000.0f);
+    uniform_real_distribution<float> vertical(75.0f, 175.0f);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uniform_int_distribution<int> lattice(-100000, 100000);
+
+    vector<int> ix(BATCH_SIZE), iy(BATCH_SIZE);
+    vector<float> x(BATCH_SIZE), y(BATCH_SIZE), z(BATCH_SIZE), w(BATCH_SIZE), f(BATCH_SIZE);
+    vector<vec4> points(BATCH_SIZE);
+    vector<ivec4> cells(BATCH_SIZE);
+
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        ix[i] = lattice(rng);
+        iy[i] = lattice(rng);
+        x[i] = horizontal(rng);
+        y[i] = vertical(rng);
+        z[i] = horizontal(rng);
+        w[i] = unit(rng) * 50.0f;
+        f[i] = unit(rng);
+        points[i] = vec4(x[i], y[i], z[i], w[i]);
+        cells[i] = ivec4(ix[i], iy[i], lattice(rng), lattice(rng));
+    }
+
+    printf("Compiled with %s\n\n", BUILD_FLAGS);
+    printf("%-28s %14s %14s %14s %16s\n", "benchmark", "ns/op", "min ns/op", "max ns/op", "ops/s");
+
+    // Terrain heightmap functions.
+
+    results.push_back(measure("terrain.noise2D", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += TerrainGenerator::noise2D(ix[i], iy[i]);
+        }
+        sink = sum;
+    }));
+
+    results.push_back(measure("terrain.smoothNoise2D", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += TerrainGenerator::smoothNoise2D(x[i], z[i]);
+        }
+        sink = sum;
+    }));
+
+    results.push_back(measure("terrain.interpolateCos", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += TerrainGenerator::interpolateCos(x[i], z[i], f[i]);
+        }
+        sink = sum;
+    }));
+
+    results.push_back(measure("terrain.height", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += TerrainGenerator::height(x[i], z[i]);
+        }
+        sink = sum;
+    }));
+
+    // Full mesh generation, what a reload without any reuse costs.
+
+    {
+        vector<float> heightmap(HEIGHTMAP_SIZE * HEIGHTMAP_SIZE);
+        vector<TerrainVertex> vertices((LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1));
+
+        TerrainGenerator serial;
+        results.push_back(measure("terrain.generate.serial", 1, [&] {
+            serial.generate(vec3(0), &heightmap[0], &vertices[0]);
+            sink = sink + heightmap[0];
+        }));
+
+        TerrainGenerator parallel(&pool);
+        results.push_back(measure("terrain.generate.parallel", 1, [&] {
+            parallel.generate(vec3(0), &heightmap[0], &vertices[0]);
+            sink = sink + heightmap[0];
+        }));
+    }
+
+    results.push_back(measureSource("terrain.build.chunks", new TerrainChunkCache(&pool)));
+    results.push_back(measureSource("terrain.build.ring", new ToroidalTerrain(&pool)));
+    results.push_back(measureSource("terrain.build.clipmap", new ClipmapTerrain(&pool)));
+
+    // Height and ray queries, on the drawn grid and on smaller and larger ones.
+
+    measurePyramid(256, &pool, results);
+    measurePyramid(HEIGHTMAP_SIZE, &pool, results);
+    measurePyramid(1024, &pool, results);
+
+    // CPU ports of shaders/clouds.comp.
+
+    results.push_back(measure("clouds.hash", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += CloudNoise::hash(cells[i]);
+        }
+        sink = sum;
+    }));
+
+    results.push_back(measure("clouds.noise", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += CloudNoise::noise(points[i]);
+        }
+        sink = sum;
+    }));
+
+    CloudMarcher marcher;
+    marcher.setTime(0);
+
+    results.push_back(measure("clouds.cloudMap", BATCH_SIZE, [&] {
+        float sum = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            sum += marcher.cloudMap(points[i]);
+        }
+        sink = sum;
+    }));
+
+    CloudNoiseSimd::Layer layer(marcher);
+    vector<float> out(BATCH_SIZE);
+
+    results.push_back(measure("clouds.cloudMap.batch", BATCH_SIZE, [&] {
+        CloudNoiseSimd::cloudMap(layer, &x[0], &y[0], &z[0], &w[0], &out[0], BATCH_SIZE);
+        sink = sink + out[0];
+    }));
+
+    // Shader loading, one operation is one byte of the cloud shader.
+
+    string shaderFile = "./shaders/clouds.comp";
+    ShaderPreprocessor preprocessor;
+    preprocessor.define("STEP_MODE", 1);
+
+    try {
+        string raw = ShaderPreprocessor::readFile(shaderFile);
+        string source = preprocessor.process(shaderFile);
+
+        results.push_back(measure("shader.read", raw.size(), [&] {
+            sink = sink + ShaderPreprocessor::readFile(shaderFile).size();
+        }));
+
+        results.push_back(measure("shader.process", source.size(), [&] {
+            sink = sink + preprocessor.process(shaderFile).size();
+        }));
+
+        results.push_back(measure("shader.hash", source.size(), [&] {
+            sink = sink + ShaderPreprocessor::hash(source);
+        }));
+    } catch (string &e) {
+        fprintf(stderr, "Shader benchmarks skipped: %s\n", e.c_str());
+    }
+
+    if (argc == 2) {
+        if (!writeJson(argv[1], results, pool.getThreadCount())) {
+            fprintf(stderr, "Could not write '%s'\n", argv[1]);
+            return 2;
+        }
+
+        printf("Results written to %s\n", argv[1]);
+    }
+
+    return 0;
+}
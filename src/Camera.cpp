@@ -9,11 +9,15 @@
 using namespace pgp;
 using namespace glm;
 
-Camera::Camera(SDL_Window *_window) : position(0.0, 35.0, 0.0), rotation(0, 0) {
+Camera::Camera(SDL_Window *_window) : position(0.0, 35.0, 0.0), rotation(0, 0), movement(0, 0, 0) {
     window = _window;
     SDL_GetWindowSize(window, &(windowSize.x), &(windowSize.y));
 }
 
+Camera::Camera(ivec2 _windowSize) :
+        window(NULL), windowSize(_windowSize), position(0.0, 35.0, 0.0), rotation(0, 0), movement(0, 0, 0) {
+}
+
 vec3 Camera::getViewVector() {
     vec3 direction = vec3(0, 0, 1);
 
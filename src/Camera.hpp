@@ -22,16 +22,30 @@ namespace pgp {
     public:
         Camera(SDL_Window *window);
 
+        /**
+         * Camera for rendering without a window, e.g. into HeadlessContext.
+         */
+        Camera(ivec2 windowSize);
+
         inline vec3 getPosition() {
             return position;
         };
 
+        inline vec2 getRotation() {
+            return rotation;
+        }
+
         inline ivec2 getWindowSize() {
             return windowSize;
         }
 
         vec3 getViewVector();
 
+        inline void setPose(vec3 _position, vec2 _rotation) {
+            position = _position;
+            rotation = _rotation;
+        }
+
         virtual IEventListener::EventResponse onEvent(SDL_Event* evt);
 
         virtual void step(float time, float delta);
@@ -0,0 +1,70 @@
+#include <fstream>
+#include <sstream>
+
+#include "CameraScript.hpp"
+
+using namespace pgp;
+using namespace std;
+
+CameraScript::CameraScript(Camera *_camera) : camera(_camera) {
+    keyframes = {
+        {0.0, vec3(0.0, 35.0, 0.0), vec2(-0.2, 0.0)},
+        {4.0, vec3(0.0, 40.0, 60.0), vec2(-0.1, 0.4)},
+        {8.0, vec3(30.0, 45.0, 110.0), vec2(0.1, 0.8)},
+    };
+}
+
+void CameraScript::load(const string &filename) {
+    ifstream file(filename.c_str());
+
+    if (!file) {
+        throw string("Could not read camera script '" + filename + "'.");
+    }
+
+    vector<Keyframe> loaded;
+    string line;
+
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        Keyframe k;
+        istringstream in(line);
+
+        if (!(in >> k.time >> k.position.x >> k.position.y >> k.position.z >> k.rotation.x >> k.rotation.y)) {
+            throw string("Bad camera keyframe '" + line + "' in '" + filename + "'.");
+        }
+
+        if (!loaded.empty() && k.time <= loaded.back().time) {
+            throw string("Camera keyframes in '" + filename + "' are not ordered by time.");
+        }
+
+        loaded.push_back(k);
+    }
+
+    if (loaded.empty()) {
+        throw string("Camera script '" + filename + "' has no keyframes.");
+    }
+
+    keyframes = loaded;
+}
+
+void CameraScript::step(float time, float) {
+    size_t next = 0;
+    while (next < keyframes.size() && keyframes[next].time <= time) {
+        next++;
+    }
+
+    if (next == 0 || next == keyframes.size()) {
+        const Keyframe &k = keyframes[next == 0 ? 0 : next - 1];
+        camera->setPose(k.position, k.rotation);
+        return;
+    }
+
+    const Keyframe &a = keyframes[next - 1];
+    const Keyframe &b = keyframes[next];
+    float f = (time - a.time) / (b.time - a.time);
+
+    camera->setPose(mix(a.position, b.position, f), mix(a.rotation, b.rotation, f));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "IProcessor.hpp"
+#include "Camera.hpp"
+
+namespace pgp {
+
+    using std::string;
+    using std::vector;
+
+    /**
+     * Drives camera along keyframes instead of user input, used by headless
+     * runs. Pose is interpolated linearly and held after the last keyframe.
+     */
+    class CameraScript : public IProcessor {
+    private:
+
+        struct Keyframe {
+            float time;
+            vec3 position;
+            vec2 rotation;
+        };
+
+        Camera *camera;
+        vector<Keyframe> keyframes;
+
+    public:
+        /**
+         * Starts with a short built-in flight over the terrain.
+         */
+        CameraScript(Camera *camera);
+
+        /**
+         * Replaces keyframes by those in file. Every line holds
+         * "time x y z pitch yaw", lines starting with # are skipped.
+         */
+        void load(const string &filename);
+
+        inline float getDuration() {
+            return keyframes.back().time;
+        }
+
+        virtual void step(float time, float delta);
+    };
+
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "ClipmapTerrain.hpp"
+
+using namespace pgp;
+using namespace std;
+
+ClipmapTerrain::ClipmapTerrain(ThreadPool *_pool, int _levels, int _size) : pool(_pool), levels(_levels), size(_size) {
+    if (levels < 1 || size < 16 || size % 4 != 0) {
+        throw string("Clipmap needs at least one level and size divisible by 4, at least 16.");
+    }
+
+    memset(&stats, 0, sizeof stats);
+}
+
+ivec2 ClipmapTerrain::getLevelOrigin(vec3 position, int level) const {
+    int unit = 1 << level;
+    ivec2 center = TerrainGenerator::getGridOrigin(position) + LANDSCAPE_SIZE / 2;
+
+    // Aligned to lattice of the next level, so that level can cut its hole.
+    return ivec2(floorDiv(center.x - size / 2 * unit, 2 * unit), floorDiv(center.y - size / 2 * unit, 2 * unit)) * (2 * unit);
+}
+
+void ClipmapTerrain::build(vec3 position, TerrainMesh &mesh) {
+    auto start = chrono::steady_clock::now();
+
+    vector<Level> built(levels);
+
+    auto job = [&](unsigned level) {
+        buildLevel(position, level, built[level]);
+    };
+
+    if (pool) {
+        pool->run(levels, job);
+    } else {
+        for (int level = 0; level < levels; level++) {
+            job(level);
+        }
+    }
+
+    mesh.heightmap.clear();
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    for (Level &level : built) {
+        uint32_t base = mesh.vertices.size();
+
+        mesh.vertices.insert(mesh.vertices.end(), level.vertices.begin(), level.vertices.end());
+
+        for (uint32_t index : level.indices) {
+            mesh.indices.push_back(index == UINT32_MAX ? index : base + index);
+        }
+    }
+
+    float time = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+
+    stats.misses += mesh.vertices.size();
+    stats.reloads++;
+    stats.lastReloadTime = time;
+    stats.totalReloadTime += time;
+}
+
+void ClipmapTerrain::buildLevel(vec3 position, int level, Level &out) const {
+    int unit = 1 << level;
+    int side = size + 1;
+    ivec2 origin = getLevelOrigin(position, level);
+
+    // Quads covered by the finer level, empty for the finest one.
+    ivec2 hole(0), holeEnd(0);
+    if (level > 0) {
+        hole = (getLevelOrigin(position, level - 1) - origin) / unit;
+        holeEnd = hole + size / 2;
+    }
+
+    auto inHole = [&](int x, int z) {
+        return x >= hole.x && x < holeEnd.x && z >= hole.y && z < holeEnd.y;
+    };
+
+    // Heights with one sample border for normals. Samples deep inside the
+    // hole are used by no vertex and stay unevaluated.
+    int padded = side + 2;
+    vector<float> heights(padded * padded);
+
+    for (int x = -1; x <= size + 1; x++) {
+        for (int z = -1; z <= size + 1; z++) {
+            if (x > hole.x + 1 && x < holeEnd.x - 1 && z > hole.y + 1 && z < holeEnd.y - 1) {
+                continue;
+            }
+            heights[(x + 1) * padded + (z + 1)] = TerrainGenerator::latticeHeight(origin.x + x * unit, origin.y + z * unit);
+        }
+    }
+
+    auto heightAt = [&](int x, int z) {
+        return heights[(x + 1) * padded + (z + 1)];
+    };
+
+    vector<uint32_t> remap(side * side, UINT32_MAX);
+    float spacing = unit * RESOLUTION;
+    bool seam = level < levels - 1;
+
+    for (int x = 0; x <= size; x++) {
+        for (int z = 0; z <= size; z++) {
+            if (x > hole.x && x < holeEnd.x && z > hole.y && z < holeEnd.y) {
+                continue;
+            }
+
+            float y = heightAt(x, z);
+
+            if (seam && (x == 0 || x == size) && z % 2 == 1) {
+                y = (heightAt(x, z - 1) + heightAt(x, z + 1)) * 0.5f;
+            } else if (seam && (z == 0 || z == size) && x % 2 == 1) {
+                y = (heightAt(x - 1, z) + heightAt(x + 1, z)) * 0.5f;
+            }
+
+            TerrainVertex v;
+            v.position = vec3((origin.x + x * unit) * RESOLUTION, y, (origin.y + z * unit) * RESOLUTION);
+            v.normal = normalize(vec3(heightAt(x - 1, z) - heightAt(x + 1, z), 2 * spacing, heightAt(x, z - 1) - heightAt(x, z + 1)));
+            v.color = u8vec3(0, 80, 0);
+
+            remap[x * side + z] = out.vertices.size();
+            out.vertices.push_back(v);
+        }
+    }
+
+    // Strips run along z over quads outside the hole, same winding as the grid.
+    for (int x = 0; x < size; x++) {
+        for (int z = 0; z < size;) {
+            if (inHole(x, z)) {
+                z = holeEnd.y;
+                continue;
+            }
+
+            int end = z;
+            while (end < size && !inHole(x, end)) {
+                end++;
+            }
+
+            for (int col = z; col <= end; col++) {
+                out.indices.push_back(remap[(x + 1) * side + col]);
+                out.indices.push_back(remap[x * side + col]);
+            }
+            out.indices.push_back(UINT32_MAX);
+
+            z = end;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include "ITerrainSource.hpp"
+#include "ThreadPool.hpp"
+
+#define CLIPMAP_SIZE 64
+#define CLIPMAP_LEVELS 5
+
+namespace pgp {
+
+    using std::vector;
+
+    /**
+     * Nested geometry clipmap around the camera.
+     *
+     * Level l is a grid of size^2 quads with spacing RESOLUTION * 2^l,
+     * with a hole where level l - 1 lies. Each level doubles the covered
+     * width, so vertex count grows with the logarithm of view distance.
+     *
+     * Levels are aligned to lattice of the next coarser level. Odd vertices
+     * on the outer border of a level take the average height of their
+     * neighbours, so they lie on the coarse edge and the seam has no cracks.
+     */
+    class ClipmapTerrain : public ITerrainSource {
+    private:
+        ThreadPool *pool;
+        int levels;
+        int size;
+        TerrainStats stats;
+
+        typedef struct {
+            vector<TerrainVertex> vertices;
+            vector<uint32_t> indices;
+        } Level;
+
+    public:
+        /**
+         * Size is number of quads along level side, multiple of 4, at least 16.
+         */
+        ClipmapTerrain(ThreadPool *pool = NULL, int levels = CLIPMAP_LEVELS, int size = CLIPMAP_SIZE);
+
+        virtual void build(vec3 position, TerrainMesh &mesh);
+
+        virtual const TerrainStats &getStats() const {
+            return stats;
+        }
+
+        /**
+         * Width of the outermost level in world units.
+         */
+        inline float getExtent() const {
+            return size * RESOLUTION * (1 << (levels - 1));
+        }
+
+        /**
+         * Base lattice coordinates of the first vertex of level.
+         */
+        ivec2 getLevelOrigin(vec3 position, int level) const;
+
+    private:
+        void buildLevel(vec3 position, int level, Level &out) const;
+
+        static inline int floorDiv(int x, int d) {
+            return x >= 0 ? x / d : -((d - 1 - x) / d);
+        }
+    };
+
+}
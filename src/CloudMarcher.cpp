@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CloudMarcher.hpp"
+#include "CloudNoise.hpp"
+#include "CloudTiles.hpp"
+#include "DensityVolume.hpp"
+#include "LightVolume.hpp"
+#include "OccupancyGrid.hpp"
+
+#define DIV_ROUND_UP(x,d) ((x + d - 1)/d)
+
+using namespace pgp;
+using namespace glm;
+
+CloudMarcher::CloudMarcher(ThreadPool *_pool) : pool(_pool), densityVolume(NULL), occupancyGrid(NULL),
+    lightVolume(NULL), time(0) {
+}
+
+mat4 CloudMarcher::rayMatrix(const mat4 &viewProjection, vec3 eyePosition) {
+    mat4 vp = viewProjection;
+    vp[3] = viewProjection * vec4(eyePosition, 1);
+
+    return inverse(vp);
+}
+
+void CloudMarcher::render(vec3 eyePosition, const mat4 &invVP, float _time,
+        const float *depth, ivec2 screenSize, CloudFrame &frame) {
+
+    time = _time;
+
+    int tilesX = DIV_ROUND_UP(frame.size.x, TILE_WIDTH);
+    int tilesY = DIV_ROUND_UP(frame.size.y, TILE_HEIGHT);
+
+    // Every tile has its own counters, so no synchronization is needed.
+    // Flags are bytes, bits of vector<bool> would share words across tiles.
+    vector<unsigned long> tileCalls(tilesX * tilesY);
+    vector<unsigned char> culled(tilesX * tilesY);
+
+    auto renderTile = [&](unsigned tile) {
+        if (cullTiles && cullTile(ivec2(tile % tilesX, tile / tilesX), eyePosition, invVP, depth, screenSize, frame)) {
+            culled[tile] = 1;
+            return;
+        }
+
+        int x0 = (tile % tilesX) * TILE_WIDTH;
+        int y0 = (tile / tilesX) * TILE_HEIGHT;
+        int x1 = std::min(x0 + TILE_WIDTH, frame.size.x);
+        int y1 = std::min(y0 + TILE_HEIGHT, frame.size.y);
+
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                tileCalls[tile] += renderPixel(x, y, eyePosition, invVP, depth, screenSize, frame);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->run(tilesX * tilesY, renderTile);
+    } else {
+        for (int tile = 0; tile < tilesX * tilesY; tile++) {
+            renderTile(tile);
+        }
+    }
+
+    frame.cloudMapCalls = 0;
+    for (unsigned long calls : tileCalls) {
+        frame.cloudMapCalls += calls;
+    }
+
+    frame.culledTiles = std::count(culled.begin(), culled.end(), 1);
+}
+
+bool CloudMarcher::cullTile(ivec2 tile, vec3 eyePosition, const mat4 &invVP, const float *depth, ivec2 screenSize,
+        CloudFrame &frame) const {
+
+    ivec2 tileSize(TILE_WIDTH, TILE_HEIGHT);
+    ivec2 first = tile * tileSize;
+    ivec2 last = min(first + tileSize, frame.size);
+    int downsample = int(ceilf(float(screenSize.x) / float(frame.size.x)));
+
+    // Depth each pixel marches against, zero outside of the screen.
+    float maxDepth = 0;
+
+    for (int y = first.y; y < last.y; y++) {
+        for (int x = first.x; x < last.x; x++) {
+            ivec2 iCoords = ivec2(x, y) * downsample + ivec2(downsample / 2);
+
+            if (iCoords.x < screenSize.x && iCoords.y < screenSize.y) {
+                maxDepth = std::max(maxDepth, depth[iCoords.y * screenSize.x + iCoords.x]);
+            }
+        }
+    }
+
+    SlabInterval interval = CloudTiles::tileInterval(eyePosition, invVP, tile, tileSize, frame.size,
+            lowerLayer, upperLayer);
+
+    if (CloudTiles::isLive(interval, std::min(std::min(maxDepth, maxDistance), getRange()))) {
+        return false;
+    }
+
+    for (int y = first.y; y < last.y; y++) {
+        for (int x = first.x; x < last.x; x++) {
+            frame.color[y * frame.size.x + x] = vec4(1, 1, 1, 0);
+            frame.depth[y * frame.size.x + x] = 1e15;
+        }
+    }
+
+    return true;
+}
+
+unsigned CloudMarcher::renderPixel(int x, int y, vec3 eyePosition, const mat4 &invVP,
+        const float *depth, ivec2 screenSize, CloudFrame &frame) {
+
+    int downsample = int(ceilf(float(screenSize.x) / float(frame.size.x)));
+
+    vec2 fCoords = vec2(x, y) / vec2(frame.size);
+    ivec2 iCoords = ivec2(x, y) * downsample + ivec2(downsample / 2);
+
+    vec4 rayDir4 = invVP * vec4(fCoords * 2.0f - 1.0f, 1, 1);
+
+    Ray r;
+    r.origin = eyePosition;
+    r.direction = normalize(vec3(rayDir4));
+
+    // imageLoad() returns zero outside of the image.
+    float depthF = 0;
+    if (iCoords.x < screenSize.x && iCoords.y < screenSize.y) {
+        depthF = depth[iCoords.y * screenSize.x + iCoords.x];
+    }
+
+    unsigned calls = 0;
+    vec4 cl = marchClouds(r, depthF, &calls);
+
+    int i = y * frame.size.x + x;
+    frame.color[i] = cl;
+    frame.depth[i] = depthF;
+
+    return calls;
+}
+
+vec4 CloudMarcher::marchClouds(const Ray &r, float &depth, unsigned *calls) {
+    float range = getRange();
+    // Slab past the end of the march is as empty as one behind terrain.
+    float maxDist = std::min(std::min(depth, maxDistance), range);
+    vec3 position = r.origin;
+    float closeDistance, farDistance;
+    float alpha = 0.0;
+    float brightness = 1;
+    float step;
+    float t = time * timeFactor;
+
+    float distToUpper = distanceToLayer(r, upperLayer);
+    float distToLower = distanceToLayer(r, lowerLayer);
+
+    depth = 1e15;
+
+    if (r.origin.y < lowerLayer) {
+        closeDistance = distToLower;
+        farDistance = distToUpper;
+    } else if (r.origin.y > upperLayer) {
+        closeDistance = distToUpper;
+        farDistance = distToLower;
+    } else {
+        closeDistance = 0;
+        farDistance = std::max(distToLower, distToUpper);
+    }
+
+    farDistance = std::max(farDistance, maxDistance);
+
+    if (closeDistance >= maxDist || closeDistance < 0) {
+        // Terrain is closer than cloud layer or ray is going away.
+        return vec4(1, 1, 1, 0);
+    }
+
+    step = stepSize;
+
+    depth = closeDistance;
+
+    float alphaMod = clamp((maxDistance - depth) / (distanceEase), 0.0f, 1.0f);
+
+    float maxAlpha = 1.0f - policy.minTransmittance;
+    int refineSteps = std::max(policy.refineSteps, 1);
+
+    // Fixed steps stay on multiples of stepSize, as in the original march.
+    int i = int(ceilf(closeDistance / step));
+    float distance = step * i;
+    float previous = distance - stepSize;
+    float next = distance;
+
+    bool coarse = policy.stepMode == MarchPolicy::STEP_ADAPTIVE;
+    int emptySamples = 0;
+
+    vec3 initPos = r.origin;
+    // Occupancy grid is in advected coordinates, which shift the whole ray.
+    vec3 windOffset = vec3(advect(vec4(0, 0, 0, t)));
+    float exitDistance;
+    unsigned mapCalls = 0;
+
+    bool thresholdPassed = false;
+    for (; distance < range; previous = distance, distance = next) {
+        switch (policy.stepMode) {
+            case MarchPolicy::STEP_DISTANCE:
+                step = clamp(distance * policy.stepRatio, stepSize, policy.maxStepSize);
+                next = distance + step;
+                break;
+            case MarchPolicy::STEP_ADAPTIVE:
+                step = coarse ? stepSize * policy.emptyStepScale : stepSize;
+                next = distance + step;
+                break;
+            default:
+                next = stepSize * ++i;
+        }
+
+        position = initPos + (r.direction * distance);
+
+        if (position.y < lowerLayer || position.y > upperLayer) {
+            continue;
+        }
+
+        if (occupancyGrid && occupancyGrid->isEmpty(position + windOffset, r.direction, exitDistance)) {
+            // Samples before the cell border would add zero density.
+            if (policy.stepMode == MarchPolicy::STEP_FIXED) {
+                i = std::max(i, int(ceilf((distance + exitDistance - 1e-3f) / stepSize)));
+                next = stepSize * i;
+            } else {
+                next = std::max(next, distance + exitDistance);
+            }
+            continue;
+        }
+
+        float density = cloudMap(vec4(position, t));
+        mapCalls++;
+
+        if (policy.stepMode == MarchPolicy::STEP_ADAPTIVE) {
+            if (coarse && density > 0) {
+                // Cloud starts somewhere after the previous sample.
+                coarse = false;
+                emptySamples = 0;
+                next = previous + stepSize;
+                continue;
+            }
+
+            emptySamples = density > 0 ? 0 : emptySamples + 1;
+            coarse = emptySamples >= refineSteps;
+        }
+
+        // Longer steps stand for more of the original samples.
+        alpha += density * (step / stepSize);
+
+        if ((!thresholdPassed) && alpha > 0.15f) {
+            depth = distance;
+            if (!(lightVolume && lightVolume->sample(position, brightness))) {
+                brightness = marchBrightness(vec4(position, t), &mapCalls);
+            }
+            thresholdPassed = true;
+        }
+
+        if (alpha >= maxAlpha) {
+            break;
+        }
+    }
+
+    brightness = clamp(brightness + (1 - alpha)*(1 - alpha), 0.0f, 1.0f);
+
+    if (calls) {
+        *calls += mapCalls;
+    }
+
+    return clamp(vec4(brightness, brightness, brightness, alpha * alphaMod), 0.0f, 1.0f);
+}
+
+float CloudMarcher::marchBrightness(vec4 p, unsigned *calls) {
+    Ray r;
+    r.origin = vec3(p);
+    r.direction = normalize(sunPosition - r.origin);
+
+    float distToUpper = distanceToLayer(r, upperLayer);
+    float distToLower = distanceToLayer(r, lowerLayer);
+
+    float step = 1.0;
+    float brightness = 1.0;
+    float density;
+    float decrease = 0.45;
+
+    vec3 position;
+    for (float t = std::max(0.0f, distToLower); t < distToUpper; t += step) {
+        position = r.origin + (r.direction * t);
+
+        // Same as in the shader, ray distance is passed as the fourth coordinate.
+        density = cloudMap(vec4(position, t));
+
+        brightness -= decrease * density;
+
+        decrease *= 0.95f;
+
+        if (calls) {
+            (*calls)++;
+        }
+    }
+
+    return brightness;
+}
+
+float CloudMarcher::cloudMap(vec4 p) const {
+    float upperEase, lowerEase, ease;
+    float f;
+
+    if (densityVolume && densityVolume->sample(p, f)) {
+        return f;
+    }
+
+    vec4 q = advect(p);
+    f  = 0.25000f * CloudNoise::noise(q / 256.0f);
+    f += 0.35000f * CloudNoise::noise(q / 128.0f);
+    f += 0.22500f * CloudNoise::noise(q / 64.0f);
+    f -= 0.22500f * CloudNoise::noise(q / 48.0f) / 2.0f;
+    f += 0.06250f * CloudNoise::noise(q / 32.0f);
+
+    upperEase = clamp((upperLayer - layerOffset - q.y) / (layerEase), 0.0f, 1.0f);
+    lowerEase = clamp((q.y - lowerLayer - layerOffset) / (layerEase), 0.0f, 1.0f);
+
+    ease = 1 - std::abs(upperEase - lowerEase);
+
+    return clamp(f * 1.35f - 0.5f, 0.0f, 1.0f) * ease;
+}
+
+float CloudMarcher::distanceToLayer(const Ray &r, float height) {
+    if (r.direction.y == 0) {
+        return -1.0;
+    }
+
+    return (height - r.origin.y) / r.direction.y;
+}
+
+bool MarchPolicy::parseStepMode(const char *name, StepMode &mode) {
+    static const char *names[] = {"fixed", "distance", "adaptive"};
+
+    for (int m = STEP_FIXED; m <= STEP_ADAPTIVE; m++) {
+        if (strcmp(name, names[m]) == 0) {
+            mode = StepMode(m);
+            return true;
+        }
+    }
+
+    return false;
+}
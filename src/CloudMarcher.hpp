@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    class DensityVolume;
+    class LightVolume;
+    class OccupancyGrid;
+
+    using std::vector;
+    using glm::ivec2;
+    using glm::vec3;
+    using glm::vec4;
+    using glm::mat4;
+
+    /**
+     * Output of a cloud pass, same layout as cloudIm and cloudDepthIm images.
+     */
+    struct CloudFrame {
+        ivec2 size;
+        vector<vec4> color;
+        vector<float> depth;
+        // Filled by CloudMarcher::render.
+        unsigned long cloudMapCalls = 0;
+        unsigned long culledTiles = 0;
+
+        inline void resize(ivec2 _size) {
+            size = _size;
+            color.resize(size.x * size.y);
+            depth.resize(size.x * size.y);
+        }
+    };
+
+    /**
+     * Sample placement and termination of marchClouds. Fields are uploaded
+     * to clouds.comp as uniforms of the same names, defaults give the
+     * original fixed step march.
+     */
+    struct MarchPolicy {
+        enum StepMode {
+            // Sample every stepSize.
+            STEP_FIXED,
+            // Step is stepRatio * distance, clamped to [stepSize, maxStepSize].
+            STEP_DISTANCE,
+            // Step is emptyStepScale * stepSize until density appears, then
+            // the march backs off and continues by stepSize until
+            // refineSteps samples in a row are empty.
+            STEP_ADAPTIVE,
+        };
+
+        StepMode stepMode = STEP_FIXED;
+        float stepRatio = 0.015;
+        float maxStepSize = 6.0;
+        float emptyStepScale = 4.0;
+        int refineSteps = 6;
+
+        // March stops once transmittance (1 - alpha) falls to this value.
+        float minTransmittance = 0.0;
+
+        /**
+         * Parses "fixed", "distance" or "adaptive".
+         */
+        static bool parseStepMode(const char *name, StepMode &mode);
+    };
+
+    /**
+     * CPU reference implementation of shaders/clouds.comp.
+     *
+     * Layer parameters mirror the shader globals; render() splits the image
+     * into tiles matching the compute shader work groups and marches them on
+     * the thread pool.
+     */
+    class CloudMarcher {
+    public:
+
+        struct Ray {
+            vec3 origin;
+            vec3 direction;
+        };
+
+        float lowerLayer = 75;
+        float upperLayer = 175;
+        float layerEase = 25;
+        float layerOffset = 7.5;
+
+        float maxDistance = 750;
+        float distanceEase = 150;
+        int stepCount = 150;
+        float stepSize = 1.7;
+
+        float timeFactor = 0.012;
+
+        vec3 sunPosition = vec3(0.0, 1e10, 0.0);
+
+        // March covers stepSize * stepCount from the eye for every policy.
+        MarchPolicy policy;
+
+        // Skip tiles whose rays cannot reach the slab, as Clouds does.
+        bool cullTiles = true;
+
+        static const int TILE_WIDTH = 16;
+        static const int TILE_HEIGHT = 4;
+
+    private:
+        ThreadPool *pool;
+        const DensityVolume *densityVolume;
+        const OccupancyGrid *occupancyGrid;
+        const LightVolume *lightVolume;
+        float time;
+
+    public:
+        /**
+         * Without pool the image is rendered on the calling thread.
+         */
+        CloudMarcher(ThreadPool *pool = NULL);
+
+        /**
+         * Inverse of view projection moved to the eye, pixel rays point
+         * along its product with vec4(ndc, 1, 1). Inverse of the view
+         * projection itself adds eye times the tiny w of the far plane to
+         * them, which bends and blurs the rays far from the origin.
+         */
+        static mat4 rayMatrix(const mat4 &viewProjection, vec3 eyePosition);
+
+        /**
+         * Renders cloud image the same way Clouds::render dispatches
+         * clouds.comp. Output frame size determines the downscale factor,
+         * depth is the full resolution landscape depth buffer. Inverse view
+         * projection is the rayMatrix().
+         */
+        void render(vec3 eyePosition, const mat4 &invVP, float time,
+                const float *depth, ivec2 screenSize, CloudFrame &frame);
+
+        /**
+         * Fills the pixels of tile with the result of a march that ends
+         * before the slab and returns true when no ray of the tile can
+         * start marching, see CloudTiles. Clouds decides the same in
+         * shaders/cloud-tiles.comp.
+         */
+        bool cullTile(ivec2 tile, vec3 eyePosition, const mat4 &invVP, const float *depth, ivec2 screenSize,
+                CloudFrame &frame) const;
+
+        /**
+         * Returns number of cloudMap calls made for the pixel.
+         */
+        unsigned renderPixel(int x, int y, vec3 eyePosition, const mat4 &invVP,
+                const float *depth, ivec2 screenSize, CloudFrame &frame);
+
+        /**
+         * Calls, if given, is increased by the number of cloudMap calls.
+         */
+        vec4 marchClouds(const Ray &r, float &depth, unsigned *calls = NULL);
+        float marchBrightness(vec4 p, unsigned *calls = NULL);
+        float cloudMap(vec4 p) const;
+
+        inline void setTime(float _time) {
+            time = _time;
+        }
+
+        /**
+         * Makes cloudMap read density from baked volume where it covers the
+         * sample, NULL switches back to the procedural path.
+         */
+        inline void setDensityVolume(const DensityVolume *volume) {
+            densityVolume = volume;
+        }
+
+        /**
+         * Makes marchClouds jump over cells the grid marks empty. Grid has
+         * to be updated for the time passed to render(), NULL disables it.
+         */
+        inline void setOccupancyGrid(const OccupancyGrid *grid) {
+            occupancyGrid = grid;
+        }
+
+        /**
+         * Makes marchClouds read brightness from the volume where it covers
+         * the sample instead of marching toward the sun, NULL disables it.
+         */
+        inline void setLightVolume(const LightVolume *volume) {
+            lightVolume = volume;
+        }
+
+        /**
+         * Moves point by the wind, q in cloudMap.
+         */
+        static inline vec4 advect(vec4 p) {
+            return p + vec4(0.7, 0.0, 0.44, 0.0) * p.w * 25.0f;
+        }
+
+        /**
+         * Distance the march covers from the eye.
+         */
+        inline float getRange() const {
+            return stepSize * stepCount;
+        }
+
+        static float distanceToLayer(const Ray &r, float height);
+    };
+
+}
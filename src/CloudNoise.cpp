@@ -0,0 +1,35 @@
+#include "CloudNoise.hpp"
+
+using namespace pgp;
+
+float CloudNoise::hash(int q) {
+    return Noise<1>::hash(&q);
+}
+
+float CloudNoise::hash(ivec2 q) {
+    return Noise<2>::hash(&q.x);
+}
+
+float CloudNoise::hash(ivec3 q) {
+    return Noise<3>::hash(&q.x);
+}
+
+float CloudNoise::hash(ivec4 q) {
+    return Noise<4>::hash(&q.x);
+}
+
+float CloudNoise::noise(float q) {
+    return Noise<1>::noise(&q);
+}
+
+float CloudNoise::noise(vec2 q) {
+    return Noise<2>::noise(&q.x);
+}
+
+float CloudNoise::noise(vec3 q) {
+    return Noise<3>::noise(&q.x);
+}
+
+float CloudNoise::noise(vec4 q) {
+    return Noise<4>::noise(&q.x);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Noise.hpp"
+
+namespace pgp {
+
+    using glm::vec2;
+    using glm::vec3;
+    using glm::vec4;
+    using glm::ivec2;
+    using glm::ivec3;
+    using glm::ivec4;
+
+    /**
+     * Hash and value noise of clouds.comp on vectors, wrappers of Noise.
+     *
+     * Integer arithmetic wraps around the same way as in GLSL, so the results
+     * match the shader up to floating point precision of cos().
+     */
+    class CloudNoise {
+    public:
+        static float hash(int q);
+        static float hash(ivec2 q);
+        static float hash(ivec3 q);
+        static float hash(ivec4 q);
+
+        static float noise(float q);
+        static float noise(vec2 q);
+        static float noise(vec3 q);
+        static float noise(vec4 q);
+
+        static inline float mixCos(float x, float y, float a) {
+            return NoiseBase::mixCos(x, y, a);
+        }
+    };
+
+}
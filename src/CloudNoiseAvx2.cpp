@@ -0,0 +1,71 @@
+#include "CloudNoiseSimd.hpp"
+#include "Noise.hpp"
+
+using namespace pgp;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+#include "CloudNoiseKernel.hpp"
+
+namespace {
+
+    struct Avx2 {
+        typedef __m256 F;
+        typedef __m256i I;
+
+        static const int WIDTH = 8;
+
+        static inline F load(const float *p) { return _mm256_loadu_ps(p); }
+        static inline void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+        static inline F set1(float v) { return _mm256_set1_ps(v); }
+        static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+        static inline F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static inline F div(F a, F b) { return _mm256_div_ps(a, b); }
+        static inline F min(F a, F b) { return _mm256_min_ps(a, b); }
+        static inline F max(F a, F b) { return _mm256_max_ps(a, b); }
+        static inline F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static inline F floor(F a) { return _mm256_floor_ps(a); }
+        static inline F cvt(I a) { return _mm256_cvtepi32_ps(a); }
+        static inline I cvtt(F a) { return _mm256_cvttps_epi32(a); }
+
+        static inline I set1i(int v) { return _mm256_set1_epi32(v); }
+        static inline I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+        static inline I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+        static inline I muli(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static inline I andi(I a, I b) { return _mm256_and_si256(a, b); }
+        static inline I srli16(I a) { return _mm256_srli_epi32(a, 16); }
+    };
+
+}
+
+size_t CloudNoiseSimd::noiseAvx2(const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count) {
+    return noiseBatch<Avx2>(x, y, z, w, out, count);
+}
+
+size_t CloudNoiseSimd::cloudMapAvx2(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count) {
+    return cloudMapBatch<Avx2>(layer, x, y, z, w, out, count);
+}
+
+#pragma GCC pop_options
+
+#else
+
+size_t CloudNoiseSimd::noiseAvx2(const float *, const float *, const float *, const float *,
+        float *, size_t) {
+    return 0;
+}
+
+size_t CloudNoiseSimd::cloudMapAvx2(const Layer &, const float *, const float *, const float *, const float *,
+        float *, size_t) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#pragma once
+
+/*
+ * Vector kernels of CloudNoiseSimd, shared by the per-ISA translation units.
+ *
+ * V is a traits structure wrapping intrinsics of one instruction set.
+ * Including file has to include CloudNoiseSimd.hpp and Noise.hpp before its
+ * target pragma and this header after it. Everything here has internal
+ * linkage, so no code compiled for a wider ISA can leak into the scalar
+ * build; only constants are taken from Noise.
+ */
+
+namespace {
+
+    using pgp::CloudNoiseSimd;
+    using pgp::NoiseBase;
+    using pgp::NoiseLattice;
+
+    /**
+     * (1 - cos(a * PI)) / 2 for a in [0, 1], computed as
+     * (1 + sin((a - 0.5) * PI)) / 2 with Taylor series up to u^11.
+     * Truncation error is below 6e-8.
+     */
+    template<class V>
+    inline typename V::F mixFactor(typename V::F a) {
+        typedef typename V::F F;
+
+        F u = V::mul(V::sub(a, V::set1(0.5f)), V::set1(3.141592653589793f));
+        F u2 = V::mul(u, u);
+
+        F s = V::set1(-1.0f / 39916800.0f);
+        s = V::add(V::mul(s, u2), V::set1(1.0f / 362880.0f));
+        s = V::add(V::mul(s, u2), V::set1(-1.0f / 5040.0f));
+        s = V::add(V::mul(s, u2), V::set1(1.0f / 120.0f));
+        s = V::add(V::mul(s, u2), V::set1(-1.0f / 6.0f));
+        s = V::add(V::mul(s, u2), V::set1(1.0f));
+        s = V::mul(s, u);
+
+        return V::mul(V::add(V::set1(1.0f), s), V::set1(0.5f));
+    }
+
+    template<class V>
+    inline typename V::F mix(typename V::F x, typename V::F y, typename V::F a) {
+        return V::add(V::mul(x, V::sub(V::set1(1.0f), a)), V::mul(y, a));
+    }
+
+    /**
+     * NoiseBase::hash() of keys.
+     */
+    template<class V>
+    inline typename V::F hash(typename V::I q) {
+        typedef typename V::I I;
+
+        q = V::addi(V::muli(q, q), V::set1i(NoiseBase::KEY_OFFSET));
+        I n = V::muli(q, V::set1i(NoiseBase::KEY_MULTIPLIER));
+
+        I v = V::addi(V::muli(n, V::set1i(NoiseBase::MIX_MULTIPLIER)), V::set1i(NoiseBase::MIX_OFFSET));
+        v = V::andi(v, V::set1i(int(NoiseBase::MIX_MASK)));
+        v = V::subi(v, V::set1i(NoiseBase::MIX_SUBTRAHEND));
+        v = V::muli(v, V::set1i(int(NoiseBase::MIX_FACTOR)));
+        v = V::muli(v, n);
+
+        // Unsigned to float conversion with single rounding, then division
+        // by float(UINT_MAX) which is 2^32.
+        typename V::F hi = V::cvt(V::srli16(v));
+        typename V::F lo = V::cvt(V::andi(v, V::set1i(0xffff)));
+        typename V::F f = V::add(V::mul(hi, V::set1(65536.0f)), lo);
+
+        return V::mul(f, V::set1(1.0f / 4294967296.0f));
+    }
+
+    /**
+     * Noise<4>::noise(), corners are reduced in the same order.
+     */
+    template<class V>
+    inline typename V::F noise(typename V::F x, typename V::F y, typename V::F z, typename V::F w) {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        F x0 = V::floor(x);
+        F y0 = V::floor(y);
+        F z0 = V::floor(z);
+        F w0 = V::floor(w);
+
+        F fx = mixFactor<V>(V::sub(x, x0));
+        F fy = mixFactor<V>(V::sub(y, y0));
+        F fz = mixFactor<V>(V::sub(z, z0));
+        F fw = mixFactor<V>(V::sub(w, w0));
+
+        typedef NoiseLattice<4> Lattice;
+        constexpr int DX = Lattice::MULTIPLIERS[0], DY = Lattice::MULTIPLIERS[1];
+        constexpr int DZ = Lattice::MULTIPLIERS[2], DW = Lattice::MULTIPLIERS[3];
+
+        I h = V::set1i(Lattice::OFFSETS[0] + Lattice::OFFSETS[1] + Lattice::OFFSETS[2] + Lattice::OFFSETS[3]);
+        h = V::addi(h, V::muli(V::cvtt(x0), V::set1i(DX)));
+        h = V::addi(h, V::muli(V::cvtt(y0), V::set1i(DY)));
+        h = V::addi(h, V::muli(V::cvtt(z0), V::set1i(DZ)));
+        h = V::addi(h, V::muli(V::cvtt(w0), V::set1i(DW)));
+
+        F cube[2];
+        for (int cw = 0; cw < 2; cw++) {
+            F quad[2];
+            for (int cz = 0; cz < 2; cz++) {
+                I base = V::addi(h, V::set1i(cz * DZ + cw * DW));
+
+                F a = hash<V>(base);
+                F b = hash<V>(V::addi(base, V::set1i(DX)));
+                F c = hash<V>(V::addi(base, V::set1i(DX + DY)));
+                F d = hash<V>(V::addi(base, V::set1i(DY)));
+
+                F ab = mix<V>(a, b, fx);
+                F dc = mix<V>(d, c, fx);
+                quad[cz] = mix<V>(ab, dc, fy);
+            }
+            cube[cw] = mix<V>(quad[0], quad[1], fz);
+        }
+
+        return mix<V>(cube[0], cube[1], fw);
+    }
+
+    template<class V>
+    inline typename V::F clamp01(typename V::F v) {
+        return V::min(V::max(v, V::set1(0.0f)), V::set1(1.0f));
+    }
+
+    /**
+     * cloudMap() from clouds.comp.
+     */
+    template<class V>
+    inline typename V::F cloudMap(const CloudNoiseSimd::Layer &layer,
+            typename V::F x, typename V::F y, typename V::F z, typename V::F w) {
+        typedef typename V::F F;
+
+        F qx = V::add(x, V::mul(V::mul(V::set1(0.7f), w), V::set1(25.0f)));
+        F qy = y;
+        F qz = V::add(z, V::mul(V::mul(V::set1(0.44f), w), V::set1(25.0f)));
+        F qw = w;
+
+        const float scales[] = { 256.0f, 128.0f, 64.0f, 48.0f, 32.0f };
+        F n[5];
+        for (int i = 0; i < 5; i++) {
+            F s = V::set1(scales[i]);
+            n[i] = noise<V>(V::div(qx, s), V::div(qy, s), V::div(qz, s), V::div(qw, s));
+        }
+
+        F f = V::mul(V::set1(0.25f), n[0]);
+        f = V::add(f, V::mul(V::set1(0.35f), n[1]));
+        f = V::add(f, V::mul(V::set1(0.225f), n[2]));
+        f = V::sub(f, V::div(V::mul(V::set1(0.225f), n[3]), V::set1(2.0f)));
+        f = V::add(f, V::mul(V::set1(0.0625f), n[4]));
+
+        F easeScale = V::set1(layer.layerEase);
+        F upperEase = clamp01<V>(V::div(V::sub(V::set1(layer.upperLayer - layer.layerOffset), qy), easeScale));
+        F lowerEase = clamp01<V>(V::div(V::sub(V::sub(qy, V::set1(layer.lowerLayer)), V::set1(layer.layerOffset)), easeScale));
+
+        F ease = V::sub(V::set1(1.0f), V::abs(V::sub(upperEase, lowerEase)));
+
+        F density = clamp01<V>(V::sub(V::mul(f, V::set1(1.35f)), V::set1(0.5f)));
+
+        return V::mul(density, ease);
+    }
+
+    template<class V>
+    size_t noiseBatch(const float *x, const float *y, const float *z, const float *w,
+            float *out, size_t count) {
+        size_t i = 0;
+        for (; i + V::WIDTH <= count; i += V::WIDTH) {
+            V::store(out + i, noise<V>(V::load(x + i), V::load(y + i), V::load(z + i), V::load(w + i)));
+        }
+        return i;
+    }
+
+    template<class V>
+    size_t cloudMapBatch(const CloudNoiseSimd::Layer &layer, const float *x, const float *y, const float *z, const float *w,
+            float *out, size_t count) {
+        size_t i = 0;
+        for (; i + V::WIDTH <= count; i += V::WIDTH) {
+            V::store(out + i, cloudMap<V>(layer, V::load(x + i), V::load(y + i), V::load(z + i), V::load(w + i)));
+        }
+        return i;
+    }
+
+}
@@ -0,0 +1,97 @@
+#include "CloudNoiseSimd.hpp"
+#include "CloudNoise.hpp"
+
+using namespace pgp;
+
+CloudNoiseSimd::Isa CloudNoiseSimd::getBestIsa() {
+    static Isa best = isSupported(ISA_AVX2) ? ISA_AVX2
+            : isSupported(ISA_SSE4) ? ISA_SSE4 : ISA_SCALAR;
+
+    return best;
+}
+
+bool CloudNoiseSimd::isSupported(Isa isa) {
+    switch (isa) {
+        case ISA_SCALAR:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case ISA_SSE4:
+            return __builtin_cpu_supports("sse4.1");
+        case ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *CloudNoiseSimd::getIsaName(Isa isa) {
+    switch (isa) {
+        case ISA_SCALAR:
+            return "scalar";
+        case ISA_SSE4:
+            return "sse4";
+        case ISA_AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+void CloudNoiseSimd::noise(const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count, Isa isa) {
+    size_t done = 0;
+
+    if (!isSupported(isa)) {
+        isa = ISA_SCALAR;
+    }
+
+    switch (isa) {
+        case ISA_AVX2:
+            done = noiseAvx2(x, y, z, w, out, count);
+            break;
+        case ISA_SSE4:
+            done = noiseSse4(x, y, z, w, out, count);
+            break;
+        case ISA_SCALAR:
+            break;
+    }
+
+    for (size_t i = done; i < count; i++) {
+        out[i] = CloudNoise::noise(vec4(x[i], y[i], z[i], w[i]));
+    }
+}
+
+void CloudNoiseSimd::cloudMap(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count, Isa isa) {
+    size_t done = 0;
+
+    if (!isSupported(isa)) {
+        isa = ISA_SCALAR;
+    }
+
+    switch (isa) {
+        case ISA_AVX2:
+            done = cloudMapAvx2(layer, x, y, z, w, out, count);
+            break;
+        case ISA_SSE4:
+            done = cloudMapSse4(layer, x, y, z, w, out, count);
+            break;
+        case ISA_SCALAR:
+            break;
+    }
+
+    if (done == count) {
+        return;
+    }
+
+    CloudMarcher marcher;
+    marcher.lowerLayer = layer.lowerLayer;
+    marcher.upperLayer = layer.upperLayer;
+    marcher.layerEase = layer.layerEase;
+    marcher.layerOffset = layer.layerOffset;
+
+    for (size_t i = done; i < count; i++) {
+        out[i] = marcher.cloudMap(vec4(x[i], y[i], z[i], w[i]));
+    }
+}
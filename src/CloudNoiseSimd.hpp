@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+
+#include "CloudMarcher.hpp"
+
+namespace pgp {
+
+    /**
+     * Batched evaluation of CloudNoise::noise(vec4) and cloudMap for points
+     * in SoA layout. Kernel is chosen at runtime from the instruction sets
+     * supported by the CPU.
+     *
+     * Vector kernels approximate cos() by a polynomial, results differ from
+     * the scalar path by at most TOLERANCE.
+     */
+    class CloudNoiseSimd {
+    public:
+
+        enum Isa {
+            ISA_SCALAR,
+            ISA_SSE4,
+            ISA_AVX2,
+        };
+
+        /**
+         * Cloud layer parameters used by the cloudMap kernel.
+         */
+        struct Layer {
+            float lowerLayer;
+            float upperLayer;
+            float layerEase;
+            float layerOffset;
+
+            Layer(const CloudMarcher &marcher) :
+                lowerLayer(marcher.lowerLayer), upperLayer(marcher.upperLayer),
+                layerEase(marcher.layerEase), layerOffset(marcher.layerOffset) {
+            }
+        };
+
+        static constexpr float TOLERANCE = 1e-5f;
+
+        static Isa getBestIsa();
+
+        static bool isSupported(Isa isa);
+
+        static const char *getIsaName(Isa isa);
+
+        /**
+         * out[i] = noise(vec4(x[i], y[i], z[i], w[i]))
+         */
+        static void noise(const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count, Isa isa = getBestIsa());
+
+        /**
+         * out[i] = cloudMap(vec4(x[i], y[i], z[i], w[i]))
+         */
+        static void cloudMap(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count, Isa isa = getBestIsa());
+
+    private:
+        static size_t noiseSse4(const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count);
+        static size_t noiseAvx2(const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count);
+
+        static size_t cloudMapSse4(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count);
+        static size_t cloudMapAvx2(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+                float *out, size_t count);
+    };
+
+}
@@ -0,0 +1,71 @@
+#include "CloudNoiseSimd.hpp"
+#include "Noise.hpp"
+
+using namespace pgp;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+#include <immintrin.h>
+
+#include "CloudNoiseKernel.hpp"
+
+namespace {
+
+    struct Sse4 {
+        typedef __m128 F;
+        typedef __m128i I;
+
+        static const int WIDTH = 4;
+
+        static inline F load(const float *p) { return _mm_loadu_ps(p); }
+        static inline void store(float *p, F v) { _mm_storeu_ps(p, v); }
+        static inline F set1(float v) { return _mm_set1_ps(v); }
+        static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+        static inline F sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static inline F div(F a, F b) { return _mm_div_ps(a, b); }
+        static inline F min(F a, F b) { return _mm_min_ps(a, b); }
+        static inline F max(F a, F b) { return _mm_max_ps(a, b); }
+        static inline F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static inline F floor(F a) { return _mm_floor_ps(a); }
+        static inline F cvt(I a) { return _mm_cvtepi32_ps(a); }
+        static inline I cvtt(F a) { return _mm_cvttps_epi32(a); }
+
+        static inline I set1i(int v) { return _mm_set1_epi32(v); }
+        static inline I addi(I a, I b) { return _mm_add_epi32(a, b); }
+        static inline I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+        static inline I muli(I a, I b) { return _mm_mullo_epi32(a, b); }
+        static inline I andi(I a, I b) { return _mm_and_si128(a, b); }
+        static inline I srli16(I a) { return _mm_srli_epi32(a, 16); }
+    };
+
+}
+
+size_t CloudNoiseSimd::noiseSse4(const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count) {
+    return noiseBatch<Sse4>(x, y, z, w, out, count);
+}
+
+size_t CloudNoiseSimd::cloudMapSse4(const Layer &layer, const float *x, const float *y, const float *z, const float *w,
+        float *out, size_t count) {
+    return cloudMapBatch<Sse4>(layer, x, y, z, w, out, count);
+}
+
+#pragma GCC pop_options
+
+#else
+
+size_t CloudNoiseSimd::noiseSse4(const float *, const float *, const float *, const float *,
+        float *, size_t) {
+    return 0;
+}
+
+size_t CloudNoiseSimd::cloudMapSse4(const Layer &, const float *, const float *, const float *, const float *,
+        float *, size_t) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,438 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/rotate_vector.hpp>
+
+#include "CloudMarcher.hpp"
+#include "CloudReprojection.hpp"
+#include "CloudUpsample.hpp"
+#include "DensityVolume.hpp"
+#include "HeightPyramid.hpp"
+#include "LightVolume.hpp"
+#include "OccupancyGrid.hpp"
+#include "TerrainGenerator.hpp"
+#include "ThreadPool.hpp"
+
+#define DIV_ROUND_UP(x,d) ((x + d - 1)/d)
+
+// Camera turn and shader time per frame of the amortized sequence, 60 FPS.
+#define AMORTIZE_YAW_STEP 0.002
+#define AMORTIZE_TIME_STEP (10.0 / 60.0)
+
+using namespace std;
+using namespace pgp;
+using namespace glm;
+
+/**
+ * Offline cloud renderer using the CPU reference marcher.
+ *
+ * Camera matrices are built the same way as in Landscape, so the output
+ * matches what bin/ray-marching shows from the same position.
+ */
+
+static void usage(const char *name) {
+    cerr << "Usage: " << name << " [options]" << endl
+            << "  -o FILE        output image (PPM), default clouds.ppm" << endl
+            << "  -s W H         screen size, default 1200 800" << endl
+            << "  -d N           downscale factor, default 4" << endl
+            << "  -t TIME        shader time uniform, default 0" << endl
+            << "  -e X Y Z       eye position, default 0 35 0" << endl
+            << "  -r PITCH YAW   camera rotation in radians, default -0.4 0" << endl
+            << "  -j N           thread count, default all cores" << endl
+            << "  -b SIZE        march baked density volume with given voxel size" << endl
+            << "  -g SIZE        skip empty cells of occupancy grid with given cell size" << endl
+            << "  -l SIZE        read sun brightness from light volume with given voxel size" << endl
+            << "  -p POLICY      march step policy: fixed (default), distance or adaptive" << endl
+            << "  -x T           stop the march once transmittance falls to T, default 0" << endl
+            << "  -a N           march 1 of N*N pixels per frame and reproject the rest," << endl
+            << "                 renders 2*N*N frames of a slow camera turn" << endl
+            << "  -c             render plain procedural clouds with fixed steps too and compare" << endl
+            << "  -T             march against depth of the terrain Landscape shows around the eye" << endl
+            << "  -u MODE        upsample to screen size: bilinear or bilateral, see blend.frag" << endl
+            << "  -f             march at full resolution too and compare the upsampled image" << endl
+            << "  -k             march every tile, also those whose rays cannot reach the slab" << endl;
+}
+
+static double milliseconds(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static float rootMeanSquareError(const CloudFrame &a, const CloudFrame &b) {
+    double sum = 0;
+    for (size_t i = 0; i < a.color.size(); i++) {
+        vec4 d = a.color[i] - b.color[i];
+        sum += dot(d, d) / 4.0;
+    }
+    return sqrt(sum / a.color.size());
+}
+
+/**
+ * Distance to the terrain mesh Landscape draws around eye for every pixel,
+ * as landscape.frag writes it, 1e15 where no terrain is hit.
+ */
+static void terrainDepth(vec3 eye, const mat4 &invVP, ivec2 screenSize, ThreadPool *pool, vector<float> &depth) {
+    const int size = LANDSCAPE_SIZE + 1;
+    ivec2 origin = TerrainGenerator::getGridOrigin(eye);
+
+    vector<float> heights(size * size);
+
+    for (int x = 0; x < size; x++) {
+        for (int z = 0; z < size; z++) {
+            heights[x * size + z] = TerrainGenerator::latticeHeight(origin.x + x, origin.y + z);
+        }
+    }
+
+    HeightPyramid pyramid(pool);
+    pyramid.build(&heights[0], ivec2(size), vec2(origin) * float(RESOLUTION), RESOLUTION);
+
+    vector<vec3> eyes(screenSize.x * screenSize.y, eye);
+    vector<vec3> directions(screenSize.x * screenSize.y);
+
+    for (int y = 0; y < screenSize.y; y++) {
+        for (int x = 0; x < screenSize.x; x++) {
+            vec2 fCoords = vec2(x, y) / vec2(screenSize);
+            directions[y * screenSize.x + x] = normalize(vec3(invVP * vec4(fCoords * 2.0f - 1.0f, 1, 1)));
+        }
+    }
+
+    depth.resize(screenSize.x * screenSize.y);
+    pyramid.intersect(&eyes[0], &directions[0], &depth[0], depth.size());
+
+    for (float &d : depth) {
+        if (std::isinf(d)) {
+            d = 1e15f;
+        }
+    }
+}
+
+/**
+ * Cloud layer premultiplied by alpha, as CloudUpsample returns it.
+ */
+static vector<vec4> premultiply(const CloudFrame &frame) {
+    vector<vec4> layer(frame.color.size());
+
+    for (size_t i = 0; i < layer.size(); i++) {
+        vec4 c = frame.color[i];
+        layer[i] = vec4(vec3(c) * c.a, c.a);
+    }
+
+    return layer;
+}
+
+static void writePPM(const string &filename, ivec2 size, const vector<vec4> &layer, const float *depth) {
+    ofstream file(filename.c_str(), ios::binary);
+
+    if (!file) {
+        throw string("Could not write file '" + filename + "'.");
+    }
+
+    file << "P6" << endl;
+    file << size.x << " " << size.y << endl;
+    file << "255" << endl;
+
+    // Clouds over the sky color used by Landscape and flat terrain where
+    // depth is given, image rows go bottom up.
+    vec3 sky(0.0, 0.7, 1.0);
+    vec3 terrain(0.3, 0.45, 0.2);
+    for (int y = size.y - 1; y >= 0; y--) {
+        for (int x = 0; x < size.x; x++) {
+            vec4 c = layer[y * size.x + x];
+            vec3 back = depth && depth[y * size.x + x] < 1e15f ? terrain : sky;
+            vec3 rgb = back * (1 - c.a) + vec3(c);
+
+            unsigned char px[] = {
+                (unsigned char) (rgb.r * 255),
+                (unsigned char) (rgb.g * 255),
+                (unsigned char) (rgb.b * 255),
+            };
+            file.write((char*) px, sizeof (px));
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    string output("clouds.ppm");
+    ivec2 screenSize(1200, 800);
+    int downscale = 4;
+    float time = 0;
+    vec3 eye(0.0, 35.0, 0.0);
+    vec2 rotation(-0.4, 0.0);
+    unsigned threads = 0;
+    float voxelSize = 0;
+    float cellSize = 0;
+    float lightSize = 0;
+    bool compare = false;
+    bool terrain = false;
+    bool upsample = false;
+    bool compareFull = false;
+    bool cullTiles = true;
+    CloudUpsample::Mode upsampleMode = CloudUpsample::UPSAMPLE_BILINEAR;
+    MarchPolicy policy;
+    int pattern = 1;
+
+    for (int i = 1; i < argc; i++) {
+        int left = argc - i - 1;
+
+        if (strcmp(argv[i], "-o") == 0 && left >= 1) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && left >= 2) {
+            screenSize.x = atoi(argv[++i]);
+            screenSize.y = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && left >= 1) {
+            downscale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && left >= 1) {
+            time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && left >= 3) {
+            eye.x = atof(argv[++i]);
+            eye.y = atof(argv[++i]);
+            eye.z = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && left >= 2) {
+            rotation.x = atof(argv[++i]);
+            rotation.y = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && left >= 1) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && left >= 1) {
+            voxelSize = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 && left >= 1) {
+            cellSize = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && left >= 1) {
+            lightSize = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && left >= 1 && MarchPolicy::parseStepMode(argv[i + 1], policy.stepMode)) {
+            i++;
+        } else if (strcmp(argv[i], "-x") == 0 && left >= 1) {
+            policy.minTransmittance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 && left >= 1) {
+            pattern = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            compare = true;
+        } else if (strcmp(argv[i], "-T") == 0) {
+            terrain = true;
+        } else if (strcmp(argv[i], "-u") == 0 && left >= 1 && CloudUpsample::parseMode(argv[i + 1], upsampleMode)) {
+            upsample = true;
+            i++;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            compareFull = true;
+            upsample = true;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            cullTiles = false;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (screenSize.x <= 0 || screenSize.y <= 0 || downscale <= 0 || voxelSize < 0 || cellSize < 0 || lightSize < 0
+            || pattern <= 0 || (pattern & (pattern - 1)) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    mat4 projMat = perspective(radians(75.0f), float(screenSize.x) / screenSize.y, 0.001f, 1e5f);
+
+    auto viewProjection = [&](vec2 rotation) {
+        vec3 view = rotateY(rotateX(vec3(0, 0, 1), rotation.x), rotation.y);
+        return projMat * lookAt(eye, eye + view, vec3(0, 1, 0));
+    };
+
+    mat4 invVP = CloudMarcher::rayMatrix(viewProjection(rotation), eye);
+
+    ThreadPool pool(threads);
+
+    // Without terrain depth buffer holds the value Landscape clears it with.
+    vector<float> depth(screenSize.x * screenSize.y, 1e15f);
+
+    if (terrain) {
+        auto start = chrono::steady_clock::now();
+        terrainDepth(eye, invVP, screenSize, &pool, depth);
+
+        cout << "Terrain depth in " << milliseconds(start) << " ms" << endl;
+    }
+
+    CloudFrame frame;
+    frame.resize(DIV_ROUND_UP(screenSize, downscale));
+    CloudMarcher marcher(&pool);
+    marcher.policy = policy;
+    marcher.cullTiles = cullTiles;
+
+    DensityVolume volume(voxelSize, voxelSize / 2);
+
+    if (voxelSize > 0) {
+        auto start = chrono::steady_clock::now();
+        volume.bake(marcher, eye, time, &pool);
+
+        ivec3 size = volume.getSize();
+        cout << "Baked " << size.x << "x" << size.y << "x" << size.z
+                << " voxels, " << volume.getKeyframeCount() << " keyframes, "
+                << volume.getMemorySize() / (1024.0 * 1024.0) << " MiB in "
+                << milliseconds(start) << " ms" << endl;
+
+        if (!volume.covers(marcher, eye, time)) {
+            cerr << "Warning: march reaches beyond the baked density volume, "
+                    << "samples outside of it are computed procedurally." << endl;
+        }
+
+        marcher.setDensityVolume(&volume);
+    }
+
+    OccupancyGrid grid(cellSize);
+
+    if (cellSize > 0) {
+        auto start = chrono::steady_clock::now();
+        grid.update(marcher, eye, time, &pool);
+
+        ivec3 size = grid.getSize();
+        cout << "Built " << size.x << "x" << size.y << "x" << size.z << " occupancy grid, "
+                << grid.getEmptyFraction() * 100 << " % cells empty, in " << milliseconds(start) << " ms" << endl;
+
+        marcher.setOccupancyGrid(&grid);
+    }
+
+    LightVolume light(lightSize, lightSize * 0.625f);
+
+    if (lightSize > 0) {
+        auto start = chrono::steady_clock::now();
+        light.update(marcher, eye, &pool);
+
+        ivec3 size = light.getSize();
+        cout << "Built " << size.x << "x" << size.y << "x" << size.z << " light volume, "
+                << light.getMemorySize() / 1024.0 << " KiB in " << milliseconds(start) << " ms" << endl;
+
+        marcher.setLightVolume(&light);
+    }
+
+    int pixels = frame.size.x * frame.size.y;
+    int tileCount = DIV_ROUND_UP(frame.size.x, CloudMarcher::TILE_WIDTH)
+            * DIV_ROUND_UP(frame.size.y, CloudMarcher::TILE_HEIGHT);
+    double ms;
+
+    if (pattern > 1) {
+        CloudReprojection reprojection(&pool, pattern);
+        int frames = 2 * pattern * pattern;
+        // Statistics of the last pattern cycle, after history is complete.
+        int measured = pattern * pattern;
+        ReprojectionStats total;
+        unsigned long calls = 0;
+        double totalMs = 0;
+        int rebakes = 0;
+
+        for (int f = 0; f < frames; f++) {
+            vec2 r = rotation + vec2(0, f * AMORTIZE_YAW_STEP);
+            float t = time + f * AMORTIZE_TIME_STEP;
+
+            // Sequence may outlast the baked keyframes, bake is not timed.
+            if (voxelSize > 0 && !volume.covers(marcher, eye, t)) {
+                volume.bake(marcher, eye, t, &pool);
+                rebakes++;
+            }
+
+            auto start = chrono::steady_clock::now();
+            reprojection.render(marcher, eye, viewProjection(r), t, &depth[0], screenSize, frame);
+
+            if (f >= frames - measured) {
+                const ReprojectionStats &stats = reprojection.getStats();
+                total.marched += stats.marched;
+                total.reprojected += stats.reprojected;
+                total.rejected += stats.rejected;
+                total.culled += stats.culled;
+                calls += frame.cloudMapCalls;
+                totalMs += milliseconds(start);
+            }
+
+            if (f == frames - 1) {
+                invVP = CloudMarcher::rayMatrix(viewProjection(r), eye);
+                time = t;
+            }
+        }
+
+        ms = totalMs / measured;
+        unsigned long samples = (unsigned long) pixels * measured;
+
+        cout << "Rendered " << frames << " frames " << frame.size.x << "x" << frame.size.y
+                << " marching 1 of " << measured << " pixels, " << ms << " ms per frame using "
+                << pool.getThreadCount() << " threads, " << double(calls) / samples
+                << " cloudMap calls per pixel" << endl;
+        cout << "Reprojected " << 100.0 * total.reprojected / samples << " %, rejected "
+                << 100.0 * total.rejected / samples << " %, marched "
+                << 100.0 * total.marched / samples << " %, culled " << 100.0 * total.culled / samples
+                << " % of pixels" << endl;
+
+        if (rebakes > 0) {
+            cout << "Density volume re-baked " << rebakes << " times" << endl;
+        }
+    } else {
+        auto start = chrono::steady_clock::now();
+        marcher.render(eye, invVP, time, &depth[0], screenSize, frame);
+        ms = milliseconds(start);
+
+        cout << "Rendered " << frame.size.x << "x" << frame.size.y
+                << " in " << ms << " ms using " << pool.getThreadCount() << " threads, "
+                << double(frame.cloudMapCalls) / pixels << " cloudMap calls per pixel, "
+                << frame.culledTiles << " of " << tileCount << " tiles culled" << endl;
+    }
+
+    CloudUpsample upsampler(&pool, upsampleMode, 0.1, marcher.maxDistance);
+    vector<vec4> layer;
+    ivec2 layerSize = frame.size;
+
+    if (upsample) {
+        auto start = chrono::steady_clock::now();
+        upsampler.upsample(frame, &depth[0], screenSize, layer);
+        layerSize = screenSize;
+
+        cout << "Upsampled to " << screenSize.x << "x" << screenSize.y << " in " << milliseconds(start) << " ms" << endl;
+    } else {
+        layer = premultiply(frame);
+    }
+
+    if (compareFull) {
+        CloudFrame full;
+        full.resize(screenSize);
+
+        auto start = chrono::steady_clock::now();
+        marcher.render(eye, invVP, time, &depth[0], screenSize, full);
+        double fullMs = milliseconds(start);
+
+        // Composites full resolution the same way, nothing is filtered.
+        vector<vec4> reference;
+        upsampler.upsample(full, &depth[0], screenSize, reference);
+
+        ImageError error = CloudUpsample::measureError(layer, reference, &depth[0], screenSize);
+
+        cout << "Full resolution render in " << fullMs << " ms, speedup " << fullMs / ms
+                << "x, RMS error " << error.rms << ", PSNR " << error.psnr << " dB, edge RMS error "
+                << error.edgeRms << " over " << error.edgeFraction * 100 << " % of pixels" << endl;
+    }
+
+    if (compare) {
+        CloudFrame reference;
+        reference.resize(frame.size);
+
+        marcher.setDensityVolume(NULL);
+        marcher.setOccupancyGrid(NULL);
+        marcher.setLightVolume(NULL);
+        marcher.policy = MarchPolicy();
+
+        auto start = chrono::steady_clock::now();
+        marcher.render(eye, invVP, time, &depth[0], screenSize, reference);
+        double referenceMs = milliseconds(start);
+
+        cout << "Procedural render in " << referenceMs << " ms, "
+                << double(reference.cloudMapCalls) / pixels << " cloudMap calls per pixel, speedup "
+                << referenceMs / ms << "x, RMS error " << rootMeanSquareError(frame, reference) << endl;
+    }
+
+    try {
+        writePPM(output, layerSize, layer, upsample ? &depth[0] : NULL);
+    } catch (string &str) {
+        cerr << str << endl;
+        return 2;
+    }
+
+    return 0;
+}
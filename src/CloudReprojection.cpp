@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+
+#include "CloudReprojection.hpp"
+
+#define DIV_ROUND_UP(x,d) ((x + d - 1)/d)
+
+using namespace pgp;
+using namespace glm;
+
+CloudReprojection::CloudReprojection(ThreadPool *_pool, int _pattern, float _depthTolerance) :
+    pool(_pool), pattern(std::max(_pattern, 1)), depthTolerance(_depthTolerance),
+    frameIndex(0), historyValid(false), lastTime(0) {
+}
+
+void CloudReprojection::render(CloudMarcher &marcher, vec3 eyePosition, const mat4 &viewProjection,
+        float time, const float *depth, ivec2 screenSize, CloudFrame &frame) {
+
+    mat4 invVP = CloudMarcher::rayMatrix(viewProjection, eyePosition);
+
+    bool reproject = historyValid && pattern > 1 && history.size == frame.size;
+    vec3 windShift = vec3(CloudMarcher::advect(vec4(0, 0, 0, (time - lastTime) * marcher.timeFactor)));
+
+    marcher.setTime(time);
+
+    int tilesX = DIV_ROUND_UP(frame.size.x, CloudMarcher::TILE_WIDTH);
+    int tilesY = DIV_ROUND_UP(frame.size.y, CloudMarcher::TILE_HEIGHT);
+
+    vector<unsigned long> tileCalls(tilesX * tilesY);
+    vector<ReprojectionStats> tileStats(tilesX * tilesY);
+
+    auto renderTile = [&](unsigned tile) {
+        int x0 = (tile % tilesX) * CloudMarcher::TILE_WIDTH;
+        int y0 = (tile / tilesX) * CloudMarcher::TILE_HEIGHT;
+        int x1 = std::min(x0 + CloudMarcher::TILE_WIDTH, frame.size.x);
+        int y1 = std::min(y0 + CloudMarcher::TILE_HEIGHT, frame.size.y);
+
+        if (marcher.cullTiles && marcher.cullTile(ivec2(tile % tilesX, tile / tilesX), eyePosition, invVP,
+                depth, screenSize, frame)) {
+            tileStats[tile].culled = (x1 - x0) * (y1 - y0);
+            return;
+        }
+
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                if (reproject && !isMarchedPixel(x, y)) {
+                    if (reprojectPixel(x, y, eyePosition, invVP, windShift, frame)) {
+                        tileStats[tile].reprojected++;
+                        continue;
+                    }
+                    tileStats[tile].rejected++;
+                }
+
+                tileCalls[tile] += marcher.renderPixel(x, y, eyePosition, invVP, depth, screenSize, frame);
+                tileStats[tile].marched++;
+            }
+        }
+    };
+
+    if (pool) {
+        pool->run(tilesX * tilesY, renderTile);
+    } else {
+        for (int tile = 0; tile < tilesX * tilesY; tile++) {
+            renderTile(tile);
+        }
+    }
+
+    stats = ReprojectionStats();
+    frame.cloudMapCalls = 0;
+    frame.culledTiles = 0;
+    for (size_t tile = 0; tile < tileStats.size(); tile++) {
+        stats.marched += tileStats[tile].marched;
+        stats.reprojected += tileStats[tile].reprojected;
+        stats.rejected += tileStats[tile].rejected;
+        stats.culled += tileStats[tile].culled;
+        frame.cloudMapCalls += tileCalls[tile];
+        frame.culledTiles += tileStats[tile].culled > 0;
+    }
+
+    history = frame;
+    historyValid = true;
+    lastViewProjection = viewProjection;
+    lastEyePosition = eyePosition;
+    lastTime = time;
+    frameIndex++;
+}
+
+bool CloudReprojection::reprojectPixel(int x, int y, vec3 eyePosition, const mat4 &invVP,
+        vec3 windShift, CloudFrame &frame) const {
+
+    vec2 fCoords = vec2(x, y) / vec2(frame.size);
+    vec3 direction = normalize(vec3(invVP * vec4(fCoords * 2.0f - 1.0f, 1, 1)));
+
+    // Cloud depth of the same pixel in the last frame estimates the depth now.
+    int i = y * frame.size.x + x;
+    float distance = history.depth[i];
+
+    vec3 position = eyePosition + direction * distance + windShift;
+    vec4 clip = lastViewProjection * vec4(position, 1);
+
+    if (clip.w <= 0) {
+        return false;
+    }
+
+    vec2 uv = vec2(clip) / clip.w * 0.5f + 0.5f;
+    ivec2 last = ivec2(floor(uv * vec2(frame.size) + 0.5f));
+
+    if (last.x < 0 || last.y < 0 || last.x >= frame.size.x || last.y >= frame.size.y) {
+        return false;
+    }
+
+    int j = last.y * frame.size.x + last.x;
+    float lastDistance = length(position - lastEyePosition);
+
+    if (std::abs(lastDistance - history.depth[j]) > depthTolerance * history.depth[j]) {
+        return false;
+    }
+
+    frame.color[i] = history.color[j];
+    frame.depth[i] = distance;
+
+    return true;
+}
+
+int CloudReprojection::bayerIndex(int x, int y, int n) {
+    // M(2n) = [4 M(n), 4 M(n) + 2; 4 M(n) + 3, 4 M(n) + 1], low bits pick M(n).
+    static const int quadrant[2][2] = {{0, 2}, {3, 1}};
+
+    int index = 0;
+    for (int bit = 1; bit < n; bit <<= 1) {
+        index = index * 4 + quadrant[(y & bit) != 0][(x & bit) != 0];
+    }
+
+    return index;
+}
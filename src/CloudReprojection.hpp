@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "CloudMarcher.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using glm::ivec2;
+    using glm::vec3;
+    using glm::vec4;
+    using glm::mat4;
+
+    struct ReprojectionStats {
+        unsigned long marched = 0;
+        unsigned long reprojected = 0;
+        // Reprojection landed outside of the last frame or on another depth.
+        unsigned long rejected = 0;
+        // In tiles that cannot reach the slab, see CloudMarcher::cullTile.
+        unsigned long culled = 0;
+    };
+
+    /**
+     * Checkerboard amortized cloud rendering, CPU reference of the temporal
+     * path of shaders/clouds.comp.
+     *
+     * Pixels are split by their index in pattern x pattern Bayer matrix and
+     * each frame marches only those matching the frame number. The rest is
+     * reprojected from the last frame: the ray is extended to its previous
+     * cloud depth, moved by the wind and projected with the last view
+     * projection. Samples that fall outside of the last frame, or whose
+     * stored depth disagrees by more than depth tolerance, are marched.
+     */
+    class CloudReprojection {
+    private:
+        ThreadPool *pool;
+        int pattern;
+        float depthTolerance;
+
+        unsigned frameIndex;
+        bool historyValid;
+        CloudFrame history;
+        mat4 lastViewProjection;
+        vec3 lastEyePosition;
+        float lastTime;
+
+        ReprojectionStats stats;
+
+    public:
+        /**
+         * Pattern 1 marches every pixel each frame, 4 marches one pixel of 16.
+         * Pattern has to be a power of two.
+         */
+        CloudReprojection(ThreadPool *pool = NULL, int pattern = 4, float depthTolerance = 0.05);
+
+        /**
+         * Renders frame like CloudMarcher::render, given the view projection
+         * rather than its inverse, and keeps the result as the next history.
+         */
+        void render(CloudMarcher &marcher, vec3 eyePosition, const mat4 &viewProjection,
+                float time, const float *depth, ivec2 screenSize, CloudFrame &frame);
+
+        /**
+         * Fills pixel from history. Returns false when the pixel has to be
+         * marched.
+         */
+        bool reprojectPixel(int x, int y, vec3 eyePosition, const mat4 &invVP,
+                vec3 windShift, CloudFrame &frame) const;
+
+        /**
+         * Makes the next frame march every pixel.
+         */
+        inline void invalidate() {
+            historyValid = false;
+        }
+
+        inline bool isMarchedPixel(int x, int y) const {
+            return bayerIndex(x, y, pattern) == int(frameIndex % (pattern * pattern));
+        }
+
+        inline const ReprojectionStats &getStats() const {
+            return stats;
+        }
+
+        /**
+         * Position of pixel x, y in the order of n x n Bayer matrix, n is
+         * a power of two. Consecutive indices are spread over the matrix.
+         */
+        static int bayerIndex(int x, int y, int n);
+    };
+
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+
+#include "CloudTiles.hpp"
+
+using namespace pgp;
+using namespace glm;
+
+constexpr float CloudTiles::DIRECTION_MARGIN;
+
+void CloudTiles::getTileRect(ivec2 tile, ivec2 tileSize, ivec2 frameSize, vec2 &lo, vec2 &hi) {
+    ivec2 first = tile * tileSize;
+    ivec2 last = min(first + tileSize, frameSize) - 1;
+
+    lo = vec2(first) / vec2(frameSize) * 2.0f - 1.0f;
+    hi = vec2(last) / vec2(frameSize) * 2.0f - 1.0f;
+}
+
+vec2 CloudTiles::directionRange(const mat4 &invVP, vec2 lo, vec2 hi) {
+    vec3 dx = vec3(invVP[0]);
+    vec3 dy = vec3(invVP[1]);
+    vec3 origin = vec3(invVP[2] + invVP[3]);
+
+    vec3 corners[4] = {
+        origin + dx * lo.x + dy * lo.y,
+        origin + dx * hi.x + dy * lo.y,
+        origin + dx * hi.x + dy * hi.y,
+        origin + dx * lo.x + dy * hi.y,
+    };
+
+    vec3 edges[4] = {
+        dx * (hi.x - lo.x),
+        dy * (hi.y - lo.y),
+        dx * (lo.x - hi.x),
+        dy * (lo.y - hi.y),
+    };
+
+    vec2 range(INFINITY, -INFINITY);
+
+    for (int i = 0; i < 4; i++) {
+        vec3 p = corners[i];
+        vec3 e = edges[i];
+        float y = normalize(p).y;
+
+        range = vec2(std::min(range.x, y), std::max(range.y, y));
+
+        // Height of normalize(p + s * e) is stationary where its derivative,
+        // linear in s, is zero. Edges bulge up or down there.
+        float pe = dot(p, e);
+        float denominator = e.y * pe - p.y * dot(e, e);
+
+        if (denominator == 0) {
+            continue;
+        }
+
+        float s = (p.y * pe - e.y * dot(p, p)) / denominator;
+
+        if (s > 0 && s < 1) {
+            y = normalize(p + e * s).y;
+            range = vec2(std::min(range.x, y), std::max(range.y, y));
+        }
+    }
+
+    if (containsDirection(origin, dx, dy, lo, hi, vec3(0, 1, 0))) {
+        range.y = 1;
+    }
+
+    if (containsDirection(origin, dx, dy, lo, hi, vec3(0, -1, 0))) {
+        range.x = -1;
+    }
+
+    return range + vec2(-DIRECTION_MARGIN, DIRECTION_MARGIN);
+}
+
+SlabInterval CloudTiles::slabInterval(float eyeHeight, vec2 range, float lowerLayer, float upperLayer) {
+    SlabInterval empty = { INFINITY, -INFINITY };
+    SlabInterval interval;
+
+    // Branches of marchClouds, distances fall as the ray gets steeper.
+    if (eyeHeight < lowerLayer) {
+        if (range.y <= 0) {
+            return empty;
+        }
+
+        interval.near = (lowerLayer - eyeHeight) / range.y;
+        interval.far = range.x > 0 ? (upperLayer - eyeHeight) / range.x : INFINITY;
+    } else if (eyeHeight > upperLayer) {
+        if (range.x >= 0) {
+            return empty;
+        }
+
+        interval.near = (upperLayer - eyeHeight) / range.x;
+        interval.far = range.y < 0 ? (lowerLayer - eyeHeight) / range.y : INFINITY;
+    } else {
+        interval.near = 0;
+
+        if (range.x > 0) {
+            interval.far = (upperLayer - eyeHeight) / range.x;
+        } else if (range.y < 0) {
+            interval.far = (lowerLayer - eyeHeight) / range.y;
+        } else {
+            interval.far = INFINITY;
+        }
+    }
+
+    return interval;
+}
+
+SlabInterval CloudTiles::tileInterval(vec3 eyePosition, const mat4 &invVP, ivec2 tile, ivec2 tileSize,
+        ivec2 frameSize, float lowerLayer, float upperLayer) {
+
+    vec2 lo, hi;
+    getTileRect(tile, tileSize, frameSize, lo, hi);
+
+    return slabInterval(eyePosition.y, directionRange(invVP, lo, hi), lowerLayer, upperLayer);
+}
+
+bool CloudTiles::containsDirection(vec3 origin, vec3 dx, vec3 dy, vec2 lo, vec2 hi, vec3 direction) {
+    // Solves origin + x * dx + y * dy = k * direction by Cramer's rule.
+    float determinant = dot(dx, cross(dy, -direction));
+
+    if (determinant == 0) {
+        return false;
+    }
+
+    float x = dot(-origin, cross(dy, -direction)) / determinant;
+    float y = dot(dx, cross(-origin, -direction)) / determinant;
+    float k = dot(dx, cross(dy, -origin)) / determinant;
+
+    return k > 0 && x >= lo.x && x <= hi.x && y >= lo.y && y <= hi.y;
+}
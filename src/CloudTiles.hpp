@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace pgp {
+
+    using glm::ivec2;
+    using glm::vec2;
+    using glm::vec3;
+    using glm::mat4;
+
+    /**
+     * Distances along a ray at which it is inside of the cloud slab.
+     */
+    struct SlabInterval {
+        float near;
+        float far;
+
+        inline bool isEmpty() const {
+            return !(near <= far);
+        }
+    };
+
+    /**
+     * Conservative slab intervals of screen tiles, CPU side of
+     * shaders/cloud-tiles.comp.
+     *
+     * Pixel x, y of the cloud image marches direction
+     * normalize(vec3(invVP * vec4(ndc, 1, 1))) of CloudMarcher::rayMatrix,
+     * which is linear in ndc before the normalization. Directions of a tile
+     * therefore fill the spherical quad spanned by the rays of its corner
+     * pixels. The height component of its directions has no extreme inside
+     * of the quad but at the poles, so it ranges between the corners, the
+     * points where the edges bulge up or down and the poles when the quad
+     * contains them. Distances to the layer planes are monotonic in that
+     * component, so the range bounds the slab interval of every pixel.
+     */
+    class CloudTiles {
+    public:
+        // Widens direction ranges over rounding of per pixel directions.
+        static constexpr float DIRECTION_MARGIN = 1e-5f;
+
+        /**
+         * Normalized device coordinates of the rays of the first and the
+         * last pixel of tile, tiles are tile size pixels of frame size.
+         */
+        static void getTileRect(ivec2 tile, ivec2 tileSize, ivec2 frameSize, vec2 &lo, vec2 &hi);
+
+        /**
+         * Range of the height component of normalized directions over ndc
+         * rectangle lo, hi, widened by DIRECTION_MARGIN.
+         */
+        static vec2 directionRange(const mat4 &invVP, vec2 lo, vec2 hi);
+
+        /**
+         * Interval of rays from eye height with the height component of
+         * their direction in range, empty when none of them enters the slab.
+         * Near is the least distance at which marchClouds could start, far
+         * the greatest at which a ray leaves the slab, INFINITY for rays
+         * that stay in it.
+         */
+        static SlabInterval slabInterval(float eyeHeight, vec2 range, float lowerLayer, float upperLayer);
+
+        static SlabInterval tileInterval(vec3 eyePosition, const mat4 &invVP, ivec2 tile, ivec2 tileSize,
+                ivec2 frameSize, float lowerLayer, float upperLayer);
+
+        /**
+         * Whether the march of some pixel of the tile can start before
+         * limit, the least of maxDistance, march range and the farthest
+         * terrain depth of its pixels.
+         */
+        static inline bool isLive(const SlabInterval &interval, float limit) {
+            return interval.near < limit;
+        }
+
+    private:
+        /**
+         * Whether direction is a positive multiple of
+         * origin + ndc.x * dx + ndc.y * dy with ndc in lo, hi.
+         */
+        static bool containsDirection(vec3 origin, vec3 dx, vec3 dy, vec2 lo, vec2 hi, vec3 direction);
+    };
+
+}
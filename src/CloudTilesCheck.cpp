@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/rotate_vector.hpp>
+
+#include "CloudMarcher.hpp"
+#include "CloudTiles.hpp"
+
+using namespace std;
+using namespace pgp;
+using namespace glm;
+
+/**
+ * Checks that CloudTiles intervals are conservative.
+ *
+ * For random cameras below, inside and above the slab, every pixel ray of
+ * every tile has to lie in the direction range of its tile, and the
+ * distances at which it enters and leaves the slab in the tile interval.
+ * Direction ranges are also compared with a dense sampling of the tile to
+ * report how tight they are. Finally CloudMarcher renders frames against
+ * random depth with and without culling, which have to be the same.
+ * Exits with non-zero code on any failure.
+ */
+
+#define CAMERA_COUNT 300
+#define RENDER_COUNT 12
+// Samples per side of the dense sampling of a tile.
+#define DENSE_SAMPLES 33
+
+struct Camera {
+    vec3 eye;
+    mat4 invVP;
+    ivec2 frameSize;
+};
+
+static Camera randomCamera(mt19937 &rng, const CloudMarcher &marcher) {
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uniform_int_distribution<int> width(17, 400);
+    uniform_int_distribution<int> height(5, 250);
+
+    Camera c;
+    float heights[] = { 35.0f, marcher.lowerLayer, (marcher.lowerLayer + marcher.upperLayer) / 2, 400.0f };
+    c.eye = vec3(unit(rng) * 20000 - 10000, heights[rng() % 4] + (unit(rng) < 0.5f ? 0 : unit(rng) * 10 - 5),
+            unit(rng) * 20000 - 10000);
+    c.frameSize = ivec2(width(rng), height(rng));
+
+    // Pitches up to straight up and down, which put the poles on screen.
+    vec2 rotation(unit(rng) * 3.2f - 1.6f, unit(rng) * 6.3f);
+    float fov = radians(30.0f + unit(rng) * 90.0f);
+    vec3 view = rotateY(rotateX(vec3(0, 0, 1), rotation.x), rotation.y);
+    mat4 projection = perspective(fov, float(c.frameSize.x) / c.frameSize.y, 0.001f, 1e5f);
+
+    c.invVP = CloudMarcher::rayMatrix(projection * lookAt(c.eye, c.eye + view, vec3(0, 1, 0)), c.eye);
+
+    return c;
+}
+
+static vec3 pixelDirection(const mat4 &invVP, vec2 pixel, ivec2 frameSize) {
+    vec2 fCoords = pixel / vec2(frameSize);
+    return normalize(vec3(invVP * vec4(fCoords * 2.0f - 1.0f, 1, 1)));
+}
+
+/**
+ * Distances at which the ray enters and leaves the slab as marchClouds
+ * computes them, false when it does not enter it.
+ */
+static bool pixelInterval(const CloudMarcher &marcher, const CloudMarcher::Ray &r, SlabInterval &interval) {
+    float toUpper = CloudMarcher::distanceToLayer(r, marcher.upperLayer);
+    float toLower = CloudMarcher::distanceToLayer(r, marcher.lowerLayer);
+
+    if (r.origin.y < marcher.lowerLayer) {
+        interval.near = toLower;
+        interval.far = toUpper;
+    } else if (r.origin.y > marcher.upperLayer) {
+        interval.near = toUpper;
+        interval.far = toLower;
+    } else {
+        interval.near = 0;
+        interval.far = std::max(toLower, toUpper);
+    }
+
+    if (interval.far < 0) {
+        interval.far = INFINITY;
+    }
+
+    return interval.near >= 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(1103);
+    CloudMarcher marcher;
+    ivec2 tileSize(CloudMarcher::TILE_WIDTH, CloudMarcher::TILE_HEIGHT);
+
+    unsigned long tiles = 0, emptyTiles = 0, pixels = 0, failures = 0;
+    float maxSlack = 0;
+    double totalSlack = 0;
+
+    for (int i = 0; i < CAMERA_COUNT; i++) {
+        Camera c = randomCamera(rng, marcher);
+        ivec2 tileCount = (c.frameSize + tileSize - 1) / tileSize;
+
+        for (int ty = 0; ty < tileCount.y; ty++) {
+            for (int tx = 0; tx < tileCount.x; tx++) {
+                ivec2 tile(tx, ty);
+                vec2 lo, hi;
+                CloudTiles::getTileRect(tile, tileSize, c.frameSize, lo, hi);
+
+                vec2 range = CloudTiles::directionRange(c.invVP, lo, hi);
+                SlabInterval interval = CloudTiles::slabInterval(c.eye.y, range, marcher.lowerLayer, marcher.upperLayer);
+
+                tiles++;
+                emptyTiles += interval.isEmpty();
+
+                ivec2 first = tile * tileSize;
+                ivec2 last = min(first + tileSize, c.frameSize);
+
+                for (int y = first.y; y < last.y; y++) {
+                    for (int x = first.x; x < last.x; x++) {
+                        CloudMarcher::Ray r = { c.eye, pixelDirection(c.invVP, vec2(x, y), c.frameSize) };
+                        SlabInterval p;
+                        bool inside = r.direction.y >= range.x && r.direction.y <= range.y;
+                        bool enters = pixelInterval(marcher, r, p);
+                        bool covered = !enters || (p.near >= interval.near && p.far <= interval.far);
+
+                        pixels++;
+
+                        if (!inside || !covered) {
+                            if (failures++ < 10) {
+                                fprintf(stderr, "Camera %d tile %d %d pixel %d %d: direction y %g not in [%g, %g] "
+                                        "or slab [%g, %g] not in [%g, %g]\n", i, tx, ty, x, y, r.direction.y,
+                                        range.x, range.y, p.near, p.far, interval.near, interval.far);
+                            }
+                        }
+                    }
+                }
+
+                // Dense sampling of the tile rectangle finds nearly its extremes.
+                vec2 sampled(INFINITY, -INFINITY);
+                vec2 step = (vec2(last - 1) - vec2(first)) / float(DENSE_SAMPLES - 1);
+
+                for (int sy = 0; sy < DENSE_SAMPLES; sy++) {
+                    for (int sx = 0; sx < DENSE_SAMPLES; sx++) {
+                        vec3 d = pixelDirection(c.invVP, vec2(first) + step * vec2(sx, sy), c.frameSize);
+                        sampled = vec2(std::min(sampled.x, d.y), std::max(sampled.y, d.y));
+                    }
+                }
+
+                float slack = std::max(sampled.x - range.x, range.y - sampled.y);
+                maxSlack = std::max(maxSlack, slack);
+                totalSlack += slack;
+            }
+        }
+    }
+
+    printf("%lu tiles of %d cameras, %.1f %% without slab, %lu pixels, %lu outside of their tile interval\n",
+            tiles, CAMERA_COUNT, 100.0 * emptyTiles / tiles, pixels, failures);
+    printf("Direction range wider than dense sampling by %g on average, %g at most\n",
+            totalSlack / tiles, maxSlack);
+
+    // Culled tiles have to come out as if they were marched.
+    unsigned long culledTiles = 0, renderedTiles = 0, differences = 0;
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    marcher.setTime(3);
+
+    for (int i = 0; i < RENDER_COUNT; i++) {
+        Camera c = randomCamera(rng, marcher);
+        int downscale = 1 + i % 4;
+        ivec2 screenSize = c.frameSize * downscale;
+
+        // Terrain depth near and far, sky and zero, in blocks so some
+        // tiles are fully hidden.
+        vector<float> depth(screenSize.x * screenSize.y);
+        float block[4];
+
+        for (int y = 0; y < screenSize.y; y++) {
+            for (int x = 0; x < screenSize.x; x++) {
+                if ((x % 48) == 0) {
+                    for (float &b : block) {
+                        float u = unit(rng);
+                        b = u < 0.25f ? 0 : u < 0.5f ? unit(rng) * 50 : u < 0.75f ? unit(rng) * 1000 : 1e15f;
+                    }
+                }
+                depth[y * screenSize.x + x] = block[(y / 12) % 4];
+            }
+        }
+
+        CloudFrame culled, marched;
+        culled.resize(c.frameSize);
+        marched.resize(c.frameSize);
+
+        marcher.cullTiles = true;
+        marcher.render(c.eye, c.invVP, 3, &depth[0], screenSize, culled);
+        marcher.cullTiles = false;
+        marcher.render(c.eye, c.invVP, 3, &depth[0], screenSize, marched);
+
+        ivec2 tileCount = (c.frameSize + tileSize - 1) / tileSize;
+        culledTiles += culled.culledTiles;
+        renderedTiles += tileCount.x * tileCount.y;
+
+        for (size_t p = 0; p < culled.color.size(); p++) {
+            if (culled.color[p] != marched.color[p] || culled.depth[p] != marched.depth[p]) {
+                differences++;
+            }
+        }
+    }
+
+    printf("%lu of %lu rendered tiles culled, %lu pixels differ from the full march\n",
+            culledTiles, renderedTiles, differences);
+
+    return failures > 0 || differences > 0;
+}
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CloudUpsample.hpp"
+
+// Relative depth difference of neighbours that makes an edge for measureError.
+#define EDGE_DEPTH_RATIO 0.1
+// Total weight below which no sample agrees with the pixel depth.
+#define MIN_WEIGHT 1e-3f
+
+using namespace pgp;
+using namespace glm;
+
+CloudUpsample::CloudUpsample(ThreadPool *_pool, Mode _mode, float _depthTolerance, float _maxDepth) :
+    pool(_pool), mode(_mode), depthTolerance(_depthTolerance), maxDepth(_maxDepth) {
+}
+
+void CloudUpsample::upsample(const CloudFrame &frame, const float *depth, ivec2 screenSize, vector<vec4> &layer) const {
+    layer.resize(screenSize.x * screenSize.y);
+
+    auto upsampleRow = [&](unsigned y) {
+        for (int x = 0; x < screenSize.x; x++) {
+            layer[y * screenSize.x + x] = upsamplePixel(x, y, frame, depth, screenSize);
+        }
+    };
+
+    if (pool) {
+        pool->run(screenSize.y, upsampleRow);
+    } else {
+        for (int y = 0; y < screenSize.y; y++) {
+            upsampleRow(y);
+        }
+    }
+}
+
+vec4 CloudUpsample::upsamplePixel(int x, int y, const CloudFrame &frame, const float *depth, ivec2 screenSize) const {
+    float pixelDepth = depth[y * screenSize.x + x];
+    vec2 scale = vec2(frame.size) / vec2(screenSize);
+    vec2 u;
+
+    if (mode == UPSAMPLE_BILINEAR) {
+        // Texture unit samples at pixel centers.
+        u = (vec2(x, y) + 0.5f) * scale - 0.5f;
+    } else {
+        // Sample x, y of the frame is marched along the ray of screen pixel
+        // x, y * screen / frame size.
+        u = vec2(x, y) * scale;
+    }
+
+    ivec2 base = ivec2(floor(u));
+    vec2 f = u - vec2(base);
+
+    ivec2 samples[4];
+    float weights[4] = {
+        (1 - f.x) * (1 - f.y), f.x * (1 - f.y),
+        (1 - f.x) * f.y, f.x * f.y,
+    };
+
+    for (int i = 0; i < 4; i++) {
+        samples[i] = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), frame.size - 1);
+    }
+
+    if (mode == UPSAMPLE_BILINEAR) {
+        vec4 color(0);
+        float cloudDepth = 0;
+
+        for (int i = 0; i < 4; i++) {
+            int s = samples[i].y * frame.size.x + samples[i].x;
+            color += weights[i] * frame.color[s];
+            cloudDepth += weights[i] * frame.depth[s];
+        }
+
+        if (pixelDepth <= cloudDepth) {
+            return vec4(0);
+        }
+
+        return vec4(vec3(color) * color.a, color.a);
+    }
+
+    int downsample = int(ceilf(float(screenSize.x) / float(frame.size.x)));
+    float total = 0;
+    float nearest = INFINITY;
+    int nearestSample = 0;
+
+    for (int i = 0; i < 4; i++) {
+        // Scene depth the sample was marched against, CloudMarcher reads
+        // zero outside of the screen.
+        ivec2 p = samples[i] * downsample + downsample / 2;
+        float sampleDepth = p.x < screenSize.x && p.y < screenSize.y ? depth[p.y * screenSize.x + p.x] : 0;
+
+        float difference = relativeDifference(pixelDepth, sampleDepth);
+        float agreement = difference / depthTolerance;
+
+        weights[i] *= expf(-agreement * agreement);
+        total += weights[i];
+
+        if (difference < nearest) {
+            nearest = difference;
+            nearestSample = i;
+        }
+    }
+
+    if (total < MIN_WEIGHT) {
+        for (int i = 0; i < 4; i++) {
+            weights[i] = i == nearestSample;
+        }
+        total = 1;
+    }
+
+    vec4 layer(0);
+
+    for (int i = 0; i < 4; i++) {
+        int s = samples[i].y * frame.size.x + samples[i].x;
+        vec4 c = frame.color[s];
+
+        if (pixelDepth > frame.depth[s]) {
+            layer += weights[i] * vec4(vec3(c) * c.a, c.a);
+        }
+    }
+
+    return layer / total;
+}
+
+ImageError CloudUpsample::measureError(const vector<vec4> &layer, const vector<vec4> &reference,
+        const float *depth, ivec2 size, int edgeRadius) {
+
+    int pixels = size.x * size.y;
+
+    // Depth edges, then grown by the radius in both directions.
+    vector<unsigned char> edge(pixels, 0), grown(pixels, 0);
+
+    for (int y = 0; y < size.y; y++) {
+        for (int x = 0; x < size.x; x++) {
+            float d = depth[y * size.x + x];
+            float right = x + 1 < size.x ? depth[y * size.x + x + 1] : d;
+            float up = y + 1 < size.y ? depth[(y + 1) * size.x + x] : d;
+
+            float edgeDifference = std::max(std::abs(d - right) / std::min(d, right), std::abs(d - up) / std::min(d, up));
+            edge[y * size.x + x] = edgeDifference > EDGE_DEPTH_RATIO;
+        }
+    }
+
+    for (int y = 0; y < size.y; y++) {
+        for (int x = 0; x < size.x; x++) {
+            if (edge[y * size.x + x]) {
+                int x0 = std::max(x - edgeRadius, 0);
+                int x1 = std::min(x + edgeRadius, size.x - 1);
+                memset(&grown[y * size.x + x0], 1, x1 - x0 + 1);
+            }
+        }
+    }
+
+    edge.swap(grown);
+    std::fill(grown.begin(), grown.end(), 0);
+
+    for (int y = 0; y < size.y; y++) {
+        for (int x = 0; x < size.x; x++) {
+            if (edge[y * size.x + x]) {
+                int y0 = std::max(y - edgeRadius, 0);
+                int y1 = std::min(y + edgeRadius, size.y - 1);
+
+                for (int ny = y0; ny <= y1; ny++) {
+                    grown[ny * size.x + x] = 1;
+                }
+            }
+        }
+    }
+
+    double sum = 0, edgeSum = 0;
+    int edgePixels = 0;
+
+    for (int i = 0; i < pixels; i++) {
+        vec4 d = layer[i] - reference[i];
+        double e = dot(d, d) / 4.0;
+
+        sum += e;
+
+        if (grown[i]) {
+            edgeSum += e;
+            edgePixels++;
+        }
+    }
+
+    ImageError error;
+    error.rms = sqrt(sum / pixels);
+    error.psnr = error.rms > 0 ? -20 * log10(error.rms) : INFINITY;
+    error.edgeRms = edgePixels ? sqrt(edgeSum / edgePixels) : 0;
+    error.edgeFraction = double(edgePixels) / pixels;
+
+    return error;
+}
+
+bool CloudUpsample::parseMode(const char *name, Mode &mode) {
+    static const char *names[] = {"bilinear", "bilateral"};
+
+    for (int m = UPSAMPLE_BILINEAR; m <= UPSAMPLE_BILATERAL; m++) {
+        if (strcmp(name, names[m]) == 0) {
+            mode = Mode(m);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+float CloudUpsample::relativeDifference(float a, float b) const {
+    a = std::min(a, maxDepth);
+    b = std::min(b, maxDepth);
+
+    return std::abs(a - b) / std::max(std::min(a, b), 1e-3f);
+}
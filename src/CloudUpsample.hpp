@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "CloudMarcher.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::ivec2;
+    using glm::vec4;
+
+    /**
+     * Difference of two cloud layers of the same size.
+     */
+    struct ImageError {
+        // Over premultiplied RGBA, as CloudRender compares frames.
+        double rms = 0;
+        double psnr = 0;
+        // Only pixels near a depth edge of the scene, where halos show.
+        double edgeRms = 0;
+        double edgeFraction = 0;
+    };
+
+    /**
+     * Upsampling of the downscaled cloud frame to screen resolution, CPU
+     * reference of shaders/blend.frag.
+     *
+     * Result is the cloud layer of every screen pixel premultiplied by alpha,
+     * transparent where the scene is in front of the clouds, so it is drawn
+     * over the scene by back * (1 - a) + rgb.
+     *
+     * Bilinear filters the frame as the texture unit does and tests the scene
+     * depth against the filtered cloud depth. Bilateral weights the four
+     * nearest samples also by how well the scene depth they were marched
+     * against, read from the full resolution depth at the sample position,
+     * agrees with the depth of the pixel. When none agrees the nearest depth
+     * is taken. Samples on the other side of a depth edge are then left out,
+     * which removes halos around terrain.
+     */
+    class CloudUpsample {
+    public:
+        enum Mode {
+            UPSAMPLE_BILINEAR,
+            UPSAMPLE_BILATERAL,
+        };
+
+    private:
+        ThreadPool *pool;
+        Mode mode;
+        float depthTolerance;
+        float maxDepth;
+
+    public:
+        /**
+         * Depths agree when they differ by less than depth tolerance
+         * relative to the nearer one. Depths beyond max depth, usually
+         * CloudMarcher::maxDistance, give the same clouds and agree.
+         */
+        CloudUpsample(ThreadPool *pool = NULL, Mode mode = UPSAMPLE_BILATERAL,
+                float depthTolerance = 0.1, float maxDepth = 1e15);
+
+        /**
+         * Layer receives screen size x * y pixels, depth is the scene depth
+         * the frame was marched against.
+         */
+        void upsample(const CloudFrame &frame, const float *depth, ivec2 screenSize, vector<vec4> &layer) const;
+
+        vec4 upsamplePixel(int x, int y, const CloudFrame &frame, const float *depth, ivec2 screenSize) const;
+
+        /**
+         * Pixels within edgeRadius of a depth edge are counted as edge
+         * pixels, the radius should cover the largest downscale compared.
+         */
+        static ImageError measureError(const vector<vec4> &layer, const vector<vec4> &reference,
+                const float *depth, ivec2 size, int edgeRadius = 8);
+
+        static bool parseMode(const char *name, Mode &mode);
+
+    private:
+        float relativeDifference(float a, float b) const;
+    };
+
+}
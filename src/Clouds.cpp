@@ -2,12 +2,20 @@
 #include "Exceptions.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
 #include <iostream>
 
 using namespace pgp;
 using namespace glm;
 
-#define DOWNSCALE 4
+// Relative scene depth difference at which blend.frag stops mixing samples.
+#define UPSAMPLE_DEPTH_TOLERANCE 0.1f
+
+// Columns of the occupancy grid refreshed ahead of expiry per frame.
+#define OCCUPANCY_REFRESH 64
+
+// Programs of earlier sources kept besides the current one.
+#define CACHED_PROGRAMS 8
 
 #define DIV_ROUND_UP(x,d) ((x + d - 1)/d)
 
@@ -23,44 +31,93 @@ static GLuint indicies[] = {
 };
 
 static string computeShaderFile("./shaders/clouds.comp");
+static string tileShaderFile("./shaders/cloud-tiles.comp");
 static string blendVertexShaderFile("./shaders/blend.vert");
 static string blendFragmentShaderFile("./shaders/blend.frag");
 
-Clouds::Clouds(Camera *cam, Landscape *land) {
+Clouds::Clouds(Camera *cam, Landscape *land, const MarchPolicy &policy, int _reprojectPattern,
+        int _downscale, CloudUpsample::Mode _upsampleMode) :
+        computePrograms(CACHED_PROGRAMS + 1), reloadRequested(false), compiling(NULL), current(0),
+        downscale(_downscale), upsampleMode(_upsampleMode),
+        profiler(NULL), marchTimer(NULL), resolution(NULL),
+        reprojectPattern(_reprojectPattern), frameIndex(0), historyValid(false), lastTime(0),
+        occupancy(16.0, 8, 8.0, OCCUPANCY_REFRESH), occupancyTextureSize(0), lightTextureSize(0),
+        outputFramebuffer(0) {
+
+    layerParams.policy = policy;
 
     camera = cam;
     landscape = land;
 
-    computeProgram = new ComputeShaderProgram();
+    ComputeSource source = prepareComputeSource(getComputePermutation());
+
+    auto start = std::chrono::steady_clock::now();
+    ComputeShaderProgram *compute = new ComputeShaderProgram();
+
+    try {
+        compute->startCompile(source.source);
+        compute->getProgram();
+    } catch (...) {
+        delete compute;
+        throw;
+    }
 
-    computeProgram->setComputeShaderFromFile(computeShaderFile);
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
 
-    GLuint program = computeProgram->getProgram();
+    std::cout << "Cloud shader read in " << source.prepareMs << " ms, compiled in "
+            << ms.count() << " ms" << std::endl;
 
-    ivec2 windowSize = DIV_ROUND_UP(camera->getWindowSize(),DOWNSCALE);
+    setComputeProgram(source, compute);
 
-    initComputeUniforms(program);
+    // Layer parameters and range of the march do not change, one tile
+    // program serves every permutation.
+    tileProgram.setComputeShaderFromFile(tileShaderFile, getComputePermutation());
 
-    glGenTextures(1, &cloudTexture);
-    glBindTexture(GL_TEXTURE_2D, cloudTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowSize.x, windowSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLuint tiles = tileProgram.getProgram();
 
-    glGenTextures(1, &cloudDepthTexture);
-    glBindTexture(GL_TEXTURE_2D, cloudDepthTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, windowSize.x, windowSize.y, 0, GL_RED, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    uTileDepth = glGetUniformLocation(tiles, "depthIm");
+    uTileCloud = glGetUniformLocation(tiles, "cloudIm");
+    uTileCloudDepth = glGetUniformLocation(tiles, "cloudDepthIm");
+    uTilePosition = glGetUniformLocation(tiles, "eyePosition");
+    uTileInvVP = glGetUniformLocation(tiles, "invVP");
+
+    glGenBuffers(1, &tileBuffer);
+
+    glGenTextures(2, cloudTexture);
+    glGenTextures(2, cloudDepthTexture);
+
+    for (int i = 0; i < 2; i++) {
+        GLuint textures[] = {cloudTexture[i], cloudDepthTexture[i]};
+
+        for (GLuint texture : textures) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+    }
+
+    resizeCloudTextures();
+
+    glGenTextures(1, &occupancyTexture);
+    glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Light volume is a ring buffer in x and z.
+    glGenTextures(1, &lightTexture);
+    glBindTexture(GL_TEXTURE_3D, lightTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_3D, 0);
 
     blendProgram.setVertexShaderFromFile(blendVertexShaderFile);
     blendProgram.setFragmenShaderFromFile(blendFragmentShaderFile);
 
-    program = blendProgram.getProgram();
+    GLuint program = blendProgram.getProgram();
 
     aBlendPosition = glGetAttribLocation(program, "position");
 
@@ -70,6 +127,10 @@ Clouds::Clouds(Camera *cam, Landscape *land) {
     uFrontDepth = glGetUniformLocation(program, "frontDepth");
     uBackDepth = glGetUniformLocation(program, "backDepth");
 
+    uUpsampleMode = glGetUniformLocation(program, "upsampleMode");
+    uDepthTolerance = glGetUniformLocation(program, "depthTolerance");
+    uMaxDepth = glGetUniformLocation(program, "maxDepth");
+
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
@@ -102,53 +163,459 @@ void Clouds::initComputeUniforms(GLuint program) {
   uTime = glGetUniformLocation(program, "time");
 
   uInvVP = glGetUniformLocation(program, "invVP");
+
+  uOccupancy = glGetUniformLocation(program, "occupancy");
+  uOccupancyMin = glGetUniformLocation(program, "occupancyMin");
+  uOccupancyMinSlot = glGetUniformLocation(program, "occupancyMinSlot");
+  uOccupancySize = glGetUniformLocation(program, "occupancySize");
+  uOccupancyCell = glGetUniformLocation(program, "occupancyCell");
+
+  uStepRatio = glGetUniformLocation(program, "stepRatio");
+  uMaxStepSize = glGetUniformLocation(program, "maxStepSize");
+  uEmptyStepScale = glGetUniformLocation(program, "emptyStepScale");
+  uRefineSteps = glGetUniformLocation(program, "refineSteps");
+  uMinTransmittance = glGetUniformLocation(program, "minTransmittance");
+
+  uLastCloud = glGetUniformLocation(program, "lastCloudIm");
+  uLastCloudDepth = glGetUniformLocation(program, "lastCloudDepthIm");
+  uReprojectPattern = glGetUniformLocation(program, "reprojectPattern");
+  uFrameIndex = glGetUniformLocation(program, "frameIndex");
+  uHistoryValid = glGetUniformLocation(program, "historyValid");
+  uLastVP = glGetUniformLocation(program, "lastVP");
+  uLastEyePosition = glGetUniformLocation(program, "lastEyePosition");
+  uLastTime = glGetUniformLocation(program, "lastTime");
+
+  uLightVolume = glGetUniformLocation(program, "lightVolume");
+  uLightMin = glGetUniformLocation(program, "lightMin");
+  uLightSize = glGetUniformLocation(program, "lightSize");
+  uLightVoxel = glGetUniformLocation(program, "lightVoxel");
+}
+
+ShaderPreprocessor Clouds::getComputePermutation() {
+    ShaderPreprocessor preprocessor;
+
+    preprocessor.define("LOWER_LAYER", layerParams.lowerLayer);
+    preprocessor.define("UPPER_LAYER", layerParams.upperLayer);
+    preprocessor.define("LAYER_EASE", layerParams.layerEase);
+    preprocessor.define("LAYER_OFFSET", layerParams.layerOffset);
+    preprocessor.define("MAX_DISTANCE", layerParams.maxDistance);
+    preprocessor.define("DISTANCE_EASE", layerParams.distanceEase);
+    preprocessor.define("TIME_FACTOR", layerParams.timeFactor);
+
+    preprocessor.define("STEP_MODE", int(layerParams.policy.stepMode));
+    preprocessor.define("STEP_SIZE", layerParams.stepSize);
+    preprocessor.define("STEP_COUNT", layerParams.stepCount);
+
+    // Work groups are the tiles of the CPU reference.
+    preprocessor.define("LOCAL_SIZE_X", CloudMarcher::TILE_WIDTH);
+    preprocessor.define("LOCAL_SIZE_Y", CloudMarcher::TILE_HEIGHT);
+
+    return preprocessor;
+}
+
+Clouds::ComputeSource Clouds::prepareComputeSource(const ShaderPreprocessor &preprocessor) {
+    auto start = std::chrono::steady_clock::now();
+
+    ComputeSource s;
+    s.source = preprocessor.process(computeShaderFile, &s.files);
+    s.key = std::to_string(ShaderPreprocessor::hash(s.source));
+    s.stepMode = MarchPolicy::StepMode(std::stoi(preprocessor.getDefines().at("STEP_MODE")));
+
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    s.prepareMs = ms.count();
+
+    return s;
+}
+
+void Clouds::requestComputeProgram() {
+    if (preparing.valid() || compiling) {
+        reloadRequested = true;
+        return;
+    }
+
+    reloadRequested = false;
+    reloadStart = std::chrono::steady_clock::now();
+    preparing = std::async(std::launch::async, prepareComputeSource, getComputePermutation());
+}
+
+void Clouds::updateComputeProgram() {
+    if (!watcher.poll().empty()) {
+        requestComputeProgram();
+    }
+
+    if (compiling) {
+        if (!compiling->isCompiled()) {
+            return;
+        }
+
+        ComputeShaderProgram *program = compiling;
+        compiling = NULL;
+
+        try {
+            program->getProgram();
+        } catch (Exception &e) {
+            delete program;
+            onComputeError(e.getMessage());
+            return;
+        }
+
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - reloadStart;
+
+        std::cout << "Cloud shader reloaded in " << ms.count() << " ms, read in "
+                << compilingSource.prepareMs << " ms" << std::endl;
+
+        setComputeProgram(compilingSource, program);
+    } else if (preparing.valid()) {
+        if (preparing.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+
+        ComputeSource source;
+
+        try {
+            source = preparing.get();
+        } catch (string &e) {
+            onComputeError(e);
+            return;
+        }
+
+        ComputeShaderProgram *program = computePrograms.find(source.key);
+
+        if (source.key == computeKey) {
+            std::cout << "Cloud shader unchanged, read in " << source.prepareMs << " ms" << std::endl;
+            setComputeProgram(source, computeProgram);
+        } else if (program) {
+            std::cout << "Cloud shader taken from cache, read in " << source.prepareMs << " ms" << std::endl;
+            setComputeProgram(source, program);
+        } else {
+            program = new ComputeShaderProgram();
+
+            // Debug output reports compile errors by exception already here.
+            try {
+                program->startCompile(source.source);
+            } catch (Exception &e) {
+                delete program;
+                onComputeError(e.getMessage());
+                return;
+            }
+
+            compilingSource = source;
+            compiling = program;
+            return;
+        }
+    }
+
+    if (reloadRequested) {
+        requestComputeProgram();
+    }
+}
+
+void Clouds::setComputeProgram(const ComputeSource &source, ComputeShaderProgram *program) {
+    computePrograms.put(source.key, program);
+    computeProgram = program;
+    computeKey = source.key;
+    computeStepMode = source.stepMode;
+
+    // Includes may have changed.
+    watcher.clear();
+
+    for (const string &file : source.files) {
+        watcher.watch(file);
+    }
+
+    initComputeUniforms(program->getProgram());
+}
+
+void Clouds::onComputeError(const string &message) {
+    std::cerr << message << std::endl;
+
+    layerParams.policy.stepMode = computeStepMode;
+
+    // Files are watched still, the next save tries again.
+    if (reloadRequested) {
+        requestComputeProgram();
+    }
+}
+
+void Clouds::setProfiler(FrameProfiler *_profiler) {
+    profiler = _profiler;
+
+    delete marchTimer;
+    marchTimer = new GpuTimer(profiler);
+    marchDownscales.clear();
+
+    marchStage = profiler->addStage("Clouds.march");
+    downscaleStage = profiler->addStage("Clouds.downscale");
+}
+
+void Clouds::setMarchBudget(float budget) {
+    delete resolution;
+    resolution = new ResolutionController(budget, downscale);
+}
+
+void Clouds::updateDownscale() {
+    if (!marchTimer) {
+        return;
+    }
+
+    marchSamples.clear();
+    marchTimer->collect(&marchSamples);
+
+    int next = downscale;
+
+    for (const FrameProfiler::Sample &s : marchSamples) {
+        int measured = marchDownscales.front();
+        marchDownscales.pop_front();
+
+        if (resolution) {
+            next = resolution->update(s.duration * 1e-6f, measured);
+        }
+    }
+
+    if (next != downscale) {
+        // Same textures get new storage, the driver keeps the old one
+        // until the GPU is done with it.
+        downscale = next;
+        resizeCloudTextures();
+    }
+
+    profiler->recordValue(downscaleStage, downscale);
+}
+
+void Clouds::resizeCloudTextures() {
+    ivec2 windowSize = DIV_ROUND_UP(camera->getWindowSize(), downscale);
+
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, cloudTexture[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowSize.x, windowSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        glBindTexture(GL_TEXTURE_2D, cloudDepthTexture[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, windowSize.x, windowSize.y, 0, GL_RED, GL_FLOAT, NULL);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Dispatch arguments and one entry per tile.
+    ivec2 tiles = DIV_ROUND_UP(windowSize, ivec2(CloudMarcher::TILE_WIDTH, CloudMarcher::TILE_HEIGHT));
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + tiles.x * tiles.y) * sizeof (GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    historyValid = false;
+}
+
+void Clouds::setMarchUniforms() {
+    const MarchPolicy &policy = layerParams.policy;
+
+    glUniform1f(uStepRatio, policy.stepRatio);
+    glUniform1f(uMaxStepSize, policy.maxStepSize);
+    glUniform1f(uEmptyStepScale, policy.emptyStepScale);
+    glUniform1i(uRefineSteps, policy.refineSteps);
+    glUniform1f(uMinTransmittance, policy.minTransmittance);
+}
+
+void Clouds::updateOccupancy(vec3 eyePosition) {
+    // Shader gets time multiplied by 10, see render().
+    if (occupancy.update(layerParams, eyePosition, time * 10) == 0) {
+        return;
+    }
+
+    ivec3 size = occupancy.getSize();
+
+    glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+
+    if (size != occupancyTextureSize) {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, size.x, size.y, size.z, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        occupancyTextureSize = size;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size.x, size.y, size.z, GL_RED, GL_UNSIGNED_BYTE, &occupancy.getCells()[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Clouds::updateLight(vec3 eyePosition) {
+    auto start = std::chrono::steady_clock::now();
+
+    int columns = light.update(layerParams, eyePosition, &pool);
+
+    if (columns == 0) {
+        return;
+    }
+
+    ivec3 size = light.getSize();
+
+    glBindTexture(GL_TEXTURE_3D, lightTexture);
+
+    if (size != lightTextureSize) {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, size.x, size.y, size.z, 0, GL_RED, GL_FLOAT, NULL);
+        lightTextureSize = size;
+    }
+
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size.x, size.y, size.z, GL_RED, GL_FLOAT, &light.getVoxels()[0]);
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    if (columns == size.x * size.z) {
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Light volume " << size.x << "x" << size.y << "x" << size.z << " built in "
+                << ms.count() << " ms, " << light.getMemorySize() / 1024 << " KiB" << std::endl;
+    }
 }
 
 Clouds::~Clouds() {
 
+    delete resolution;
+    delete marchTimer;
+
+    if (preparing.valid()) {
+        preparing.wait();
+    }
+
+    delete compiling;
+
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &tileBuffer);
 
     glDeleteVertexArrays(1, &vao);
 
-    glDeleteTextures(1, &cloudTexture);
-    glDeleteTextures(1, &cloudDepthTexture);
-
-    delete computeProgram;
+    glDeleteTextures(2, cloudTexture);
+    glDeleteTextures(2, cloudDepthTexture);
+    glDeleteTextures(1, &occupancyTexture);
+    glDeleteTextures(1, &lightTexture);
 }
 
 void Clouds::render() {
 
+    updateDownscale();
+
     ivec2 ws = camera->getWindowSize();
-    ivec2 dws = DIV_ROUND_UP(ws,DOWNSCALE);
+    ivec2 dws = DIV_ROUND_UP(ws, downscale);
     vec3 pos = camera->getPosition();
 
     mat4 viewMat = landscape->getViewMatrix();
     mat4 projMat = landscape->getProjectionMatrix();
 
-    mat4 invVPMat = glm::inverse(projMat*viewMat);
+    mat4 vpMat = projMat*viewMat;
+    mat4 invVPMat = CloudMarcher::rayMatrix(vpMat, pos);
+    int last = current;
 
-    glUseProgram(computeProgram->getProgram());
+    current = 1 - current;
+
+    updateComputeProgram();
+    updateOccupancy(pos);
+    updateLight(pos);
+
+    if (marchTimer) {
+        marchTimer->begin(marchStage);
+    }
 
     glBindImageTexture(1, landscape->getDepthTexture(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-    glUniform1i(uDepth, 1);
+    glBindImageTexture(2, cloudTexture[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glBindImageTexture(3, cloudDepthTexture[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
 
-    glBindImageTexture(2, cloudTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
-    glUniform1i(uCloud, 2);
+    // Tile pass lists live tiles after the dispatch arguments and writes
+    // the empty march into the others.
+    GLuint dispatch[] = {0, 1, 1, 0};
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tileBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof (dispatch), dispatch);
+
+    glUseProgram(tileProgram.getProgram());
+
+    glUniform1i(uTileDepth, 1);
+    glUniform1i(uTileCloud, 2);
+    glUniform1i(uTileCloudDepth, 3);
+    glUniform3fv(uTilePosition, 1, &pos[0]);
+    glUniformMatrix4fv(uTileInvVP, 1, GL_FALSE, glm::value_ptr(invVPMat));
+
+    glDispatchCompute(DIV_ROUND_UP(dws.x, CloudMarcher::TILE_WIDTH), DIV_ROUND_UP(dws.y, CloudMarcher::TILE_HEIGHT), 1);
 
-    glBindImageTexture(3, cloudDepthTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    glUseProgram(computeProgram->getProgram());
+
+    glUniform1i(uDepth, 1);
+    glUniform1i(uCloud, 2);
     glUniform1i(uCloudDepth, 3);
 
+    glBindImageTexture(5, cloudTexture[last], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+    glUniform1i(uLastCloud, 5);
+
+    glBindImageTexture(6, cloudDepthTexture[last], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glUniform1i(uLastCloudDepth, 6);
+
+    glUniform1i(uReprojectPattern, reprojectPattern);
+    glUniform1i(uFrameIndex, frameIndex);
+    glUniform1i(uHistoryValid, historyValid);
+    glUniformMatrix4fv(uLastVP, 1, GL_FALSE, glm::value_ptr(lastVP));
+    glUniform3fv(uLastEyePosition, 1, &lastEyePosition[0]);
+    glUniform1f(uLastTime, lastTime);
+
     glUniform3fv(uPosition, 1, &pos[0]);
     glUniform1f(uTime, time*10);
 
     glUniformMatrix4fv(uInvVP, 1, GL_FALSE, glm::value_ptr(invVPMat));
 
-    glDispatchCompute(DIV_ROUND_UP(dws.x, 16), DIV_ROUND_UP(dws.y, 4), 1);
+    ivec3 occupancyMin = occupancy.getMinCell();
+    ivec3 occupancySize = occupancy.getSize();
+    ivec3 occupancyMinSlot = occupancy.getMinSlot();
+    vec3 occupancyCell = occupancy.getCellSize();
+
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+    glUniform1i(uOccupancy, 4);
+
+    glUniform3iv(uOccupancyMin, 1, &occupancyMin[0]);
+    glUniform3iv(uOccupancyMinSlot, 1, &occupancyMinSlot[0]);
+    glUniform3iv(uOccupancySize, 1, &occupancySize[0]);
+    glUniform3fv(uOccupancyCell, 1, &occupancyCell[0]);
+
+    ivec2 lightMin = light.getMinColumn();
+    ivec3 lightSize = light.getSize();
+    vec2 lightVoxel = light.getVoxelSize();
+
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_3D, lightTexture);
+    glUniform1i(uLightVolume, 7);
+
+    glUniform2iv(uLightMin, 1, &lightMin[0]);
+    glUniform3iv(uLightSize, 1, &lightSize[0]);
+    glUniform2fv(uLightVoxel, 1, &lightVoxel[0]);
+
+    setMarchUniforms();
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, tileBuffer);
+    glDispatchComputeIndirect(0);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    if (marchTimer) {
+        marchTimer->end();
+
+        // GpuTimer drops the oldest intervals the same way.
+        marchDownscales.push_back(downscale);
+        if (marchDownscales.size() > GpuTimer::MAX_PENDING) {
+            marchDownscales.pop_front();
+        }
+    }
+
+    // Blend samples the images now, next dispatch loads them as history.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    historyValid = true;
+    lastVP = vpMat;
+    lastEyePosition = pos;
+    lastTime = time*10;
+    frameIndex++;
 
     glUseProgram(blendProgram.getProgram());
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, landscape->getColorTexture());
@@ -156,7 +623,7 @@ void Clouds::render() {
     glUniform1i(uBackTexture, 0);
 
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cloudTexture);
+    glBindTexture(GL_TEXTURE_2D, cloudTexture[current]);
 
     glUniform1i(uFrontTexture, 1);
 
@@ -166,10 +633,14 @@ void Clouds::render() {
     glUniform1i(uBackDepth, 2);
 
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, cloudDepthTexture);
+    glBindTexture(GL_TEXTURE_2D, cloudDepthTexture[current]);
 
     glUniform1i(uFrontDepth, 3);
 
+    glUniform1i(uUpsampleMode, upsampleMode);
+    glUniform1f(uDepthTolerance, UPSAMPLE_DEPTH_TOLERANCE);
+    glUniform1f(uMaxDepth, layerParams.maxDistance);
+
     glBindVertexArray(vao);
 
     glDisable(GL_DEPTH_TEST);
@@ -190,18 +661,7 @@ IEventListener::EventResponse Clouds::onEvent(SDL_Event *evt) {
       if (e->event == SDL_WINDOWEVENT_RESIZED
           || e->event == SDL_WINDOWEVENT_SIZE_CHANGED) {
 
-          ivec2 windowSize = DIV_ROUND_UP(camera->getWindowSize(), DOWNSCALE);
-
-          // std::cout << "Size change: " << camera->getWindowSize().x << "x" << camera->getWindowSize().y << std::endl;
-          // std::cout << "Downsampled: " << windowSize.x << "x" << windowSize.y << std::endl;
-
-          glBindTexture(GL_TEXTURE_2D, cloudTexture);
-          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowSize.x, windowSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-
-          glBindTexture(GL_TEXTURE_2D, cloudDepthTexture);
-          glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, windowSize.x, windowSize.y, 0, GL_RED, GL_FLOAT, NULL);
-
-          glBindTexture(GL_TEXTURE_2D, 0);
+          resizeCloudTextures();
 
           return EVT_PROCESSED;
       }
@@ -209,22 +669,17 @@ IEventListener::EventResponse Clouds::onEvent(SDL_Event *evt) {
         SDL_KeyboardEvent *e = &evt->key;
 
         if (e->keysym.sym == SDLK_r) {
-            ComputeShaderProgram *p = new ComputeShaderProgram;
+            requestComputeProgram();
 
-            try {
-                p->setComputeShaderFromFile(computeShaderFile);
+            return EVT_PROCESSED;
+        } else if (e->keysym.sym == SDLK_m) {
+            MarchPolicy &policy = layerParams.policy;
+            policy.stepMode = MarchPolicy::StepMode((policy.stepMode + 1) % (MarchPolicy::STEP_ADAPTIVE + 1));
 
-                GLuint program = computeProgram->getProgram();
-                delete computeProgram;
-                computeProgram = p;
-                initComputeUniforms(program);
+            std::cout << "Cloud step mode " << policy.stepMode << ", "
+                    << computePrograms.size() << " programs cached" << std::endl;
 
-                std::cerr << "Cloud shader reloaded" << std::endl;
-            }
-            catch (Exception &e) {
-                std::cerr << e.getMessage() << std::endl;
-                delete p;
-            }
+            requestComputeProgram();
 
             return EVT_PROCESSED;
         }
@@ -2,6 +2,9 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <deque>
+#include <future>
 
 #include "IRenderer.hpp"
 #include "IProcessor.hpp"
@@ -9,37 +12,200 @@
 #include "Camera.hpp"
 #include "Landscape.hpp"
 #include "ComputeShaderProgram.hpp"
+#include "FileWatcher.hpp"
+#include "FrameProfiler.hpp"
+#include "GpuTimer.hpp"
+#include "ShaderCache.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "CloudMarcher.hpp"
+#include "CloudUpsample.hpp"
+#include "OccupancyGrid.hpp"
+#include "LightVolume.hpp"
+#include "ResolutionController.hpp"
+#include "ThreadPool.hpp"
 
 namespace pgp {
 
     class Clouds : public IRenderer, public IProcessor, public IEventListener {
+        /**
+         * Processed clouds.comp of one permutation.
+         */
+        struct ComputeSource {
+            // Hash of source, key of the program cache.
+            string key;
+            string source;
+            vector<string> files;
+            MarchPolicy::StepMode stepMode;
+            double prepareMs;
+        };
+
         Camera *camera;
         Landscape *landscape;
+        // Programs by hash of their source, computeProgram is the current
+        // one. Programs of recent sources stay, so undoing an edit or going
+        // back to a step mode needs no compilation.
+        ShaderCache<ComputeShaderProgram> computePrograms;
         ComputeShaderProgram *computeProgram;
+        string computeKey;
+        MarchPolicy::StepMode computeStepMode;
+
+        // Reload of clouds.comp runs in stages, see updateComputeProgram().
+        FileWatcher watcher;
+        bool reloadRequested;
+        std::chrono::steady_clock::time_point reloadStart;
+        std::future<ComputeSource> preparing;
+        ComputeShaderProgram *compiling;
+        ComputeSource compilingSource;
         RenderShaderProgram blendProgram;
+        GLuint uUpsampleMode, uDepthTolerance, uMaxDepth;
         GLuint uDepth, uCloud, uCloudDepth;
         GLuint uPosition, uTime;
         GLuint uSunPosition, uSunColor;
         GLuint uInvVP;
+        GLuint uOccupancy, uOccupancyMin, uOccupancyMinSlot;
+        GLuint uOccupancySize, uOccupancyCell;
+        GLuint uStepRatio, uMaxStepSize;
+        GLuint uEmptyStepScale, uRefineSteps, uMinTransmittance;
+        GLuint uLastCloud, uLastCloudDepth;
+        GLuint uReprojectPattern, uFrameIndex, uHistoryValid;
+        GLuint uLastVP, uLastEyePosition, uLastTime;
+        GLuint uLightVolume, uLightMin, uLightSize, uLightVoxel;
+
+        // Tile pass, lists the tiles whose rays can reach the slab for the
+        // indirect dispatch of the march, see CloudTiles.
+        ComputeShaderProgram tileProgram;
+        GLuint uTileDepth, uTileCloud, uTileCloudDepth;
+        GLuint uTilePosition, uTileInvVP;
+        GLuint tileBuffer;
+
+        // Written alternately, the other pair holds the last frame.
+        GLuint cloudTexture[2], cloudDepthTexture[2];
+        int current;
+
+        // Clouds are marched at 1 / downscale of the screen size, blend.frag
+        // upsamples them.
+        int downscale;
+        CloudUpsample::Mode upsampleMode;
+
+        // GPU time of the march and the downscale, see setProfiler().
+        FrameProfiler *profiler;
+        GpuTimer *marchTimer;
+        int marchStage, downscaleStage;
+        // Downscale of each timed march not collected yet, oldest first.
+        std::deque<int> marchDownscales;
+        vector<FrameProfiler::Sample> marchSamples;
+        ResolutionController *resolution;
 
-        GLuint cloudTexture, cloudDepthTexture;
+        // Checkerboard amortization, see CloudReprojection.
+        int reprojectPattern;
+        unsigned frameIndex;
+        bool historyValid;
+        mat4 lastVP;
+        vec3 lastEyePosition;
+        float lastTime;
+
+        // Layer parameters and march policy of clouds.comp, also used to
+        // build the occupancy grid.
+        CloudMarcher layerParams;
+        OccupancyGrid occupancy;
+        GLuint occupancyTexture;
+        ivec3 occupancyTextureSize;
+
+        ThreadPool pool;
+        LightVolume light;
+        GLuint lightTexture;
+        ivec3 lightTextureSize;
 
         GLuint aBlendPosition;
         GLuint uFrontTexture, uBackTexture;
         GLuint uFrontDepth, uBackDepth;
         GLuint vao, vbo, ebo;
 
+        // Blend pass target, 0 is the window.
+        GLuint outputFramebuffer;
+
         float time;
     public:
-        Clouds(Camera *camera, Landscape *landscape);
+        /**
+         * Reproject pattern N marches one of N * N pixels per frame, 1
+         * marches all of them.
+         */
+        Clouds(Camera *camera, Landscape *landscape, const MarchPolicy &policy = MarchPolicy(),
+                int reprojectPattern = 1, int downscale = 4,
+                CloudUpsample::Mode upsampleMode = CloudUpsample::UPSAMPLE_BILATERAL);
         ~Clouds();
 
+        inline void setOutputFramebuffer(GLuint fbo) {
+            outputFramebuffer = fbo;
+        }
+
+        /**
+         * Times the march on GPU as stage Clouds.march and records the
+         * downscale as value Clouds.downscale every frame.
+         */
+        void setProfiler(FrameProfiler *profiler);
+
+        /**
+         * Adapts the downscale so that the march takes about budget ms of
+         * GPU time. Needs profiler.
+         */
+        void setMarchBudget(float budget);
+
+        inline int getDownscale() const {
+            return downscale;
+        }
+
         virtual void render();
         virtual void step(float, float);
         virtual IEventListener::EventResponse onEvent(SDL_Event *evt);
 
     private:
         void initComputeUniforms(GLuint program);
+
+        /**
+         * Defines specializing clouds.comp for current layer parameters and
+         * step mode.
+         */
+        ShaderPreprocessor getComputePermutation();
+
+        /**
+         * Reads and processes the source on the calling thread.
+         */
+        static ComputeSource prepareComputeSource(const ShaderPreprocessor &preprocessor);
+
+        /**
+         * Rebuilds program of the current permutation. The source is read
+         * on another thread, compiled only when its hash has no cached
+         * program and the driver compiles in parallel, so frames go on
+         * with the old program meanwhile.
+         */
+        void requestComputeProgram();
+
+        /**
+         * Advances a requested reload, called every frame. Changes of the
+         * source files request a reload.
+         */
+        void updateComputeProgram();
+
+        void setComputeProgram(const ComputeSource &source, ComputeShaderProgram *program);
+
+        /**
+         * Error of a reload keeps the current program.
+         */
+        void onComputeError(const string &message);
+
+        void updateOccupancy(vec3 eyePosition);
+
+        void updateLight(vec3 eyePosition);
+
+        void setMarchUniforms();
+
+        void resizeCloudTextures();
+
+        /**
+         * Feeds collected march times to the resolution controller.
+         */
+        void updateDownscale();
     };
 
 }
@@ -3,10 +3,76 @@
 
 using namespace pgp;
 
+void ComputeShaderProgram::startCompile(const string &source) {
+    static bool threadsSet = false;
+
+    if (!threadsSet && GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        threadsSet = true;
+    }
+
+    deletePending();
+    deleteShader(computeShader);
+
+    const char *cSource = source.c_str();
+
+    computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &cSource, NULL);
+    glCompileShader(computeShader);
+
+    pendingProgram = glCreateProgram();
+    glAttachShader(pendingProgram, computeShader);
+    glLinkProgram(pendingProgram);
+}
+
+bool ComputeShaderProgram::isCompiled() {
+    if (pendingProgram == 0 || !GLEW_ARB_parallel_shader_compile) {
+        return true;
+    }
+
+    GLint completed = GL_FALSE;
+    glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_ARB, &completed);
+
+    return completed == GL_TRUE;
+}
+
+void ComputeShaderProgram::deletePending() {
+    if (pendingProgram) {
+        glDeleteProgram(pendingProgram);
+        pendingProgram = 0;
+    }
+}
+
 GLuint ComputeShaderProgram::compile() {
     GLint linkStatus;
     GLuint renderProgram;
 
+    if (pendingProgram) {
+        GLint compileStatus;
+        glGetShaderiv(computeShader, GL_COMPILE_STATUS, &compileStatus);
+
+        renderProgram = pendingProgram;
+        pendingProgram = 0;
+
+        if (compileStatus != GL_TRUE) {
+            string info = getShaderInfo(computeShader);
+
+            glDeleteProgram(renderProgram);
+            throw GLException(info);
+        }
+
+        glGetProgramiv(renderProgram, GL_LINK_STATUS, &linkStatus);
+
+        if (linkStatus != GL_TRUE) {
+            string info = getProgramInfo(renderProgram);
+
+            glDeleteProgram(renderProgram);
+            throw GLException(info);
+        }
+
+        return renderProgram;
+    }
+
     if (computeShader == 0) {
         throw Exception("Could not compile compute program: Compute shader missing.");
     }
@@ -9,12 +9,15 @@ namespace pgp {
     class ComputeShaderProgram : public BaseShaderProgram {
     protected:
         GLuint computeShader;
+        // Linked by startCompile(), result not checked yet.
+        GLuint pendingProgram;
     public:
 
-        ComputeShaderProgram() : computeShader(0) {
+        ComputeShaderProgram() : computeShader(0), pendingProgram(0) {
         }
 
         virtual ~ComputeShaderProgram() {
+            deletePending();
             deleteShader(computeShader);
         }
 
@@ -23,14 +26,33 @@ namespace pgp {
             setComputeShaderFromSource(source);
         }
 
+        inline void setComputeShaderFromFile(string &filename, const ShaderPreprocessor &preprocessor) {
+            deletePending();
+            deleteShader(computeShader);
+            computeShader = createShaderFromFile(filename, GL_COMPUTE_SHADER, preprocessor);
+        }
+
         inline void setComputeShaderFromSource(string &source) {
+            deletePending();
             deleteShader(computeShader);
             computeShader = createShaderFromSource(source, GL_COMPUTE_SHADER);
         }
+
+        /**
+         * Compiles and links source without waiting for the result when the
+         * driver supports ARB_parallel_shader_compile. getProgram() waits
+         * and throws on errors, call it once isCompiled() returns true to
+         * keep the wait off the frame.
+         */
+        void startCompile(const string &source);
+
+        bool isCompiled();
     private:
 
         virtual GLuint compile();
 
+        void deletePending();
+
     };
 
 }
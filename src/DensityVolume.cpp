@@ -0,0 +1,155 @@
+#include <cmath>
+
+#include "DensityVolume.hpp"
+#include "CloudNoiseSimd.hpp"
+
+#define DIV_ROUND_UP(x,d) ((x + d - 1)/d)
+
+using namespace pgp;
+using namespace glm;
+
+DensityVolume::DensityVolume(float _voxelSize, float _voxelHeight, float _radius,
+        int _keyframeCount, float _keyframeInterval) :
+    voxelSize(_voxelSize), voxelHeight(_voxelHeight), radius(_radius),
+    keyframeCount(max(_keyframeCount, 2)), keyframeInterval(_keyframeInterval),
+    startTime(0), keyframeVoxels(0) {
+}
+
+void DensityVolume::bake(const CloudMarcher &marcher, vec3 eyePosition, float time, ThreadPool *pool) {
+    startTime = time * marcher.timeFactor;
+
+    // Advected region drifts with the wind while keyframes last.
+    vec4 wind = CloudMarcher::advect(vec4(0, 0, 0, 1));
+    float drift = length(vec3(wind)) * keyframeInterval * (keyframeCount - 1);
+    float halfExtent = radius + drift;
+
+    vec4 center = CloudMarcher::advect(vec4(eyePosition, startTime));
+
+    origin = vec3(center.x - halfExtent, marcher.lowerLayer, center.z - halfExtent);
+
+    size.x = int(ceilf(2 * halfExtent / voxelSize)) + 1;
+    size.y = int(ceilf((marcher.upperLayer - marcher.lowerLayer) / voxelHeight)) + 1;
+    size.z = size.x;
+
+    bricks = DIV_ROUND_UP(size, BRICK_SIZE);
+    keyframeVoxels = size_t(bricks.x) * bricks.y * bricks.z * BRICK_VOXELS;
+
+    voxels.resize(keyframeVoxels * keyframeCount);
+
+    int brickCount = bricks.x * bricks.y * bricks.z;
+
+    auto bakeJob = [&](unsigned job) {
+        bakeBrick(marcher, job / brickCount, job % brickCount);
+    };
+
+    if (pool) {
+        pool->run(brickCount * keyframeCount, bakeJob);
+    } else {
+        for (int job = 0; job < brickCount * keyframeCount; job++) {
+            bakeJob(job);
+        }
+    }
+}
+
+void DensityVolume::bakeBrick(const CloudMarcher &marcher, int keyframe, int brick) {
+    float x[BRICK_VOXELS], y[BRICK_VOXELS], z[BRICK_VOXELS], w[BRICK_VOXELS];
+    float density[BRICK_VOXELS];
+
+    ivec3 brickPosition(brick % bricks.x, (brick / bricks.x) % bricks.y, brick / (bricks.x * bricks.y));
+    ivec3 first = brickPosition * BRICK_SIZE;
+
+    float t = startTime + keyframe * keyframeInterval;
+    vec4 wind = CloudMarcher::advect(vec4(0, 0, 0, t));
+
+    // Voxels are stored in advected coordinates, cloudMap takes world ones.
+    int i = 0;
+    for (int k = 0; k < BRICK_SIZE; k++) {
+        for (int j = 0; j < BRICK_SIZE; j++) {
+            for (int l = 0; l < BRICK_SIZE; l++, i++) {
+                x[i] = origin.x + (first.x + l) * voxelSize - wind.x;
+                y[i] = origin.y + (first.y + j) * voxelHeight;
+                z[i] = origin.z + (first.z + k) * voxelSize - wind.z;
+                w[i] = t;
+            }
+        }
+    }
+
+    CloudNoiseSimd::cloudMap(CloudNoiseSimd::Layer(marcher), x, y, z, w, density, BRICK_VOXELS);
+
+    uint16_t *out = &voxels[keyframe * keyframeVoxels + size_t(brick) * BRICK_VOXELS];
+    for (i = 0; i < BRICK_VOXELS; i++) {
+        out[i] = uint16_t(clamp(density[i], 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+}
+
+bool DensityVolume::sample(vec4 p, float &density) const {
+    if (voxels.empty()) {
+        return false;
+    }
+
+    vec4 q = CloudMarcher::advect(p);
+
+    float fx = (q.x - origin.x) / voxelSize;
+    float fy = (q.y - origin.y) / voxelHeight;
+    float fz = (q.z - origin.z) / voxelSize;
+    float ft = (q.w - startTime) / keyframeInterval;
+
+    // Negated test also rejects NaN.
+    if (!(fx >= 0 && fy >= 0 && fz >= 0 && ft >= 0)) {
+        return false;
+    }
+
+    int x0 = int(fx), y0 = int(fy), z0 = int(fz), t0 = int(ft);
+
+    if (x0 >= size.x - 1 || y0 >= size.y - 1 || z0 >= size.z - 1 || t0 >= keyframeCount - 1) {
+        return false;
+    }
+
+    float rx = fx - x0, ry = fy - y0, rz = fz - z0, rt = ft - t0;
+
+    size_t corners[8];
+    int c = 0;
+    for (int k = 0; k < 2; k++) {
+        for (int j = 0; j < 2; j++) {
+            for (int i = 0; i < 2; i++) {
+                corners[c++] = voxelIndex(x0 + i, y0 + j, z0 + k);
+            }
+        }
+    }
+
+    float keyframes[2];
+    for (int t = 0; t < 2; t++) {
+        const uint16_t *v = &voxels[(t0 + t) * keyframeVoxels];
+
+        float x00 = v[corners[0]] + (v[corners[1]] - float(v[corners[0]])) * rx;
+        float x10 = v[corners[2]] + (v[corners[3]] - float(v[corners[2]])) * rx;
+        float x01 = v[corners[4]] + (v[corners[5]] - float(v[corners[4]])) * rx;
+        float x11 = v[corners[6]] + (v[corners[7]] - float(v[corners[6]])) * rx;
+
+        float lower = x00 + (x10 - x00) * ry;
+        float upper = x01 + (x11 - x01) * ry;
+
+        keyframes[t] = lower + (upper - lower) * rz;
+    }
+
+    density = (keyframes[0] + (keyframes[1] - keyframes[0]) * rt) * (1.0f / 65535.0f);
+
+    return true;
+}
+
+bool DensityVolume::covers(const CloudMarcher &marcher, vec3 eyePosition, float time) const {
+    if (voxels.empty()) {
+        return false;
+    }
+
+    float t = time * marcher.timeFactor;
+    if (t < startTime || t > startTime + keyframeInterval * (keyframeCount - 1)) {
+        return false;
+    }
+
+    vec4 q = CloudMarcher::advect(vec4(eyePosition, t));
+    float reach = marcher.stepSize * marcher.stepCount;
+
+    return q.x - reach >= origin.x && q.x + reach <= origin.x + (size.x - 1) * voxelSize
+            && q.z - reach >= origin.z && q.z + reach <= origin.z + (size.z - 1) * voxelSize;
+}
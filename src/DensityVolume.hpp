@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "CloudMarcher.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::ivec3;
+    using glm::vec3;
+    using glm::vec4;
+
+    /**
+     * cloudMap baked into a grid over the cloud slab, sampled by trilinear
+     * interpolation in space and linear interpolation between time keyframes.
+     *
+     * Grid is stored in wind advected coordinates (q in cloudMap), where the
+     * field changes only slowly with time, so a few keyframes cover several
+     * seconds of animation. Voxels are grouped into 8^3 bricks to keep the
+     * neighbourhood of a lookup in a few cache lines.
+     */
+    class DensityVolume {
+    public:
+        static const int BRICK_SIZE = 8;
+        static const int BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+    private:
+        float voxelSize;
+        float voxelHeight;
+        float radius;
+        int keyframeCount;
+        float keyframeInterval;
+
+        vec3 origin;
+        float startTime;
+        ivec3 size;
+        ivec3 bricks;
+        size_t keyframeVoxels;
+
+        // Density quantized to 16 bits.
+        vector<uint16_t> voxels;
+
+    public:
+        /**
+         * Voxel sizes and radius are in world units, keyframe interval is in
+         * field time (shader time multiplied by timeFactor).
+         */
+        DensityVolume(float voxelSize = 4.0, float voxelHeight = 2.0, float radius = 300.0,
+                int keyframeCount = 4, float keyframeInterval = 1.0);
+
+        /**
+         * Bakes the field around eye position starting at given shader time.
+         */
+        void bake(const CloudMarcher &marcher, vec3 eyePosition, float time, ThreadPool *pool = NULL);
+
+        /**
+         * Samples density at cloudMap argument p. Returns false when p lies
+         * outside of the baked region.
+         */
+        bool sample(vec4 p, float &density) const;
+
+        /**
+         * Whether the whole march from eye position at shader time stays
+         * within the baked region.
+         */
+        bool covers(const CloudMarcher &marcher, vec3 eyePosition, float time) const;
+
+        inline size_t getMemorySize() const {
+            return voxels.size() * sizeof (uint16_t);
+        }
+
+        inline ivec3 getSize() const {
+            return size;
+        }
+
+        inline int getKeyframeCount() const {
+            return keyframeCount;
+        }
+
+    private:
+
+        inline size_t voxelIndex(int x, int y, int z) const {
+            int brick = ((z / BRICK_SIZE) * bricks.y + (y / BRICK_SIZE)) * bricks.x + (x / BRICK_SIZE);
+            int local = ((z % BRICK_SIZE) * BRICK_SIZE + (y % BRICK_SIZE)) * BRICK_SIZE + (x % BRICK_SIZE);
+
+            return size_t(brick) * BRICK_VOXELS + local;
+        }
+
+        void bakeBrick(const CloudMarcher &marcher, int keyframe, int brick);
+    };
+
+}
@@ -0,0 +1,73 @@
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "FileWatcher.hpp"
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+using namespace pgp;
+using namespace std;
+
+FileWatcher::FileWatcher() {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd < 0) {
+        throw string("Could not init inotify: ") + strerror(errno);
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    close(fd);
+}
+
+void FileWatcher::watch(const string &filename) {
+    size_t slash = filename.rfind('/');
+    string directory = slash == string::npos ? "" : filename.substr(0, slash + 1);
+
+    int wd = inotify_add_watch(fd, directory.empty() ? "." : directory.c_str(), WATCH_MASK);
+
+    if (wd < 0) {
+        throw string("Could not watch '" + filename + "': ") + strerror(errno);
+    }
+
+    directories[wd] = directory;
+    files.insert(filename);
+}
+
+void FileWatcher::clear() {
+    for (auto &d : directories) {
+        inotify_rm_watch(fd, d.first);
+    }
+
+    directories.clear();
+    files.clear();
+}
+
+vector<string> FileWatcher::poll() {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    set<string> changed;
+    ssize_t length;
+
+    while ((length = read(fd, buffer, sizeof (buffer))) > 0) {
+        for (char *p = buffer; p < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event*) p;
+            p += sizeof (struct inotify_event) + event->len;
+
+            auto d = directories.find(event->wd);
+
+            if (d == directories.end() || event->len == 0) {
+                continue;
+            }
+
+            string filename = d->second + event->name;
+
+            if (files.count(filename)) {
+                changed.insert(filename);
+            }
+        }
+    }
+
+    return vector<string>(changed.begin(), changed.end());
+}
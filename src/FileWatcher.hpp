@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace pgp {
+
+    using std::map;
+    using std::set;
+    using std::string;
+    using std::vector;
+
+    /**
+     * Reports changes of files through inotify without blocking.
+     *
+     * Directories of the files are watched instead of the files, so files
+     * replaced by rename, as many editors save them, are reported too.
+     */
+    class FileWatcher {
+    private:
+        int fd;
+        // Watch descriptor to directory, with trailing slash.
+        map<int, string> directories;
+        set<string> files;
+
+    public:
+        /**
+         * Throws string when inotify is not available.
+         */
+        FileWatcher();
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher &operator=(const FileWatcher&) = delete;
+
+        /**
+         * Path is reported in the same form as given here.
+         */
+        void watch(const string &filename);
+
+        void clear();
+
+        /**
+         * Watched files written or replaced since the last call, each once.
+         */
+        vector<string> poll();
+    };
+
+}
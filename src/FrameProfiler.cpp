@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#include "FrameProfiler.hpp"
+
+using namespace pgp;
+using namespace std;
+
+static inline int64_t clockNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameProfiler::FrameProfiler() : slots(CAPACITY), head(0), epoch(clockNow()) {
+    for (Slot &slot : slots) {
+        slot.sequence.store(0, memory_order_relaxed);
+    }
+}
+
+int FrameProfiler::addStage(const string &name) {
+    stages.push_back(name);
+    return stages.size() - 1;
+}
+
+int64_t FrameProfiler::now() const {
+    return clockNow() - epoch;
+}
+
+void FrameProfiler::record(int stage, Clock clock, int64_t start, int64_t duration) {
+    uint64_t index = head.fetch_add(1, memory_order_relaxed);
+    Slot &slot = slots[index % CAPACITY];
+
+    slot.sequence.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.stage.store(stage, memory_order_relaxed);
+    slot.clock.store(clock, memory_order_relaxed);
+    slot.thread.store(getThreadId(), memory_order_relaxed);
+    slot.start.store(start, memory_order_relaxed);
+    slot.duration.store(duration, memory_order_relaxed);
+
+    slot.sequence.store(index + 1, memory_order_release);
+}
+
+void FrameProfiler::getSamples(vector<Sample> &samples) const {
+    samples.clear();
+
+    uint64_t end = head.load(memory_order_acquire);
+    uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+    for (uint64_t index = begin; index < end; index++) {
+        const Slot &slot = slots[index % CAPACITY];
+
+        if (slot.sequence.load(memory_order_acquire) != index + 1) {
+            continue;
+        }
+
+        Sample s;
+        s.stage = slot.stage.load(memory_order_relaxed);
+        s.clock = Clock(slot.clock.load(memory_order_relaxed));
+        s.thread = slot.thread.load(memory_order_relaxed);
+        s.start = slot.start.load(memory_order_relaxed);
+        s.duration = slot.duration.load(memory_order_relaxed);
+
+        // Slot overwritten while copying.
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.sequence.load(memory_order_relaxed) != index + 1) {
+            continue;
+        }
+
+        samples.push_back(s);
+    }
+}
+
+void FrameProfiler::getStats(Clock clock, vector<StageStats> &stats) const {
+    vector<Sample> samples;
+    getSamples(samples);
+
+    vector<vector<double> > durations(stages.size());
+
+    for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+        if (it->clock == clock && it->stage < int(stages.size()) && durations[it->stage].size() < STATS_WINDOW) {
+            durations[it->stage].push_back(it->duration * 1e-6);
+        }
+    }
+
+    stats.assign(stages.size(), StageStats());
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        vector<double> &d = durations[i];
+        StageStats &s = stats[i];
+
+        s.count = d.size();
+        if (d.empty()) {
+            continue;
+        }
+
+        sort(d.begin(), d.end());
+        s.p50 = d[(d.size() - 1) * 50 / 100];
+        s.p95 = d[(d.size() - 1) * 95 / 100];
+        s.p99 = d[(d.size() - 1) * 99 / 100];
+    }
+}
+
+void FrameProfiler::report(ostream &out) const {
+    static const Clock clocks[] = {CLOCK_CPU, CLOCK_GPU, CLOCK_VALUE};
+    static const char *clockNames[] = {"cpu", "gpu", "value"};
+
+    ios::fmtflags flags = out.flags();
+    out << fixed << setprecision(2);
+
+    out << left << setw(24) << "stage" << right << setw(5) << "" << setw(10) << "p50 ms"
+            << setw(10) << "p95 ms" << setw(10) << "p99 ms" << endl;
+
+    for (Clock clock : clocks) {
+        vector<StageStats> stats;
+        getStats(clock, stats);
+
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (stats[i].count == 0) {
+                continue;
+            }
+
+            out << left << setw(24) << stages[i] << right << setw(5) << clockNames[clock]
+                    << setw(10) << stats[i].p50 << setw(10) << stats[i].p95 << setw(10) << stats[i].p99 << endl;
+        }
+    }
+
+    out.flags(flags);
+}
+
+void FrameProfiler::writeTrace(ostream &out) const {
+    vector<Sample> samples;
+    getSamples(samples);
+
+    out << "{\"traceEvents\":[" << endl;
+
+    // GPU samples go to their own row.
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":-1,\"args\":{\"name\":\"GPU\"}}";
+
+    out << fixed << setprecision(3);
+
+    for (const Sample &s : samples) {
+        if (s.clock == CLOCK_VALUE) {
+            out << "," << endl << "{\"name\":\"" << stages[s.stage] << "\",\"ph\":\"C\",\"pid\":0,\"ts\":"
+                    << s.start * 1e-3 << ",\"args\":{\"value\":" << s.duration * 1e-6 << "}}";
+            continue;
+        }
+
+        out << "," << endl << "{\"name\":\"" << stages[s.stage] << "\",\"cat\":\""
+                << (s.clock == CLOCK_GPU ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << (s.clock == CLOCK_GPU ? -1 : s.thread) << ",\"ts\":" << s.start * 1e-3
+                << ",\"dur\":" << s.duration * 1e-3 << "}";
+    }
+
+    out << endl << "]}" << endl;
+}
+
+void FrameProfiler::writeCsv(ostream &out) const {
+    vector<Sample> samples;
+    getSamples(samples);
+
+    out << "stage,clock,thread,start_us,duration_us" << endl;
+    out << fixed << setprecision(3);
+
+    static const char *clockNames[] = {"cpu", "gpu", "value"};
+
+    for (const Sample &s : samples) {
+        out << stages[s.stage] << "," << clockNames[s.clock] << "," << s.thread << "," << s.start * 1e-3
+                << "," << (s.clock == CLOCK_VALUE ? s.duration * 1e-6 : s.duration * 1e-3) << endl;
+    }
+}
+
+void FrameProfiler::write(const string &filename) const {
+    ofstream file(filename.c_str());
+
+    if (!file) {
+        throw string("Could not write profile '" + filename + "'.");
+    }
+
+    if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0) {
+        writeCsv(file);
+    } else {
+        writeTrace(file);
+    }
+}
+
+int FrameProfiler::getThreadId() {
+    static atomic<int> threadCount(0);
+    thread_local int id = threadCount++;
+
+    return id;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pgp {
+
+    using std::string;
+    using std::vector;
+
+    /**
+     * Durations of named stages (processors, renderers, whole frames) kept
+     * in a fixed ring buffer of the most recent samples.
+     *
+     * Any thread may record samples without locking: writer claims a slot by
+     * an atomic counter and publishes it by its sequence number, readers skip
+     * slots that are being written. Stages have to be added before samples
+     * are recorded from more threads.
+     *
+     * Times are nanoseconds since construction of the profiler.
+     */
+    class FrameProfiler {
+    public:
+        static const size_t CAPACITY = 1 << 16;
+        // Latest samples of a stage used for percentiles.
+        static const size_t STATS_WINDOW = 256;
+
+        enum Clock {
+            CLOCK_CPU,
+            CLOCK_GPU,
+            // Not a time but a value of the stage, e.g. a render scale.
+            // Duration holds millionths of it, so statistics show the value.
+            CLOCK_VALUE,
+        };
+
+        struct Sample {
+            int stage;
+            Clock clock;
+            int thread;
+            int64_t start;
+            int64_t duration;
+        };
+
+        struct StageStats {
+            size_t count;
+            double p50, p95, p99;
+        };
+
+        /**
+         * Records time from construction to destruction as one sample.
+         */
+        class Scope {
+        private:
+            FrameProfiler &profiler;
+            int stage;
+            int64_t start;
+
+        public:
+            inline Scope(FrameProfiler &_profiler, int _stage) : profiler(_profiler), stage(_stage),
+                start(_profiler.now()) {
+            }
+
+            inline ~Scope() {
+                profiler.record(stage, CLOCK_CPU, start, profiler.now() - start);
+            }
+        };
+
+    private:
+        struct Slot {
+            // 0 while empty or being written, index + 1 when published.
+            std::atomic<uint64_t> sequence;
+            std::atomic<int> stage;
+            std::atomic<int> clock;
+            std::atomic<int> thread;
+            std::atomic<int64_t> start;
+            std::atomic<int64_t> duration;
+        };
+
+        vector<string> stages;
+        vector<Slot> slots;
+        std::atomic<uint64_t> head;
+        int64_t epoch;
+
+    public:
+        FrameProfiler();
+
+        /**
+         * Returns id of a new stage.
+         */
+        int addStage(const string &name);
+
+        inline const string &getStageName(int stage) const {
+            return stages[stage];
+        }
+
+        inline int getStageCount() const {
+            return stages.size();
+        }
+
+        int64_t now() const;
+
+        void record(int stage, Clock clock, int64_t start, int64_t duration);
+
+        inline void recordValue(int stage, double value) {
+            record(stage, CLOCK_VALUE, now(), int64_t(value * 1e6 + (value < 0 ? -0.5 : 0.5)));
+        }
+
+        /**
+         * Published samples ordered from the oldest.
+         */
+        void getSamples(vector<Sample> &samples) const;
+
+        /**
+         * Percentiles of the last STATS_WINDOW durations of each stage, in
+         * milliseconds. Stages timed on both clocks are counted separately.
+         */
+        void getStats(Clock clock, vector<StageStats> &stats) const;
+
+        /**
+         * Prints percentiles of every stage that has samples.
+         */
+        void report(std::ostream &out) const;
+
+        /**
+         * Chrome trace event format, opens in chrome://tracing or Perfetto.
+         * Values are counter events.
+         */
+        void writeTrace(std::ostream &out) const;
+
+        /**
+         * Values are written in the duration column.
+         */
+        void writeCsv(std::ostream &out) const;
+
+        /**
+         * Writes CSV when filename ends with .csv, otherwise Chrome trace.
+         * Throws string when the file cannot be written.
+         */
+        void write(const string &filename) const;
+
+        /**
+         * Small number identifying calling thread in samples.
+         */
+        static int getThreadId();
+    };
+
+}
@@ -0,0 +1,88 @@
+#include "GpuTimer.hpp"
+
+using namespace pgp;
+
+GpuTimer::GpuTimer(FrameProfiler *_profiler) : profiler(_profiler) {
+    GLint64 gpuNow;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+
+    offset = profiler->now() - gpuNow;
+}
+
+GpuTimer::~GpuTimer() {
+    for (const Interval &interval : pending) {
+        freeQueries.push_back(interval.begin);
+        freeQueries.push_back(interval.end);
+    }
+
+    if (!freeQueries.empty()) {
+        glDeleteQueries(freeQueries.size(), &freeQueries[0]);
+    }
+}
+
+void GpuTimer::begin(int stage) {
+    current.stage = stage;
+    current.begin = getQuery();
+    current.end = getQuery();
+
+    glQueryCounter(current.begin, GL_TIMESTAMP);
+}
+
+void GpuTimer::end() {
+    glQueryCounter(current.end, GL_TIMESTAMP);
+
+    pending.push_back(current);
+
+    if (pending.size() > MAX_PENDING) {
+        freeQueries.push_back(pending.front().begin);
+        freeQueries.push_back(pending.front().end);
+        pending.pop_front();
+    }
+}
+
+void GpuTimer::collect(vector<FrameProfiler::Sample> *collected) {
+    // Queries complete in order, so the first unfinished one ends the scan.
+    while (!pending.empty()) {
+        const Interval &interval = pending.front();
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(interval.end, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available) {
+            break;
+        }
+
+        GLuint64 begin, end;
+        glGetQueryObjectui64v(interval.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(interval.end, GL_QUERY_RESULT, &end);
+
+        profiler->record(interval.stage, FrameProfiler::CLOCK_GPU, int64_t(begin) + offset, int64_t(end - begin));
+
+        if (collected) {
+            FrameProfiler::Sample s;
+            s.stage = interval.stage;
+            s.clock = FrameProfiler::CLOCK_GPU;
+            s.thread = -1;
+            s.start = int64_t(begin) + offset;
+            s.duration = int64_t(end - begin);
+            collected->push_back(s);
+        }
+
+        freeQueries.push_back(interval.begin);
+        freeQueries.push_back(interval.end);
+        pending.pop_front();
+    }
+}
+
+GLuint GpuTimer::getQuery() {
+    if (freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        return query;
+    }
+
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+
+    return query;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <GL/glew.h>
+
+#include "FrameProfiler.hpp"
+
+namespace pgp {
+
+    using std::deque;
+    using std::vector;
+
+    /**
+     * Times GPU work of profiler stages by GL_TIMESTAMP queries.
+     *
+     * Results arrive a few frames later, collect() records those that are
+     * available without stalling the pipeline. GPU times are moved to the
+     * profiler's clock by an offset measured at construction.
+     */
+    class GpuTimer {
+    public:
+        // Unread intervals kept before the oldest are dropped, a few frames
+        // of work.
+        static const size_t MAX_PENDING = 256;
+
+    private:
+        struct Interval {
+            int stage;
+            GLuint begin, end;
+        };
+
+        FrameProfiler *profiler;
+        int64_t offset;
+
+        deque<Interval> pending;
+        vector<GLuint> freeQueries;
+        Interval current;
+
+    public:
+        /**
+         * Needs current GL context.
+         */
+        GpuTimer(FrameProfiler *profiler);
+        ~GpuTimer();
+
+        void begin(int stage);
+        void end();
+
+        /**
+         * Records finished intervals into the profiler, and appends them to
+         * collected when given.
+         */
+        void collect(vector<FrameProfiler::Sample> *collected = NULL);
+
+    private:
+        GLuint getQuery();
+    };
+
+}
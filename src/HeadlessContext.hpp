@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <EGL/egl.h>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace pgp {
+
+    using std::string;
+    using std::vector;
+    using glm::ivec2;
+
+    /**
+     * OpenGL context without a window, created through EGL. Mesa's
+     * surfaceless platform is preferred, so llvmpipe renders on machines
+     * without a display or GPU; other drivers get the default EGL display.
+     *
+     * There is no default framebuffer, rendering goes to the framebuffer
+     * object returned by getFramebuffer().
+     */
+    class HeadlessContext {
+    private:
+        EGLDisplay display;
+        EGLContext context;
+        GLuint fbo, colorBuffer;
+        ivec2 size;
+
+    public:
+        /**
+         * Makes the new context current and initializes GLEW. Throws string
+         * when no display or context with given version is available.
+         */
+        HeadlessContext(ivec2 size, int major = 4, int minor = 3);
+        ~HeadlessContext();
+
+        inline GLuint getFramebuffer() {
+            return fbo;
+        }
+
+        inline ivec2 getSize() {
+            return size;
+        }
+
+        /**
+         * Writes content of the framebuffer to binary PPM file.
+         */
+        void writePPM(const string &filename);
+    };
+
+}
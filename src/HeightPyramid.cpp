@@ -0,0 +1,310 @@
+#include <algorithm>
+
+#include "HeightPyramid.hpp"
+
+// Jobs per pool thread, and the least queries or grid rows of one job.
+#define BLOCKS_PER_THREAD 4
+#define MIN_QUERY_BLOCK 256
+#define MIN_ROW_BLOCK 16
+// Levels of a grid with int sizes, bounds the traversal stack.
+#define MAX_LEVELS 32
+
+using namespace pgp;
+using namespace glm;
+
+HeightPyramid::HeightPyramid(ThreadPool *_pool) : pool(_pool), size(0), origin(0), spacing(1) {
+}
+
+void HeightPyramid::build(const float *_heights, ivec2 _size, vec2 _origin, float _spacing) {
+    if (_size.x < 2 || _size.y < 2) {
+        clear();
+        return;
+    }
+
+    size = _size;
+    origin = _origin;
+    spacing = _spacing;
+    heights.assign(_heights, _heights + size.x * size.y);
+
+    int levelCount = 1;
+    for (ivec2 s = size - 1; s.x > 1 || s.y > 1; s = (s + 1) / 2) {
+        levelCount++;
+    }
+
+    levels.resize(levelCount);
+    levels[0].size = size - 1;
+
+    for (int l = 1; l < levelCount; l++) {
+        levels[l].size = (levels[l - 1].size + 1) / 2;
+    }
+
+    for (Level &level : levels) {
+        level.bounds.resize(level.size.x * level.size.y);
+    }
+
+    Level &cells = levels[0];
+
+    runBlocks(cells.size.x, MIN_ROW_BLOCK, [&](size_t first, size_t last) {
+        for (size_t x = first; x < last; x++) {
+            const float *h = &heights[x * size.y];
+            vec2 *bounds = &cells.bounds[x * cells.size.y];
+
+            for (int z = 0; z < cells.size.y; z++) {
+                float a = h[z], b = h[z + 1], c = h[size.y + z], d = h[size.y + z + 1];
+                bounds[z] = vec2(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+            }
+        }
+    });
+
+    for (int l = 1; l < levelCount; l++) {
+        const Level &lower = levels[l - 1];
+        Level &level = levels[l];
+
+        runBlocks(level.size.x, MIN_ROW_BLOCK, [&](size_t first, size_t last) {
+            for (int x = first; x < int(last); x++) {
+                for (int z = 0; z < level.size.y; z++) {
+                    vec2 b(INFINITY, -INFINITY);
+
+                    // Odd sizes leave the last node with fewer children.
+                    for (int cx = 2 * x; cx < std::min(2 * x + 2, lower.size.x); cx++) {
+                        for (int cz = 2 * z; cz < std::min(2 * z + 2, lower.size.y); cz++) {
+                            vec2 child = lower.bounds[cx * lower.size.y + cz];
+                            b = vec2(std::min(b.x, child.x), std::max(b.y, child.y));
+                        }
+                    }
+
+                    level.bounds[x * level.size.y + z] = b;
+                }
+            }
+        });
+    }
+}
+
+void HeightPyramid::clear() {
+    size = ivec2(0);
+    heights.clear();
+    levels.clear();
+}
+
+void HeightPyramid::swap(HeightPyramid &other) {
+    std::swap(size, other.size);
+    std::swap(origin, other.origin);
+    std::swap(spacing, other.spacing);
+    heights.swap(other.heights);
+    levels.swap(other.levels);
+}
+
+float HeightPyramid::height(float x, float z) const {
+    vec2 g = (vec2(x, z) - origin) / spacing;
+
+    if (levels.empty() || !(g.x >= 0 && g.y >= 0 && g.x <= size.x - 1 && g.y <= size.y - 1)) {
+        return NAN;
+    }
+
+    // Far border belongs to the last cell.
+    ivec2 i = min(ivec2(floor(g)), size - 2);
+    vec2 f = g - vec2(i);
+    const float *h = &heights[i.x * size.y + i.y];
+
+    return mix(mix(h[0], h[1], f.y), mix(h[size.y], h[size.y + 1], f.y), f.x);
+}
+
+void HeightPyramid::height(const vec2 *points, float *out, size_t count) const {
+    runBlocks(count, MIN_QUERY_BLOCK, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            out[i] = height(points[i].x, points[i].y);
+        }
+    });
+}
+
+float HeightPyramid::intersect(vec3 o, vec3 d, float maxDistance) const {
+    if (levels.empty()) {
+        return INFINITY;
+    }
+
+    vec2 go = (vec2(o.x, o.z) - origin) / spacing;
+    vec2 gd = vec2(d.x, d.z) / spacing;
+
+    struct Node {
+        int level;
+        ivec2 cell;
+        float t0, t1;
+    };
+
+    // Every visited node replaces itself by at most four children.
+    Node stack[3 * MAX_LEVELS + 1];
+    int top = 0;
+
+    Node root = { int(levels.size()) - 1, ivec2(0), 0, maxDistance };
+
+    if (!clipToCells(go, gd, ivec2(0), levels[0].size, root.t0, root.t1)) {
+        return INFINITY;
+    }
+
+    stack[top++] = root;
+
+    while (top > 0) {
+        Node node = stack[--top];
+        const Level &level = levels[node.level];
+        vec2 bounds = level.bounds[node.cell.x * level.size.y + node.cell.y];
+
+        float y0 = o.y + d.y * node.t0;
+        float y1 = o.y + d.y * node.t1;
+
+        if (std::min(y0, y1) > bounds.y) {
+            continue;
+        }
+
+        // Whole segment at or below the lowest point of the node.
+        if (std::max(y0, y1) <= bounds.x) {
+            return node.t0;
+        }
+
+        if (node.level == 0) {
+            float t = intersectCell(node.cell, o, d, go, gd, node.t0, node.t1);
+
+            if (t >= 0) {
+                return t;
+            }
+
+            continue;
+        }
+
+        const Level &lower = levels[node.level - 1];
+        int lowerCells = 1 << (node.level - 1);
+        Node children[4];
+        int childCount = 0;
+
+        for (int i = 0; i < 4; i++) {
+            Node child = { node.level - 1, node.cell * 2 + ivec2(i >> 1, i & 1), node.t0, node.t1 };
+
+            if (child.cell.x >= lower.size.x || child.cell.y >= lower.size.y) {
+                continue;
+            }
+
+            ivec2 lo = child.cell * lowerCells;
+            ivec2 hi = min((child.cell + 1) * lowerCells, levels[0].size);
+
+            if (!clipToCells(go, gd, lo, hi, child.t0, child.t1)) {
+                continue;
+            }
+
+            // Sorted by entry, farthest first, so the nearest is popped next.
+            int j = childCount++;
+            for (; j > 0 && children[j - 1].t0 < child.t0; j--) {
+                children[j] = children[j - 1];
+            }
+            children[j] = child;
+        }
+
+        for (int i = 0; i < childCount; i++) {
+            stack[top++] = children[i];
+        }
+    }
+
+    return INFINITY;
+}
+
+void HeightPyramid::intersect(const vec3 *origins, const vec3 *directions, float *distances, size_t count,
+        float maxDistance) const {
+
+    runBlocks(count, MIN_QUERY_BLOCK, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            distances[i] = intersect(origins[i], directions[i], maxDistance);
+        }
+    });
+}
+
+bool HeightPyramid::clipToCells(vec2 o, vec2 d, ivec2 lo, ivec2 hi, float &t0, float &t1) {
+    for (int axis = 0; axis < 2; axis++) {
+        if (d[axis] == 0) {
+            if (o[axis] < lo[axis] || o[axis] > hi[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        float a = (lo[axis] - o[axis]) / d[axis];
+        float b = (hi[axis] - o[axis]) / d[axis];
+
+        t0 = std::max(t0, std::min(a, b));
+        t1 = std::min(t1, std::max(a, b));
+    }
+
+    return t0 <= t1;
+}
+
+float HeightPyramid::intersectCell(ivec2 cell, vec3 o, vec3 d, vec2 go, vec2 gd, float t0, float t1) const {
+    const float *h = &heights[cell.x * size.y + cell.y];
+
+    // Patch h00 + a * u + b * v + c * u * v over the cell.
+    float h00 = h[0];
+    float a = h[size.y] - h00;
+    float b = h[1] - h00;
+    float c = h00 - h[size.y] - h[1] + h[size.y + 1];
+
+    float u = go.x + gd.x * t0 - cell.x;
+    float v = go.y + gd.y * t0 - cell.y;
+
+    // Height above the patch is c0 + c1 * s + c2 * s^2 at t0 + s.
+    float c0 = o.y + d.y * t0 - (h00 + a * u + b * v + c * u * v);
+
+    if (c0 <= 0) {
+        return t0;
+    }
+
+    float c1 = d.y - (a * gd.x + b * gd.y + c * (u * gd.y + v * gd.x));
+    float c2 = -c * gd.x * gd.y;
+    float length = t1 - t0;
+    float s = INFINITY;
+
+    if (c2 == 0) {
+        if (c1 < 0) {
+            s = -c0 / c1;
+        }
+    } else {
+        float discriminant = c1 * c1 - 4 * c2 * c0;
+
+        if (discriminant >= 0) {
+            // Roots without cancellation, c0 > 0 keeps q non-zero.
+            float q = -0.5f * (c1 + std::copysign(std::sqrt(discriminant), c1));
+            float r0 = q / c2;
+            float r1 = c0 / q;
+
+            if (r0 > r1) {
+                std::swap(r0, r1);
+            }
+
+            s = r0 >= 0 ? r0 : r1 >= 0 ? r1 : INFINITY;
+        }
+    }
+
+    if (s <= length) {
+        return t0 + s;
+    }
+
+    // Root just past the end by rounding.
+    if (c0 + (c1 + c2 * length) * length <= 0) {
+        return t1;
+    }
+
+    return -1;
+}
+
+void HeightPyramid::runBlocks(size_t count, size_t minBlock, const std::function<void(size_t, size_t)> &block) const {
+    size_t blockCount = 1;
+
+    if (pool) {
+        blockCount = std::min<size_t>((count + minBlock - 1) / minBlock,
+                pool->getThreadCount() * BLOCKS_PER_THREAD);
+    }
+
+    if (blockCount <= 1) {
+        block(0, count);
+        return;
+    }
+
+    pool->run(blockCount, [&](unsigned i) {
+        block(count * i / blockCount, count * (i + 1) / blockCount);
+    });
+}
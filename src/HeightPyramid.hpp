@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::ivec2;
+    using glm::vec2;
+    using glm::vec3;
+
+    /**
+     * Height and ray queries against a regular grid of heights.
+     *
+     * The surface is bilinear over the grid cells, as the lattice heights are
+     * interpolated elsewhere. Level 0 of the pyramid keeps minimum and
+     * maximum height of every cell, each next level of every 2x2 block of the
+     * previous one. A ray walks the pyramid from its single top node front
+     * to back and skips nodes it passes above, so it visits O(log n) nodes
+     * over open terrain and solves a quadratic only in the cells it may hit.
+     *
+     * Queries are const and may run on many threads, build() must not run
+     * at the same time.
+     */
+    class HeightPyramid {
+    private:
+        struct Level {
+            // Nodes in x and z, node x, z is at bounds[x * size.y + z].
+            ivec2 size;
+            // Minimum and maximum height.
+            vector<vec2> bounds;
+        };
+
+        ThreadPool *pool;
+        ivec2 size;
+        vec2 origin;
+        float spacing;
+        vector<float> heights;
+        vector<Level> levels;
+
+    public:
+        /**
+         * Without pool build and batched queries run on the calling thread.
+         */
+        HeightPyramid(ThreadPool *pool = NULL);
+
+        /**
+         * Copies size.x * size.y heights, height of sample x, z is at
+         * heights[x * size.y + z] and lies at world position origin + x, z
+         * times spacing, the layout of TerrainMesh heightmaps. Grid smaller
+         * than 2x2 samples leaves the pyramid empty.
+         */
+        void build(const float *heights, ivec2 size, vec2 origin, float spacing);
+
+        void clear();
+
+        void swap(HeightPyramid &other);
+
+        inline bool isEmpty() const {
+            return levels.empty();
+        }
+
+        inline ivec2 getSize() const {
+            return size;
+        }
+
+        inline int getLevelCount() const {
+            return levels.size();
+        }
+
+        /**
+         * Height at world x, z, NAN outside of the grid.
+         */
+        float height(float x, float z) const;
+
+        /**
+         * Heights of count points given as world x, z.
+         */
+        void height(const vec2 *points, float *heights, size_t count) const;
+
+        /**
+         * Distance along direction to the first point of the ray at or below
+         * the surface, INFINITY when there is none within max distance or
+         * the grid. Origin below the surface gives 0. Distance is in units of
+         * direction length.
+         */
+        float intersect(vec3 origin, vec3 direction, float maxDistance = INFINITY) const;
+
+        /**
+         * Intersects count rays, distances as above.
+         */
+        void intersect(const vec3 *origins, const vec3 *directions, float *distances, size_t count,
+                float maxDistance = INFINITY) const;
+
+    private:
+        /**
+         * Interval of ray parameters inside grid cells lo up to hi, false
+         * when the ray misses them.
+         */
+        static bool clipToCells(vec2 origin, vec2 direction, ivec2 lo, ivec2 hi, float &t0, float &t1);
+
+        /**
+         * First parameter in t0, t1 where the ray is at or below the bilinear
+         * patch of cell, negative when there is none.
+         */
+        float intersectCell(ivec2 cell, vec3 origin, vec3 direction, vec2 gridOrigin, vec2 gridDirection,
+                float t0, float t1) const;
+
+        /**
+         * Splits items 0 up to count into blocks of at least min block
+         * items and runs them on the pool.
+         */
+        void runBlocks(size_t count, size_t minBlock, const std::function<void(size_t, size_t)> &block) const;
+    };
+
+}
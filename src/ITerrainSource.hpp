@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "TerrainGenerator.hpp"
+
+namespace pgp {
+
+    using std::vector;
+
+    /**
+     * Work done by terrain source since it was created. Reused and generated
+     * parts are counted in units of the source, chunks or height samples.
+     * Times are in milliseconds.
+     */
+    struct TerrainStats {
+        unsigned long hits;
+        unsigned long misses;
+        unsigned reloads;
+        float lastReloadTime;
+        float totalReloadTime;
+
+        inline float getHitRate() const {
+            return hits + misses ? float(hits) / (hits + misses) : 0;
+        }
+
+        inline float getAverageReloadTime() const {
+            return reloads ? totalReloadTime / reloads : 0;
+        }
+    };
+
+    /**
+     * Built terrain. Regular grid has HEIGHTMAP_SIZE^2 heights and
+     * (LANDSCAPE_SIZE + 1)^2 vertices in layout of TerrainGenerator::generate,
+     * and no indices of its own. Other meshes have no heightmap and index
+     * triangle strips separated by UINT32_MAX.
+     */
+    struct TerrainMesh {
+        vector<float> heightmap;
+        vector<TerrainVertex> vertices;
+        vector<uint32_t> indices;
+
+        inline void resizeGrid() {
+            heightmap.resize(HEIGHTMAP_SIZE * HEIGHTMAP_SIZE);
+            vertices.resize((LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1));
+            indices.clear();
+        }
+
+        inline bool isGrid() const {
+            return indices.empty();
+        }
+    };
+
+    /**
+     * Produces terrain around given position, reusing whatever it can from
+     * previous builds. Grids start at TerrainGenerator::getGridOrigin.
+     */
+    class ITerrainSource {
+    public:
+        virtual ~ITerrainSource() {
+        }
+
+        /**
+         * Not thread safe, one build at a time.
+         */
+        virtual void build(vec3 position, TerrainMesh &mesh) = 0;
+
+        virtual const TerrainStats &getStats() const = 0;
+    };
+}
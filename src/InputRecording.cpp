@@ -0,0 +1,231 @@
+#include <cstring>
+
+#include "InputRecording.hpp"
+
+using namespace pgp;
+using namespace std;
+
+#define MAGIC "PGPI"
+// Bytes of the smallest recorded event, a wheel event.
+#define MIN_EVENT_SIZE 12
+
+const uint32_t InputRecording::VERSION;
+
+template<typename T>
+static void put(ostream &out, T value) {
+    out.write((const char*) &value, sizeof (T));
+}
+
+template<typename T>
+static bool get(istream &in, T &value) {
+    return bool(in.read((char*) &value, sizeof (T)));
+}
+
+bool InputRecording::isInput(const SDL_Event &evt) {
+    switch (evt.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void InputRecording::writeEvent(ostream &out, const SDL_Event &evt) {
+    put<uint32_t>(out, evt.type);
+
+    switch (evt.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            put<uint8_t>(out, evt.key.state);
+            put<uint8_t>(out, evt.key.repeat);
+            put<int32_t>(out, evt.key.keysym.scancode);
+            put<int32_t>(out, evt.key.keysym.sym);
+            put<uint16_t>(out, evt.key.keysym.mod);
+            break;
+        case SDL_MOUSEMOTION:
+            put<uint32_t>(out, evt.motion.state);
+            put<int32_t>(out, evt.motion.x);
+            put<int32_t>(out, evt.motion.y);
+            put<int32_t>(out, evt.motion.xrel);
+            put<int32_t>(out, evt.motion.yrel);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            put<uint8_t>(out, evt.button.button);
+            put<uint8_t>(out, evt.button.state);
+            put<uint8_t>(out, evt.button.clicks);
+            put<int32_t>(out, evt.button.x);
+            put<int32_t>(out, evt.button.y);
+            break;
+        case SDL_MOUSEWHEEL:
+            put<int32_t>(out, evt.wheel.x);
+            put<int32_t>(out, evt.wheel.y);
+            break;
+    }
+}
+
+bool InputRecording::readEvent(istream &in, SDL_Event &evt) {
+    uint32_t type;
+
+    if (!get(in, type)) {
+        return false;
+    }
+
+    memset(&evt, 0, sizeof (evt));
+    evt.type = type;
+
+    uint8_t u8[3];
+    uint16_t u16;
+    int32_t i32[4];
+    uint32_t u32;
+    bool ok;
+
+    switch (type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            ok = get(in, u8[0]) && get(in, u8[1]) && get(in, i32[0]) && get(in, i32[1]) && get(in, u16);
+            evt.key.state = u8[0];
+            evt.key.repeat = u8[1];
+            evt.key.keysym.scancode = SDL_Scancode(i32[0]);
+            evt.key.keysym.sym = i32[1];
+            evt.key.keysym.mod = u16;
+            break;
+        case SDL_MOUSEMOTION:
+            ok = get(in, u32) && get(in, i32[0]) && get(in, i32[1]) && get(in, i32[2]) && get(in, i32[3]);
+            evt.motion.state = u32;
+            evt.motion.x = i32[0];
+            evt.motion.y = i32[1];
+            evt.motion.xrel = i32[2];
+            evt.motion.yrel = i32[3];
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            ok = get(in, u8[0]) && get(in, u8[1]) && get(in, u8[2]) && get(in, i32[0]) && get(in, i32[1]);
+            evt.button.button = u8[0];
+            evt.button.state = u8[1];
+            evt.button.clicks = u8[2];
+            evt.button.x = i32[0];
+            evt.button.y = i32[1];
+            break;
+        case SDL_MOUSEWHEEL:
+            ok = get(in, i32[0]) && get(in, i32[1]);
+            evt.wheel.x = i32[0];
+            evt.wheel.y = i32[1];
+            break;
+        default:
+            throw string("Unknown event type " + to_string(type) + " in input recording.");
+    }
+
+    if (!ok) {
+        throw string("Input recording ends inside of an event.");
+    }
+
+    return true;
+}
+
+InputRecorder::InputRecorder(const string &_filename) :
+        file(_filename.c_str(), ios::binary), filename(_filename), frameCount(0) {
+
+    if (!file) {
+        throw string("Could not write input recording '" + filename + "'.");
+    }
+
+    file.write(MAGIC, 4);
+    put<uint32_t>(file, VERSION);
+}
+
+void InputRecorder::addEvent(const SDL_Event &evt) {
+    if (isInput(evt)) {
+        frame.events.push_back(evt);
+    }
+}
+
+void InputRecorder::endFrame(float time, float delta) {
+    put<float>(file, time);
+    put<float>(file, delta);
+    put<uint32_t>(file, frame.events.size());
+
+    for (const SDL_Event &evt : frame.events) {
+        writeEvent(file, evt);
+    }
+
+    file.flush();
+
+    if (!file) {
+        throw string("Could not write input recording '" + filename + "'.");
+    }
+
+    frame.events.clear();
+    frameCount++;
+}
+
+InputReplay::InputReplay() : next(0) {
+}
+
+void InputReplay::load(const string &filename) {
+    ifstream file(filename.c_str(), ios::binary | ios::ate);
+
+    if (!file) {
+        throw string("Could not read input recording '" + filename + "'.");
+    }
+
+    streamoff size = file.tellg();
+    file.seekg(0);
+
+    char magic[4];
+    uint32_t version;
+
+    if (!file.read(magic, 4) || memcmp(magic, MAGIC, 4) != 0 || !get(file, version)) {
+        throw string("'" + filename + "' is not an input recording.");
+    }
+
+    if (version != VERSION) {
+        throw string("Input recording '" + filename + "' has version " + to_string(version)
+                + ", expected " + to_string(VERSION) + ".");
+    }
+
+    vector<InputFrame> loaded;
+    InputFrame frame;
+    uint32_t count;
+
+    while (get(file, frame.time)) {
+        if (!get(file, frame.delta) || !get(file, count)) {
+            throw string("Input recording '" + filename + "' ends inside of a frame.");
+        }
+
+        // Count of a corrupt file must not allocate more than the file holds.
+        streamoff left = size - streamoff(file.tellg());
+
+        if (count > left / MIN_EVENT_SIZE) {
+            throw string("Input recording '" + filename + "' has more events in a frame than it can hold.");
+        }
+
+        frame.events.resize(count);
+
+        for (SDL_Event &evt : frame.events) {
+            if (!readEvent(file, evt)) {
+                throw string("Input recording '" + filename + "' ends inside of a frame.");
+            }
+        }
+
+        loaded.push_back(frame);
+    }
+
+    frames.swap(loaded);
+    next = 0;
+}
+
+bool InputReplay::nextFrame(InputFrame &frame) {
+    if (next >= frames.size()) {
+        return false;
+    }
+
+    frame = frames[next++];
+
+    return true;
+}
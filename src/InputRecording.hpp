@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+namespace pgp {
+
+    using std::string;
+    using std::vector;
+
+    /**
+     * Input of one frame, the events polled before it and the clock its
+     * processors stepped with.
+     */
+    struct InputFrame {
+        float time;
+        float delta;
+        vector<SDL_Event> events;
+    };
+
+    /**
+     * Binary file of input frames, written by InputRecorder and read by
+     * InputReplay.
+     *
+     * The file starts with magic "PGPI" and a uint32 version. Each frame
+     * then holds float time, float delta, uint32 event count and the events.
+     * An event is its uint32 type followed by the fields listeners read,
+     * window, timestamp and other fields are not kept. All values are in
+     * host byte order.
+     *
+     * Only user input (keys, mouse motion, buttons and wheel) is recorded.
+     * Window events belong to the window running the replay.
+     */
+    class InputRecording {
+    public:
+        static const uint32_t VERSION = 1;
+
+        static bool isInput(const SDL_Event &evt);
+
+    protected:
+        static void writeEvent(std::ostream &out, const SDL_Event &evt);
+
+        /**
+         * False at the end of file, throws string on a truncated or unknown
+         * event.
+         */
+        static bool readEvent(std::istream &in, SDL_Event &evt);
+    };
+
+    /**
+     * Appends frames to a recording as they end, so a crashed run leaves all
+     * but the last frame behind.
+     */
+    class InputRecorder : public InputRecording {
+    private:
+        std::ofstream file;
+        string filename;
+        InputFrame frame;
+        unsigned long frameCount;
+
+    public:
+        /**
+         * Throws string when the file cannot be written.
+         */
+        InputRecorder(const string &filename);
+
+        /**
+         * Events other than input are ignored.
+         */
+        void addEvent(const SDL_Event &evt);
+
+        /**
+         * Writes the frame of events added since the last call.
+         */
+        void endFrame(float time, float delta);
+
+        inline unsigned long getFrameCount() const {
+            return frameCount;
+        }
+    };
+
+    /**
+     * Recording loaded whole, handed out frame by frame.
+     */
+    class InputReplay : public InputRecording {
+    private:
+        vector<InputFrame> frames;
+        size_t next;
+
+    public:
+        InputReplay();
+
+        /**
+         * Throws string when the file is missing or not a recording.
+         */
+        void load(const string &filename);
+
+        /**
+         * False once all frames were read.
+         */
+        bool nextFrame(InputFrame &frame);
+
+        inline size_t getFrameCount() const {
+            return frames.size();
+        }
+    };
+
+}
@@ -4,25 +4,21 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Landscape.hpp"
+#include "ClipmapTerrain.hpp"
+#include "TerrainChunkCache.hpp"
+#include "ToroidalTerrain.hpp"
 
-#define LANDSCAPE_SIZE 350
-#define LANDSCAPE_SIZEF float(LANDSCAPE_SIZE)
 #define INDEX_COUNT (2 * (LANDSCAPE_SIZE + 1) * LANDSCAPE_SIZE + LANDSCAPE_SIZE)
-#define BASE_FREQUENCY 100
-#define RESOLUTION 0.85
 
 using namespace pgp;
 
 using glm::u8vec3;
 using glm::vec3;
 
-typedef struct {
-    vec3 position;
-    vec3 normal;
-    u8vec3 color;
-} Vertex;
+typedef TerrainVertex Vertex;
 
-Landscape::Landscape(Camera *_camera) : camera(_camera), vao(0), vbo(0), ebo(0), polygonMode(GL_FILL) {
+Landscape::Landscape(Camera *_camera, unsigned threadCount, TerrainMode mode) : camera(_camera), front(0), polygonMode(GL_FILL),
+    pool(threadCount), source(createSource(mode, &pool)), builder(source.get()) {
     string vertexShaderFile("./shaders/landscape.vert");
     string fragmentShaderFile("./shaders/landscape.frag");
 
@@ -85,29 +81,9 @@ Landscape::Landscape(Camera *_camera) : camera(_camera), vao(0), vbo(0), ebo(0),
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    vector<GLuint> gridIndices(INDEX_COUNT);
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, (LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1) * sizeof (Vertex), NULL, GL_STREAM_DRAW);
-
-    glEnableVertexAttribArray(aPosition);
-    glVertexAttribPointer(aPosition, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, position));
-
-    glEnableVertexAttribArray(aNormal);
-    glVertexAttribPointer(aNormal, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, normal));
-
-    glEnableVertexAttribArray(aColor);
-    glVertexAttribPointer(aColor, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, color));
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, INDEX_COUNT * sizeof (GLuint), NULL, GL_STATIC_DRAW);
-
-    GLuint *eboData = (GLuint*) glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-    GLuint *dataPtr = eboData;
+    GLuint *dataPtr = &gridIndices[0];
     //    int ctr = 0;
     for (int row = 0; row < LANDSCAPE_SIZE; row++) {
         for (int col = 0; col <= LANDSCAPE_SIZE; col++) {
@@ -134,15 +110,40 @@ Landscape::Landscape(Camera *_camera) : camera(_camera), vao(0), vbo(0), ebo(0),
     //    std::cout << "Size: " << ctr << std::endl;
     //    std::cout << "Estimated size: " << INDEX_COUNT << std::endl;
 
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    glGenVertexArrays(2, vao);
+    glGenBuffers(2, vbo);
+    glGenBuffers(2, ebo);
 
-    glBindVertexArray(0);
+    for (int i = 0; i < 2; i++) {
+        glBindVertexArray(vao[i]);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo[i]);
+        glBufferData(GL_ARRAY_BUFFER, (LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1) * sizeof (Vertex), NULL, GL_STREAM_DRAW);
 
-    center = camera->getPosition();
+        glEnableVertexAttribArray(aPosition);
+        glVertexAttribPointer(aPosition, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, position));
 
-    heightmap = new float[(LANDSCAPE_SIZE + 2) * (LANDSCAPE_SIZE + 2)];
+        glEnableVertexAttribArray(aNormal);
+        glVertexAttribPointer(aNormal, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, normal));
 
-    reloadTerrain();
+        glEnableVertexAttribArray(aColor);
+        glVertexAttribPointer(aColor, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (Vertex), (GLvoid*) offsetof(Vertex, color));
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo[i]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, INDEX_COUNT * sizeof (GLuint), &gridIndices[0], GL_STATIC_DRAW);
+        indexCount[i] = INDEX_COUNT;
+    }
+
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // There is nothing to show yet, so the first build is waited for.
+    builder.request(camera->getPosition());
+    builder.wait();
+    builder.swapIfReady([this] {
+        swapTerrain();
+    });
 }
 
 Landscape::~Landscape() {
@@ -153,16 +154,15 @@ Landscape::~Landscape() {
     glDeleteTextures(1, &colTex);
     glDeleteTextures(1, &depTex);
 
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ebo);
-
-    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(2, vbo);
+    glDeleteBuffers(2, ebo);
 
-    delete heightmap;
+    glDeleteVertexArrays(2, vao);
 }
 
 
 #ifdef WRITE_HEIGHTMAP
+#include <fstream>
 
 void writePGM(int width, int height, unsigned char *data, std::string filename) {
 
@@ -178,136 +178,69 @@ void writePGM(int width, int height, unsigned char *data, std::string filename)
 }
 #endif
 
-void Landscape::reloadTerrain() {
+void Landscape::swapTerrain() {
+    int back = 1 - front;
+    const TerrainMesh &mesh = builder.getMesh();
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[back]);
+    // Respecifying the storage orphans the old one, so the upload does not
+    // wait for draws which may still read it.
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof (Vertex), &mesh.vertices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    Vertex *vboData = (Vertex*) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+    // Source never changes, so grid meshes keep the grid indices from constructor.
+    if (!mesh.isGrid()) {
+        glBindVertexArray(vao[back]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof (GLuint), &mesh.indices[0], GL_STREAM_DRAW);
+        glBindVertexArray(0);
 
-    vec3 pos = camera->getPosition();
-    float *map = heightmap;
-
-    float max = 0;
-    for (int row = -1; row <= LANDSCAPE_SIZE; row++) {
-        for (int col = -1; col <= LANDSCAPE_SIZE; col++) {
-            float x, y, z;
-
-            x = ((row - 1) - (LANDSCAPE_SIZEF / 2.0)) * RESOLUTION + pos.x;
-            z = ((col - 1) - (LANDSCAPE_SIZEF / 2.0)) * RESOLUTION + pos.z;
-            y = 0;
-
-            y += parametrizedNoise(x, z, 4.0 / BASE_FREQUENCY, 2.0 / BASE_FREQUENCY, 65.0);
-            y += parametrizedNoise(x + 7769.0, z + 1103.0, 16.0 / BASE_FREQUENCY, 18.0 / BASE_FREQUENCY, 5.0);
-            y += parametrizedNoise(x - 356.0, z + 32776.0, 64.0 / BASE_FREQUENCY, 64.0 / BASE_FREQUENCY, 0.5);
-
-            *map = y;
-            map++;
-
-            if (y > max) {
-                max = y;
-            }
-        }
+        indexCount[back] = mesh.indices.size();
     }
 
 #ifdef WRITE_HEIGHTMAP
-    unsigned char *_out = new unsigned char[(LANDSCAPE_SIZE + 2) * (LANDSCAPE_SIZE + 2)];
-    unsigned char *out = _out;
+    if (mesh.isGrid()) {
+        const float *heightmap = &mesh.heightmap[0];
 
-    map = heightmap;
-
-    for (int row = -1; row <= LANDSCAPE_SIZE; row++) {
-        for (int col = -1; col <= LANDSCAPE_SIZE; col++) {
-            int i = (row + 1) * (LANDSCAPE_SIZE + 2) + col;
-            *out = heightmap[i]*255 / max;
-            out++;
+        float max = 0;
+        for (int i = 0; i < HEIGHTMAP_SIZE * HEIGHTMAP_SIZE; i++) {
+            if (heightmap[i] > max) {
+                max = heightmap[i];
+            }
         }
-    }
-
-    writePGM((LANDSCAPE_SIZE + 2), (LANDSCAPE_SIZE + 2), _out, "heightmap.pgm");
 
-    delete _out;
-#endif
-
-    Vertex *dataPtr = vboData;
-    for (int row = 0; row <= LANDSCAPE_SIZE; row++) {
-        for (int col = 0; col <= LANDSCAPE_SIZE; col++) {
-            Vertex *v = dataPtr++;
-            vec3 a, b, c, d, g, h;
-
-            a.x = ((row) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
-            a.y = heightmap[(row) * (LANDSCAPE_SIZE + 2) + (col)];
-            a.z = ((col) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
-
-            b.x = ((row + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
-            b.y = heightmap[(row + 1) * (LANDSCAPE_SIZE + 2) + (col)];
-            b.z = ((col) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
-
-            c.x = ((row + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
-            c.y = heightmap[(row + 1) * (LANDSCAPE_SIZE + 2) + (col + 1)];
-            c.z = ((col + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
-
-            d.x = ((row) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
-            d.y = heightmap[(row) * (LANDSCAPE_SIZE + 2) + (col + 1)];
-            d.z = ((col + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
-
-            g = (a + b) * 0.5f;
-            h = (c + d) * 0.5f;
-            v->position = (g + h) * 0.5f;
-
-            a = normalize(a - c);
-            b = normalize(b - d);
-
-            v->normal = normalize(cross(b, a));
-
-            //            std::cout << "Normal: (" << v->normal.x << ", " << v->normal.y << ", " << v->normal.z << ")" << std::endl;
-
-            // Calculate color
-            v->color = u8vec3(0, 80, 0); // Color is green, grass is green, what is nice color it is. (Haiku?)
+        unsigned char *_out = new unsigned char[HEIGHTMAP_SIZE * HEIGHTMAP_SIZE];
+        unsigned char *out = _out;
 
+        for (int row = -1; row <= LANDSCAPE_SIZE; row++) {
+            for (int col = -1; col <= LANDSCAPE_SIZE; col++) {
+                int i = (row + 1) * HEIGHTMAP_SIZE + col;
+                *out = heightmap[i]*255 / max;
+                out++;
+            }
         }
-    }
-
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-}
-
-float Landscape::smoothNoise2D(float _x, float _y) {
-    int x0 = floor(_x);
-    int y0 = floor(_y);
 
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
+        writePGM(HEIGHTMAP_SIZE, HEIGHTMAP_SIZE, _out, "heightmap.pgm");
 
-    float rx = _x - x0;
-    float ry = _y - y0;
-
-    float a0 = 0, a1 = 0, b0 = 0, b1 = 0;
-
-    a0 = noise2D(x0, y0);
-    a1 = noise2D(x1, y0);
-
-    b0 = noise2D(x0, y1);
-    b1 = noise2D(x1, y1);
-
-    float a = interpolateCos(a0, a1, rx);
-    float b = interpolateCos(b0, b1, rx);
-
-    return interpolateCos(a, b, ry);
-
-}
-
-float Landscape::noise2D(int x, int y) {
-    x += 338573;
-    y += 77313501;
-    unsigned int n = ((((x * x) << 3) * 23) + ((y * y) << 1) * 51);
+        delete[] _out;
+    }
+#endif
 
-    return (((((n * 3342687 + 1144763) & 0xf2fcf7dd) - 77663544) * -113) * n) / (float) UINT_MAX;
+    front = back;
+    center = builder.getCenter();
+    terrainStats = builder.getStats();
+    heights.swap(builder.getHeights());
 }
 
-float Landscape::interpolateCos(float a, float b, float factor) {
-    factor = (1 - cos(factor * glm::pi<float>())) * 0.5;
-
-    return a * (1 - factor) + b * factor;
+ITerrainSource *Landscape::createSource(TerrainMode mode, ThreadPool *pool) {
+    switch (mode) {
+        case TERRAIN_RING:
+            return new ToroidalTerrain(pool);
+        case TERRAIN_CLIPMAP:
+            return new ClipmapTerrain(pool);
+        case TERRAIN_CHUNKS:
+        default:
+            return new TerrainChunkCache(pool);
+    }
 }
 
 mat4 Landscape::getProjectionMatrix() {
@@ -331,6 +264,10 @@ mat4 Landscape::getViewMatrix() {
 
 void Landscape::render() {
 
+    builder.swapIfReady([this] {
+        swapTerrain();
+    });
+
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
     runRenderers();
@@ -359,12 +296,12 @@ void Landscape::render() {
 
     glUniform3fv(uEyePosition, 1, &camPos[0]);
 
-    glBindVertexArray(vao);
+    glBindVertexArray(vao[front]);
 
     glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
 
     glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
-    glDrawElements(GL_TRIANGLE_STRIP, INDEX_COUNT, GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLE_STRIP, indexCount[front], GL_UNSIGNED_INT, 0);
     glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
 
     glBindVertexArray(0);
@@ -372,10 +309,8 @@ void Landscape::render() {
 }
 
 void Landscape::step(float time, float delta) {
-    if (distance(center, camera->getPosition()) > 15.0) {
-        reloadTerrain();
-        center = camera->getPosition();
-    }
+    // Current terrain is drawn until the new one is swapped in by render().
+    builder.follow(center, camera->getPosition());
 }
 
 IEventListener::EventResponse Landscape::onEvent(SDL_Event* evt) {
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <memory>
+
 #include "Camera.hpp"
 #include "IRenderer.hpp"
 #include "IProcessor.hpp"
 #include "RenderShaderProgram.hpp"
 #include "RegistrablesContainer.hpp"
+#include "TerrainBuilder.hpp"
+#include "ITerrainSource.hpp"
+#include "ThreadPool.hpp"
 
 namespace pgp {
 
@@ -12,10 +17,22 @@ namespace pgp {
     using glm::mat4;
 
     class Landscape : public IRenderer, public IProcessor, public IEventListener, public RegistrablesContainer {
+    public:
+
+        enum TerrainMode {
+            TERRAIN_CHUNKS,
+            TERRAIN_RING,
+            TERRAIN_CLIPMAP,
+        };
+
     private:
         Camera *camera;
         RenderShaderProgram renderProgram;
-        GLuint vao, vbo, ebo;
+        // Terrain is double buffered, vao[front] is drawn while new terrain
+        // is uploaded to the other buffer.
+        GLuint vao[2], vbo[2], ebo[2];
+        GLsizei indexCount[2];
+        int front;
         GLuint fbo, colTex, depTex;
         GLuint rbo;
         GLint uView, uProjection;
@@ -23,9 +40,18 @@ namespace pgp {
         GLint aPosition, aNormal, aColor;
         GLenum polygonMode;
         vec3 center;
-        float *heightmap;
+        ThreadPool pool;
+        // Declared before builder, so it outlives the builder thread.
+        std::unique_ptr<ITerrainSource> source;
+        TerrainBuilder builder;
+        TerrainStats terrainStats;
+        HeightPyramid heights;
     public:
-        Landscape(Camera *camera);
+        /**
+         * Thread count 0 uses all hardware threads for terrain generation.
+         * Mode selects chunk cache, ring buffer or clipmap terrain source.
+         */
+        Landscape(Camera *camera, unsigned threadCount = 0, TerrainMode mode = TERRAIN_CHUNKS);
 
         ~Landscape();
 
@@ -41,6 +67,21 @@ namespace pgp {
             return fbo;
         }
 
+        /**
+         * Terrain source stats as of the last terrain swap.
+         */
+        inline const TerrainStats &getTerrainStats() {
+            return terrainStats;
+        }
+
+        /**
+         * Height and ray queries over the drawn terrain, for the render
+         * thread only. Empty with clipmap terrain, which has no grid.
+         */
+        inline const HeightPyramid &getHeights() {
+            return heights;
+        }
+
         mat4 getProjectionMatrix();
         mat4 getViewMatrix();
 
@@ -52,17 +93,9 @@ namespace pgp {
 
     private:
 
-        static inline float parametrizedNoise(float x, float y, float xPeriod, float yPeriod, float amplitude) {
-            return smoothNoise2D(x * xPeriod, y * yPeriod) * amplitude;
-        }
-
-        static float smoothNoise2D(float x, float y);
-
-        static float noise2D(int x, int y);
-
-        static float interpolateCos(float a, float b, float factor);
+        void swapTerrain();
 
-        void reloadTerrain();
+        static ITerrainSource *createSource(TerrainMode mode, ThreadPool *pool);
 
     };
 
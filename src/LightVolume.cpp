@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "LightVolume.hpp"
+
+#define COLUMNS_PER_JOB 16
+
+using namespace pgp;
+using namespace glm;
+
+LightVolume::LightVolume(float _voxelSize, float _voxelHeight) :
+    voxelSize(_voxelSize), voxelHeight(_voxelHeight), layer(CloudMarcher()), radius(0),
+    size(0), height(0), minColumn(0), valid(false) {
+}
+
+int LightVolume::update(const CloudMarcher &marcher, vec3 eyePosition, ThreadPool *pool) {
+    CloudNoiseSimd::Layer newLayer(marcher);
+
+    bool layerChanged = newLayer.lowerLayer != layer.lowerLayer || newLayer.upperLayer != layer.upperLayer
+            || newLayer.layerEase != layer.layerEase || newLayer.layerOffset != layer.layerOffset;
+
+    // Primary rays read brightness no further than the end of their march.
+    float newRadius = marcher.stepSize * marcher.stepCount + voxelSize;
+
+    if (!valid || layerChanged || sunPosition != marcher.sunPosition || radius != newRadius) {
+        layer = newLayer;
+        sunPosition = marcher.sunPosition;
+        radius = newRadius;
+
+        size = ivec2(int(ceilf(2 * radius / voxelSize)) + 1);
+        height = int(ceilf((layer.upperLayer - layer.lowerLayer) / voxelHeight)) + 1;
+        keys.assign(size.x * size.y, ivec2(0));
+        voxels.assign(size.x * height * size.y, 0);
+        valid = false;
+    }
+
+    minColumn = ivec2(int(floorf((eyePosition.x - radius) / voxelSize)), int(floorf((eyePosition.z - radius) / voxelSize)));
+
+    vector<std::pair<int, ivec2> > build;
+
+    for (int z = 0; z < size.y; z++) {
+        for (int x = 0; x < size.x; x++) {
+            int slot = z * size.x + x;
+            ivec2 column = minColumn + ivec2(wrap(x - minColumn.x, size.x), wrap(z - minColumn.y, size.y));
+
+            if (!valid || keys[slot] != column) {
+                build.push_back(std::make_pair(slot, column));
+            }
+        }
+    }
+
+    int jobCount = (build.size() + COLUMNS_PER_JOB - 1) / COLUMNS_PER_JOB;
+
+    auto job = [&](unsigned i) {
+        for (size_t j = i * COLUMNS_PER_JOB; j < std::min(build.size(), size_t(i + 1) * COLUMNS_PER_JOB); j++) {
+            buildColumn(build[j].second, build[j].first);
+        }
+    };
+
+    if (pool) {
+        pool->run(jobCount, job);
+    } else {
+        for (int i = 0; i < jobCount; i++) {
+            job(i);
+        }
+    }
+
+    valid = true;
+
+    return build.size();
+}
+
+void LightVolume::buildColumn(ivec2 column, int slot) {
+    // Sun rays of the whole column are marched together, one step of every
+    // ray still inside the slab per cloudMap batch.
+    vector<float> t(height), end(height), brightness(height, 1.0f), decrease(height, 0.45f);
+    vector<vec3> origins(height), directions(height);
+    vector<float> x(height), y(height), z(height), w(height), density(height);
+    vector<int> active(height);
+
+    for (int j = 0; j < height; j++) {
+        CloudMarcher::Ray r;
+        r.origin = vec3(column.x * voxelSize, layer.lowerLayer + j * voxelHeight, column.y * voxelSize);
+        r.direction = normalize(sunPosition - r.origin);
+
+        origins[j] = r.origin;
+        directions[j] = r.direction;
+        t[j] = std::max(0.0f, CloudMarcher::distanceToLayer(r, layer.lowerLayer));
+        end[j] = CloudMarcher::distanceToLayer(r, layer.upperLayer);
+    }
+
+    for (;;) {
+        int count = 0;
+
+        for (int j = 0; j < height; j++) {
+            if (t[j] < end[j]) {
+                vec3 p = origins[j] + directions[j] * t[j];
+                x[count] = p.x;
+                y[count] = p.y;
+                z[count] = p.z;
+                w[count] = t[j];
+                active[count++] = j;
+            }
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        CloudNoiseSimd::cloudMap(layer, &x[0], &y[0], &z[0], &w[0], &density[0], count);
+
+        for (int i = 0; i < count; i++) {
+            int j = active[i];
+            brightness[j] -= decrease[j] * density[i];
+            decrease[j] *= 0.95f;
+            t[j] += 1.0f;
+        }
+    }
+
+    int sx = slot % size.x;
+    int sz = slot / size.x;
+
+    for (int j = 0; j < height; j++) {
+        voxels[(sz * height + j) * size.x + sx] = brightness[j];
+    }
+
+    keys[slot] = column;
+}
+
+bool LightVolume::sample(vec3 p, float &brightness) const {
+    if (!valid) {
+        return false;
+    }
+
+    float fx = p.x / voxelSize;
+    float fy = (p.y - layer.lowerLayer) / voxelHeight;
+    float fz = p.z / voxelSize;
+
+    // Negated test also rejects NaN.
+    if (!(fx >= minColumn.x && fz >= minColumn.y && fy >= 0
+            && fx <= minColumn.x + size.x - 1 && fz <= minColumn.y + size.y - 1 && fy <= height - 1)) {
+        return false;
+    }
+
+    int x0 = int(floorf(fx)), y0 = std::min(int(fy), height - 2), z0 = int(floorf(fz));
+    float rx = fx - x0, ry = fy - y0, rz = fz - z0;
+
+    int xs[] = {wrap(x0, size.x), wrap(x0 + 1, size.x)};
+    int zs[] = {wrap(z0, size.y), wrap(z0 + 1, size.y)};
+
+    float planes[2];
+    for (int k = 0; k < 2; k++) {
+        const float *lower = &voxels[(zs[k] * height + y0) * size.x];
+        const float *upper = lower + size.x;
+
+        float a = lower[xs[0]] + (lower[xs[1]] - lower[xs[0]]) * rx;
+        float b = upper[xs[0]] + (upper[xs[1]] - upper[xs[0]]) * rx;
+
+        planes[k] = a + (b - a) * ry;
+    }
+
+    brightness = planes[0] + (planes[1] - planes[0]) * rz;
+
+    return true;
+}
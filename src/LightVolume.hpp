@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "CloudMarcher.hpp"
+#include "CloudNoiseSimd.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::ivec2;
+    using glm::ivec3;
+    using glm::vec2;
+    using glm::vec3;
+
+    /**
+     * Result of CloudMarcher::marchBrightness on a lattice over the cloud
+     * slab, so primary rays read sun transmittance by one trilinear lookup.
+     *
+     * marchBrightness passes distance along the sun ray as field time, so
+     * its result depends only on the point and the sun position, not on the
+     * frame time. Columns are kept in a ring buffer around the eye like in
+     * OccupancyGrid, update() builds only columns entering the region and
+     * rebuilds everything when the sun or layer parameters change.
+     */
+    class LightVolume {
+    private:
+        float voxelSize;
+        float voxelHeight;
+
+        CloudNoiseSimd::Layer layer;
+        vec3 sunPosition;
+        float radius;
+
+        ivec2 size;
+        int height;
+        ivec2 minColumn;
+        // Lattice column held by each slot.
+        vector<ivec2> keys;
+        // x fastest, then height, then z.
+        vector<float> voxels;
+        bool valid;
+
+    public:
+        LightVolume(float voxelSize = 8.0, float voxelHeight = 5.0);
+
+        /**
+         * Brings the volume to given eye position. Returns the number of
+         * built columns.
+         */
+        int update(const CloudMarcher &marcher, vec3 eyePosition, ThreadPool *pool = NULL);
+
+        /**
+         * Interpolated brightness at p. Returns false outside of the volume.
+         */
+        bool sample(vec3 p, float &brightness) const;
+
+        inline const vector<float> &getVoxels() const {
+            return voxels;
+        }
+
+        /**
+         * Lattice points in x, height and z. Point x, y, z is stored at
+         * x mod size.x, y, z mod size.z.
+         */
+        inline ivec3 getSize() const {
+            return ivec3(size.x, height, size.y);
+        }
+
+        /**
+         * First lattice column of the region.
+         */
+        inline ivec2 getMinColumn() const {
+            return minColumn;
+        }
+
+        /**
+         * Horizontal and vertical lattice spacing, height starts at the lower
+         * layer.
+         */
+        inline vec2 getVoxelSize() const {
+            return vec2(voxelSize, voxelHeight);
+        }
+
+        inline size_t getMemorySize() const {
+            return voxels.size() * sizeof (float);
+        }
+
+    private:
+        void buildColumn(ivec2 column, int slot);
+
+        static inline int wrap(int x, int size) {
+            x %= size;
+            return x < 0 ? x + size : x;
+        }
+    };
+
+}
@@ -1,5 +1,9 @@
+#include <chrono>
+#include <climits>
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
 
 #include "Main.hpp"
 #include "Exceptions.hpp"
@@ -7,6 +11,12 @@
 using namespace std;
 using namespace pgp;
 
+#define HEADLESS_FPS 60
+// Seconds between profiler reports.
+#define REPORT_INTERVAL 5.0f
+// Ticks per second of the simulation thread.
+#define SIMULATION_RATE 60
+
 Main program;
 
 void sigintHandler(int signal) {
@@ -16,6 +26,94 @@ void sigintHandler(int signal) {
 int main(int argc, char **argv) {
     signal(SIGINT, sigintHandler);
 
+    bool headless = false;
+    bool threaded = false;
+    // Headless replay runs the whole recording unless --frames is given.
+    int frames = 0;
+    glm::ivec2 size(1200, 800);
+    string output, cameraScript, record, replay;
+    int downscale = 4;
+    CloudUpsample::Mode upsample = CloudUpsample::UPSAMPLE_BILATERAL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            program.setThreadCount(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && strcmp(argv[i + 1], "chunks") == 0) {
+            program.setTerrainMode(Landscape::TERRAIN_CHUNKS);
+            i++;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && strcmp(argv[i + 1], "ring") == 0) {
+            program.setTerrainMode(Landscape::TERRAIN_RING);
+            i++;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && strcmp(argv[i + 1], "clipmap") == 0) {
+            program.setTerrainMode(Landscape::TERRAIN_CLIPMAP);
+            i++;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc
+                && MarchPolicy::parseStepMode(argv[i + 1], program.getMarchPolicy().stepMode)) {
+            i++;
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0
+                && (atoi(argv[i + 1]) & (atoi(argv[i + 1]) - 1)) == 0) {
+            program.setReprojectPattern(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            program.getMarchPolicy().minTransmittance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            downscale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cloud-budget") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            program.setCloudBudget(atof(argv[++i]));
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc && CloudUpsample::parseMode(argv[i + 1], upsample)) {
+            i++;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc && atoi(argv[i + 1]) > 0 && atoi(argv[i + 2]) > 0) {
+            size.x = atoi(argv[++i]);
+            size.y = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--camera") == 0 && i + 1 < argc) {
+            cameraScript = argv[++i];
+        } else if (strcmp(argv[i], "--sim-thread") == 0) {
+            threaded = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            program.setProfileFile(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [-j THREADS] [-m chunks|ring|clipmap]"
+                    << " [-p fixed|distance|adaptive] [-x MIN_TRANSMITTANCE] [-a 1|2|4]" << endl
+                    << "    [-d DOWNSCALE] [-u bilinear|bilateral] [--cloud-budget MS] [--sim-thread] [--profile TRACE.json|TRACE.csv]" << endl
+                    << "    [--headless [--frames N] [--size W H] [--output DIR] [--camera FILE]]" << endl
+                    << "    [--record INPUT | --replay INPUT]" << endl;
+            return 1;
+        }
+    }
+
+    // Recording and replay step frames by their own clock, the simulation
+    // thread follows the wall clock.
+    if ((!record.empty() || !replay.empty()) && threaded) {
+        cerr << "Input recording and replay do not work with --sim-thread." << endl;
+        return 1;
+    } else if (!record.empty() && (headless || !replay.empty())) {
+        cerr << "Input can be recorded only from the window." << endl;
+        return 1;
+    }
+
+    program.setSimulationThread(threaded);
+    program.setRecordFile(record);
+    program.setReplayFile(replay);
+
+    if (frames == 0) {
+        frames = replay.empty() ? 480 : INT_MAX;
+    }
+
+    program.setCloudResolution(downscale, upsample);
+
+    if (headless) {
+        program.setHeadless(frames, size, output, cameraScript);
+    }
+
     try {
         program.init();
 
@@ -42,66 +140,103 @@ void glDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLs
     }
 }
 
-Main::Main() : sdlWindow(NULL), context(NULL), camera(NULL), landscape(NULL) {
+Main::Main() : sdlWindow(NULL), context(NULL), camera(NULL), landscape(NULL), clouds(NULL),
+    headlessContext(NULL), cameraScript(NULL), simulation(NULL), simulationCamera(NULL),
+    recorder(NULL), replay(NULL) {
 }
 
 Main::~Main() {
+    delete simulation;
+    delete simulationCamera;
     delete landscape;
     delete camera;
     delete clouds;
+    delete cameraScript;
+    delete headlessContext;
+    delete recorder;
+    delete replay;
 }
 
 void Main::run() {
+    if (headless) {
+        runHeadless();
+        return;
+    }
+
     uint32_t ticks = SDL_GetTicks();
     uint32_t initTicks = ticks;
     uint32_t lastFrameTicks = ticks;
     float dt = 1e-10;
     float t = 0.0;
     float ft = t;
-    unsigned int frameCounter = 0;
+
+    if (simulation) {
+        simulation->start();
+    }
 
     while (!quitFlag) {
+        FrameProfiler::Scope frame(*profiler, frameStage);
+
         SDL_Event evt;
         while (SDL_PollEvent(&evt)) {
-            int processed = 0;
-            IEventListener::EventResponse r;
-            for (IEventListener *listener : eventListenerList) {
-                r = listener->onEvent(&evt);
-
-                switch (r) {
-                    case IEventListener::EVT_IGNORED:
-                        break;
-                    case IEventListener::EVT_PROCESSED:
-                        processed++;
-                        break;
-                    case IEventListener::EVT_DROPPED:
-                        goto drop;
+            if (replay && InputRecording::isInput(evt)) {
+                // Recording stands in for user input, which can only quit.
+                onEvent(&evt);
+            } else {
+                if (simulation) {
+                    simulation->postEvent(evt);
+                }
+
+                if (recorder) {
+                    recorder->addEvent(evt);
                 }
+
+                dispatchEvent(&evt);
             }
-drop:
+
             if (quitFlag) {
                 goto quit;
             }
         }
 
+        if (replay && !replayFrame(t, dt)) {
+            cout << "Replayed " << replay->getFrameCount() << " frames" << endl;
+            goto quit;
+        }
+
+        if (quitFlag) {
+            goto quit;
+        }
+
+        if (simulation) {
+            applySnapshot(t, dt);
+        }
+
+        if (recorder) {
+            recorder->endFrame(t, dt);
+        }
+
         runProcessors(t, dt);
 
         runRenderers();
 
         SDL_GL_SwapWindow(sdlWindow);
 
-        frameCounter++;
-
         ticks = SDL_GetTicks();
         // cout << "Ticks: " << ticks << endl;
-        t = (ticks - initTicks)/1000.0f;
-        dt = (ticks - lastFrameTicks)/1000.0f;
+        if (!simulation && !replay) {
+            t = (ticks - initTicks)/1000.0f;
+            dt = (ticks - lastFrameTicks)/1000.0f;
+        }
         // cout << "DT: " << dt << endl;
         lastFrameTicks = ticks;
 
-        if(frameCounter > 60) {
-            cout << "FPS: " << (frameCounter/(t-ft)) << endl;
-            frameCounter = 0;
+        if (t - ft > REPORT_INTERVAL) {
+            const TerrainStats &stats = landscape->getTerrainStats();
+
+            profiler->report(cout);
+            cout << "Terrain: " << (stats.getHitRate() * 100) << " % reused, "
+                    << stats.getAverageReloadTime() << " ms per reload" << endl;
             ft = t;
         }
 
@@ -112,6 +247,27 @@ quit:
 }
 
 void Main::init() {
+    if (!replayFile.empty()) {
+        replay = new InputReplay();
+        replay->load(replayFile);
+
+        cout << "Replaying " << replay->getFrameCount() << " frames of '" << replayFile << "'" << endl;
+    }
+
+    if (!recordFile.empty()) {
+        recorder = new InputRecorder(recordFile);
+    }
+
+    if (headless) {
+        initHeadless();
+    } else {
+        initWindow();
+    }
+
+    initScene();
+}
+
+void Main::initWindow() {
     if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
         throw string("SDL_Init failed.");
     }
@@ -142,27 +298,220 @@ void Main::init() {
     glDebugMessageCallback((GLDEBUGPROC) glDebugCallback, NULL);
 
     camera = new Camera(sdlWindow);
-    landscape = new Landscape(camera);
-    clouds = new Clouds(camera, landscape);
+}
+
+void Main::initHeadless() {
+    headlessContext = new HeadlessContext(headlessSize);
+
+    cout << "Headless context: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << endl;
+
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+
+    glDebugMessageCallback((GLDEBUGPROC) glDebugCallback, NULL);
+
+    camera = new Camera(headlessSize);
+}
+
+void Main::initScene() {
+    frameStage = profiler->addStage("frame");
+    enableGpuTiming();
+
+    landscape = new Landscape(camera, threadCount, terrainMode);
+    clouds = new Clouds(camera, landscape, marchPolicy, reprojectPattern, cloudDownscale, upsampleMode);
+
+    if (headlessContext) {
+        clouds->setOutputFramebuffer(headlessContext->getFramebuffer());
+    }
+
+    clouds->setProfiler(profiler);
+
+    if (cloudBudget > 0) {
+        clouds->setMarchBudget(cloudBudget);
+    }
 
     registerEventListener(this);
 
     registerEventListener(camera);
-    registerProcessor(camera);
 
-    autoregister(landscape);
-    autoregister(clouds);
+    // Camera is moved by processors of the simulation thread when there is
+    // one, renderers then see the pose published by it.
+    Camera *movingCamera = camera;
+    RegistrablesContainer *container = this;
+
+    if (threadedSimulation) {
+        simulationCamera = new Camera(camera->getWindowSize());
+        simulation = new SimulationThread(simulationCamera, 1.0f / SIMULATION_RATE, profiler);
+        simulation->registerEventListener(simulationCamera);
+
+        movingCamera = simulationCamera;
+        container = simulation;
+    }
+
+    // Replayed input moves the camera instead of the script.
+    if (headless && !replay) {
+        cameraScript = new CameraScript(movingCamera);
+
+        if (!cameraScriptFile.empty()) {
+            cameraScript->load(cameraScriptFile);
+        }
+
+        // Script sets the pose before camera moves by (absent) input.
+        container->registerProcessor(cameraScript, ProcessorAccess({}, {movingCamera}));
+    }
+
+    container->registerProcessor(movingCamera, ProcessorAccess({}, {}));
+
+    // Landscape requests terrain around the camera, clouds only keep time.
+    autoregister(landscape, ProcessorAccess({camera}, {}));
+    autoregister(clouds, ProcessorAccess({}, {}));
+}
+
+void Main::applySnapshot(float &time, float &delta) {
+    SimulationSnapshot s = simulation->getSnapshot();
+
+    camera->setPose(s.position, s.rotation);
+    delta = s.time - time;
+    time = s.time;
+}
+
+void Main::runHeadless() {
+    double renderMs = 0;
+    float t = 0, dt = 0;
+    int frame;
+
+    if (simulation) {
+        simulation->start();
+    }
+
+    for (frame = 0; frame < headlessFrames && !quitFlag; frame++) {
+        if (replay) {
+            if (!replayFrame(t, dt) || quitFlag) {
+                break;
+            }
+        } else if (simulation) {
+            applySnapshot(t, dt);
+        } else {
+            dt = 1.0f / HEADLESS_FPS;
+            t = frame * dt;
+        }
+
+        auto start = chrono::steady_clock::now();
+
+        {
+            FrameProfiler::Scope scope(*profiler, frameStage);
+
+            runProcessors(t, dt);
+
+            runRenderers();
+
+            // Count the frame only once the GPU is done with it.
+            glFinish();
+        }
+
+        renderMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        if (!outputDirectory.empty()) {
+            char name[32];
+            snprintf(name, sizeof (name), "/frame%05d.ppm", frame);
+            headlessContext->writePPM(outputDirectory + name);
+        }
+    }
+
+    const TerrainStats &stats = landscape->getTerrainStats();
+
+    cout << "Rendered " << frame << " frames " << headlessSize.x << "x" << headlessSize.y
+            << " in " << renderMs << " ms, " << renderMs / frame << " ms per frame, "
+            << frame * 1000.0 / renderMs << " FPS" << endl;
+    cout << "Terrain: " << (stats.getHitRate() * 100) << " % reused, "
+            << stats.getAverageReloadTime() << " ms per reload" << endl;
+
+    if (simulation) {
+        cout << "Simulation: " << simulation->getTickCount() << " ticks in " << t << " s, "
+                << simulation->getSkippedTicks() << " skipped" << endl;
+    }
+
+    profiler->report(cout);
+
+    onQuit();
+}
+
+void Main::dispatchEvent(SDL_Event *evt) {
+    for (IEventListener *listener : eventListenerList) {
+        if (listener->onEvent(evt) == IEventListener::EVT_DROPPED) {
+            return;
+        }
+    }
+}
+
+bool Main::replayFrame(float &time, float &delta) {
+    InputFrame frame;
+
+    if (!replay->nextFrame(frame)) {
+        return false;
+    }
+
+    for (SDL_Event &evt : frame.events) {
+        dispatchEvent(&evt);
+    }
+
+    time = frame.time;
+    delta = frame.delta;
+
+    return true;
 }
 
 void Main::onQuit() {
+    if (!profileFile.empty()) {
+        profiler->write(profileFile);
+        cout << "Profile written to " << profileFile << endl;
+    }
+
+    if (recorder) {
+        cout << "Recorded " << recorder->getFrameCount() << " frames of input to '" << recordFile << "'" << endl;
+
+        delete recorder;
+        recorder = NULL;
+    }
+
+    // Queries belong to the context destroyed below.
+    disableGpuTiming();
+
+    // Stops the thread before the objects it uses go away. A tick failed
+    // after the last snapshot is only rethrown here.
+    if (simulation) {
+        try {
+            simulation->stop();
+        } catch (string &str) {
+            cerr << "Simulation failed: " << str << endl;
+        } catch (Exception &e) {
+            cerr << "Simulation failed: " << e.getMessage() << endl;
+        }
+    }
+
+    delete simulation;
+    delete simulationCamera;
+    simulation = NULL;
+    simulationCamera = NULL;
 
     delete landscape;
     delete camera;
     delete clouds;
+    delete cameraScript;
 
     landscape = NULL;
     camera = NULL;
     clouds = NULL;
+    cameraScript = NULL;
+
+    if (headlessContext) {
+        delete headlessContext;
+        headlessContext = NULL;
+        return;
+    }
 
     SDL_DestroyWindow(sdlWindow);
     SDL_GL_DeleteContext(context);
@@ -9,6 +9,10 @@
 #include "Camera.hpp"
 #include "Landscape.hpp"
 #include "Clouds.hpp"
+#include "HeadlessContext.hpp"
+#include "CameraScript.hpp"
+#include "SimulationThread.hpp"
+#include "InputRecording.hpp"
 
 namespace pgp {
 
@@ -17,10 +21,40 @@ namespace pgp {
         SDL_Window *sdlWindow;
         SDL_GLContext context;
         bool quitFlag = false;
+        unsigned threadCount = 0;
+        Landscape::TerrainMode terrainMode = Landscape::TERRAIN_CHUNKS;
+        MarchPolicy marchPolicy;
+        int reprojectPattern = 1;
+        int cloudDownscale = 4;
+        CloudUpsample::Mode upsampleMode = CloudUpsample::UPSAMPLE_BILATERAL;
+        // GPU ms of the cloud march, 0 keeps the downscale fixed.
+        float cloudBudget = 0;
         Camera *camera;
         Landscape *landscape;
         Clouds *clouds;
 
+        // Headless run, see setHeadless().
+        bool headless = false;
+        ivec2 headlessSize = ivec2(1200, 800);
+        int headlessFrames = 480;
+        string outputDirectory;
+        string cameraScriptFile;
+        HeadlessContext *headlessContext;
+        CameraScript *cameraScript;
+
+        int frameStage;
+        string profileFile;
+
+        // See setSimulationThread().
+        bool threadedSimulation = false;
+        SimulationThread *simulation;
+        Camera *simulationCamera;
+
+        // See setRecordFile() and setReplayFile().
+        string recordFile, replayFile;
+        InputRecorder *recorder;
+        InputReplay *replay;
+
     public:
         Main();
         ~Main();
@@ -28,13 +62,126 @@ namespace pgp {
         void init();
         void onQuit();
 
+        /**
+         * Renders given number of frames into an offscreen context instead of
+         * a window. Camera follows the script and time advances by a fixed
+         * step of 60 FPS. Frames are written to output directory as PPM when
+         * it is not empty.
+         */
+        inline void setHeadless(int frames, ivec2 size, const string &output, const string &cameraScript) {
+            headless = true;
+            headlessFrames = frames;
+            headlessSize = size;
+            outputDirectory = output;
+            cameraScriptFile = cameraScript;
+        }
+
+        /**
+         * Profile of the run is written there on quit, as CSV when the name
+         * ends with .csv, otherwise as Chrome trace.
+         */
+        inline void setProfileFile(const string &filename) {
+            profileFile = filename;
+        }
+
+        /**
+         * Moves the camera on a separate thread with fixed time step, frames
+         * show the pose interpolated between its last two ticks.
+         */
+        inline void setSimulationThread(bool enabled) {
+            threadedSimulation = enabled;
+        }
+
+        /**
+         * Input events and the clock of every frame are recorded to file, see
+         * InputRecording.
+         */
+        inline void setRecordFile(const string &filename) {
+            recordFile = filename;
+        }
+
+        /**
+         * Recorded input and clock drive the frames instead of the user and
+         * the wall clock, the run ends with the recording. Headless runs
+         * replay it instead of the camera script.
+         */
+        inline void setReplayFile(const string &filename) {
+            replayFile = filename;
+        }
+
         inline void quit() {
             quitFlag = true;
         };
 
+        /**
+         * Worker threads used for terrain generation, 0 means all cores.
+         */
+        inline void setThreadCount(unsigned count) {
+            threadCount = count;
+        }
+
+        inline void setTerrainMode(Landscape::TerrainMode mode) {
+            terrainMode = mode;
+        }
+
+        /**
+         * Step policy of the cloud march, has to be set before init().
+         */
+        inline MarchPolicy &getMarchPolicy() {
+            return marchPolicy;
+        }
+
+        /**
+         * Clouds march one of pattern * pattern pixels per frame and
+         * reproject the rest, pattern is a power of two.
+         */
+        inline void setReprojectPattern(int pattern) {
+            reprojectPattern = pattern;
+        }
+
+        /**
+         * Clouds are marched at 1 / downscale of the screen size and
+         * upsampled by mode.
+         */
+        inline void setCloudResolution(int downscale, CloudUpsample::Mode mode) {
+            cloudDownscale = downscale;
+            upsampleMode = mode;
+        }
+
+        /**
+         * Downscale starts at the one set above and then adapts so the cloud
+         * march takes about budget ms on GPU.
+         */
+        inline void setCloudBudget(float budget) {
+            cloudBudget = budget;
+        }
+
         // Event listener interface
         virtual IEventListener::EventResponse onEvent(SDL_Event* evt);
 
+    private:
+        void initWindow();
+        void initHeadless();
+        void initScene();
+
+        void runHeadless();
+
+        /**
+         * Passes event to the listeners until one drops it.
+         */
+        void dispatchEvent(SDL_Event *evt);
+
+        /**
+         * Dispatches events of the next recorded frame and sets its clock,
+         * false when the recording is over.
+         */
+        bool replayFrame(float &time, float &delta);
+
+        /**
+         * Moves render camera to the current simulation snapshot.
+         */
+        void applySnapshot(float &time, float &delta);
+
     };
 }
 
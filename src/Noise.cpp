@@ -0,0 +1,142 @@
+#include <sstream>
+
+#include "Noise.hpp"
+
+using namespace pgp;
+using std::ostringstream;
+
+constexpr int NoiseLattice<1>::MULTIPLIERS[1];
+constexpr int NoiseLattice<1>::OFFSETS[1];
+constexpr int NoiseLattice<1>::CORNERS[2];
+constexpr int NoiseLattice<2>::MULTIPLIERS[2];
+constexpr int NoiseLattice<2>::OFFSETS[2];
+constexpr int NoiseLattice<2>::CORNERS[4];
+constexpr int NoiseLattice<3>::MULTIPLIERS[3];
+constexpr int NoiseLattice<3>::OFFSETS[3];
+constexpr int NoiseLattice<3>::CORNERS[8];
+constexpr int NoiseLattice<4>::MULTIPLIERS[4];
+constexpr int NoiseLattice<4>::OFFSETS[4];
+constexpr int NoiseLattice<4>::CORNERS[16];
+
+static_assert(Noise<1>::checkCorners(), "Corner table of 1D noise does not match its multipliers.");
+static_assert(Noise<2>::checkCorners(), "Corner table of 2D noise does not match its multipliers.");
+static_assert(Noise<3>::checkCorners(), "Corner table of 3D noise does not match its multipliers.");
+static_assert(Noise<4>::checkCorners(), "Corner table of 4D noise does not match its multipliers.");
+
+namespace {
+
+    const char *FLOAT_TYPES[] = { "float", "vec2", "vec3", "vec4" };
+    const char *INT_TYPES[] = { "int", "ivec2", "ivec3", "ivec4" };
+    const char COMPONENTS[] = "xyzw";
+
+    /**
+     * Adds or subtracts v as an unsigned literal.
+     */
+    string addUint(int v) {
+        return (v < 0 ? " - " : " + ") + std::to_string(v < 0 ? -int64_t(v) : v) + "u";
+    }
+
+    string component(const string &name, int dim, int axis) {
+        return dim == 1 ? name : name + "." + COMPONENTS[axis];
+    }
+
+    template<int Dim>
+    void generateCellKey(ostringstream &out) {
+        typedef typename Noise<Dim>::Lattice Lattice;
+
+        out << "uint cellKey(" << INT_TYPES[Dim - 1] << " q) {\n";
+        out << "  uint key = 0u;\n";
+
+        for (int i = 0; i < Dim; i++) {
+            int multiplier = Lattice::MULTIPLIERS[i];
+
+            out << "  key += uint(" << component("q", Dim, i) << ")";
+            if (multiplier != 1) {
+                out << " * " << (multiplier < 0 ? "uint(" + std::to_string(multiplier) + ")" : std::to_string(multiplier) + "u");
+            }
+            if (Lattice::OFFSETS[i] != 0) {
+                out << addUint(Lattice::OFFSETS[i]);
+            }
+            out << ";\n";
+        }
+
+        out << "  return key;\n";
+        out << "}\n\n";
+
+        out << "float hash(" << INT_TYPES[Dim - 1] << " q) {\n";
+        out << "  return hash(cellKey(q));\n";
+        out << "}\n\n";
+    }
+
+    template<int Dim>
+    void generateNoise(ostringstream &out) {
+        const char *floatType = FLOAT_TYPES[Dim - 1];
+        const char *intType = INT_TYPES[Dim - 1];
+
+        out << "float noise(" << floatType << " q) {\n";
+        out << "  " << intType << " q0 = " << intType << "(floor(q));\n";
+        out << "  " << floatType << " r = q - " << floatType << "(q0);\n";
+        out << "  uint key = cellKey(q0);\n\n";
+
+        for (int c = 0; c < Noise<Dim>::CORNER_COUNT; c++) {
+            int offset = Noise<Dim>::Lattice::CORNERS[c];
+
+            out << "  float c" << c << " = hash(key" << (offset ? addUint(offset) : "") << ");\n";
+        }
+
+        int count = Noise<Dim>::CORNER_COUNT;
+
+        for (int axis = 0; axis < Dim; axis++) {
+            count /= 2;
+
+            out << "\n  " << (axis == 0 ? "float " : "") << "f = mixFactor(" << component("r", Dim, axis) << ");\n";
+
+            for (int i = 0; i < count; i++) {
+                out << "  c" << i << " = mix(c" << 2 * i << ", c" << 2 * i + 1 << ", f);\n";
+            }
+        }
+
+        out << "\n  return c0;\n";
+        out << "}\n\n";
+    }
+
+}
+
+string NoiseBase::generateGlsl() {
+    ostringstream out;
+
+    out << "// Generated from src/Noise.hpp by bin/noise-glsl, do not edit.\n";
+    out << "// Hash and value noise used by clouds.comp, the same as Noise on CPU.\n";
+    out << "// Expects PI and UINT_MAX to be defined.\n\n";
+
+    out << "float hash(uint key) {\n";
+    out << "  key = key * key + " << KEY_OFFSET << "u;\n";
+    out << "  uint n = key * " << KEY_MULTIPLIER << "u;\n\n";
+    out << "  return ((((n * " << MIX_MULTIPLIER << "u + " << MIX_OFFSET << "u) & 0x" << std::hex << MIX_MASK << std::dec
+        << "u) - " << MIX_SUBTRAHEND << "u) * " << MIX_FACTOR << "u * n) / float(UINT_MAX);\n";
+    out << "}\n\n";
+
+    out << "float mixFactor(float a) {\n";
+    out << "  return (1 - cos(a * PI)) * 0.5;\n";
+    out << "}\n\n";
+
+    out << "float mixCos(float x, float y, float a) {\n";
+    out << "  return mix(x, y, mixFactor(a));\n";
+    out << "}\n\n";
+
+    generateCellKey<1>(out);
+    generateCellKey<2>(out);
+    generateCellKey<3>(out);
+    generateCellKey<4>(out);
+
+    generateNoise<1>(out);
+    generateNoise<2>(out);
+    generateNoise<3>(out);
+    generateNoise<4>(out);
+
+    string glsl = out.str();
+    // No blank line at the end of file.
+    glsl.pop_back();
+
+    return glsl;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace pgp {
+
+    using std::string;
+
+    /**
+     * Hash coefficients of the noise lattice. Cell q has key
+     * sum q[i] * MULTIPLIERS[i] + OFFSETS[i] with wrapping arithmetic.
+     *
+     * The key is linear in q, so corner c of a cell, at q0 + 1 along axis i
+     * when bit i of c is set, has the key of the base corner q0 plus
+     * CORNERS[c], the sum of multipliers of its set bits.
+     */
+    template<int Dim>
+    struct NoiseLattice;
+
+    template<>
+    struct NoiseLattice<1> {
+        static constexpr int MULTIPLIERS[1] = { 1 };
+        static constexpr int OFFSETS[1] = { 0 };
+        static constexpr int CORNERS[2] = { 0, 1 };
+    };
+
+    template<>
+    struct NoiseLattice<2> {
+        static constexpr int MULTIPLIERS[2] = { 79, 317 };
+        static constexpr int OFFSETS[2] = { 74344645, -6324441 };
+        static constexpr int CORNERS[4] = { 0, 79, 317, 396 };
+    };
+
+    template<>
+    struct NoiseLattice<3> {
+        static constexpr int MULTIPLIERS[3] = { 7779, 312217, 124547 };
+        static constexpr int OFFSETS[3] = { 764343, -63654641, 9963 };
+        static constexpr int CORNERS[8] = {
+            0, 7779, 312217, 319996,
+            124547, 132326, 436764, 444543,
+        };
+    };
+
+    template<>
+    struct NoiseLattice<4> {
+        static constexpr int MULTIPLIERS[4] = { 79, 317, 1247, -436 };
+        static constexpr int OFFSETS[4] = { 743, -631, 9963, -25 };
+        static constexpr int CORNERS[16] = {
+            0, 79, 317, 396,
+            1247, 1326, 1564, 1643,
+            -436, -357, -119, -40,
+            811, 890, 1128, 1207,
+        };
+    };
+
+    /**
+     * Parts of the noise that do not depend on the dimension.
+     */
+    class NoiseBase {
+    public:
+        static constexpr float PI = 3.141592653589793f;
+
+        // Constants of hash(), emitted into the shader as they are.
+        static constexpr uint32_t KEY_OFFSET = 77433u;
+        static constexpr uint32_t KEY_MULTIPLIER = 37u;
+        static constexpr uint32_t MIX_MULTIPLIER = 3342687u;
+        static constexpr uint32_t MIX_OFFSET = 1144763u;
+        static constexpr uint32_t MIX_MASK = 0xf2fcf7ddu;
+        static constexpr uint32_t MIX_SUBTRAHEND = 77663544u;
+        static constexpr uint32_t MIX_FACTOR = uint32_t(-113);
+
+        /**
+         * Scrambles n into [0, 1], also used by the terrain with its own
+         * lattice keys.
+         */
+        static inline float scramble(uint32_t n) {
+            return ((((n * MIX_MULTIPLIER + MIX_OFFSET) & MIX_MASK) - MIX_SUBTRAHEND) * MIX_FACTOR * n) / float(UINT32_MAX);
+        }
+
+        static inline float hash(uint32_t key) {
+            key = key * key + KEY_OFFSET;
+
+            return scramble(key * KEY_MULTIPLIER);
+        }
+
+        /**
+         * Cosine interpolation weight of y for a in [0, 1].
+         */
+        static inline float mixFactor(float a) {
+            return (1 - cosf(a * PI)) * 0.5f;
+        }
+
+        static inline float mix(float x, float y, float factor) {
+            return x * (1 - factor) + y * factor;
+        }
+
+        static inline float mixCos(float x, float y, float a) {
+            return mix(x, y, mixFactor(a));
+        }
+
+        /**
+         * GLSL of hash, cell keys and noise of one to four dimensions,
+         * written to shaders/noise.glsl by bin/noise-glsl. Expects PI and
+         * UINT_MAX to be defined.
+         */
+        static string generateGlsl();
+    };
+
+    /**
+     * Value noise on the integer lattice of Dim dimensions with cosine
+     * interpolation. Single source of the noise of CloudNoise, the terrain
+     * interpolation and, through NoiseBase::generateGlsl(), of clouds.comp.
+     *
+     * Only the base corner of a cell needs the multiplications of its key,
+     * the other corners add NoiseLattice::CORNERS. Corners are reduced along
+     * x first, then y and so on, the shader does the same in the same order.
+     */
+    template<int Dim>
+    class Noise : public NoiseBase {
+    public:
+        typedef NoiseLattice<Dim> Lattice;
+
+        static constexpr int CORNER_COUNT = 1 << Dim;
+
+        /**
+         * Key of corner c minus key of the base corner, computed from the
+         * multipliers to check the table.
+         */
+        static constexpr int cornerOffset(int c, int axis = 0) {
+            return axis == Dim ? 0 : ((c >> axis) & 1) * Lattice::MULTIPLIERS[axis] + cornerOffset(c, axis + 1);
+        }
+
+        static constexpr bool checkCorners(int c = 0) {
+            return c == CORNER_COUNT || (Lattice::CORNERS[c] == cornerOffset(c) && checkCorners(c + 1));
+        }
+
+        static inline uint32_t cellKey(const int *cell) {
+            uint32_t key = 0;
+
+            for (int i = 0; i < Dim; i++) {
+                key += uint32_t(cell[i]) * uint32_t(Lattice::MULTIPLIERS[i]) + uint32_t(Lattice::OFFSETS[i]);
+            }
+
+            return key;
+        }
+
+        static inline float hash(const int *cell) {
+            return NoiseBase::hash(cellKey(cell));
+        }
+
+        static inline float noise(const float *q) {
+            int cell[Dim];
+            float r[Dim];
+
+            for (int i = 0; i < Dim; i++) {
+                cell[i] = floorf(q[i]);
+                r[i] = q[i] - float(cell[i]);
+            }
+
+            uint32_t key = cellKey(cell);
+            float values[CORNER_COUNT];
+
+            for (int c = 0; c < CORNER_COUNT; c++) {
+                values[c] = NoiseBase::hash(key + uint32_t(Lattice::CORNERS[c]));
+            }
+
+            return interpolate(values, r);
+        }
+
+        /**
+         * Cosine interpolation of values at the corners of a cell, indexed
+         * as corners above, at position r inside of it. Overwrites values.
+         */
+        static inline float interpolate(float *values, const float *r) {
+            int count = CORNER_COUNT;
+
+            for (int axis = 0; axis < Dim; axis++) {
+                float factor = mixFactor(r[axis]);
+                count /= 2;
+
+                for (int i = 0; i < count; i++) {
+                    values[i] = mix(values[2 * i], values[2 * i + 1], factor);
+                }
+            }
+
+            return values[0];
+        }
+    };
+
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "CloudMarcher.hpp"
+#include "CloudNoiseSimd.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Microbenchmark of batched noise(vec4) and cloudMap kernels.
+ *
+ * Prints samples per second of each instruction set supported by the CPU
+ * and the largest difference from the scalar path. Exits with non-zero code
+ * when the difference exceeds CloudNoiseSimd::TOLERANCE.
+ */
+
+#define BATCH_SIZE 4096
+#define MIN_SECONDS 0.5
+
+struct Points {
+    vector<float> x, y, z, w;
+
+    Points(size_t count) : x(count), y(count), z(count), w(count) {
+        mt19937 rng(1103);
+        uniform_real_distribution<float> horizontal(-1000.0f, 1000.0f);
+        uniform_real_distribution<float> vertical(75.0f, 175.0f);
+        uniform_real_distribution<float> time(0.0f, 50.0f);
+
+        for (size_t i = 0; i < count; i++) {
+            x[i] = horizontal(rng);
+            y[i] = vertical(rng);
+            z[i] = horizontal(rng);
+            w[i] = time(rng);
+        }
+    }
+};
+
+template<typename Kernel>
+static double measure(Kernel kernel) {
+    typedef chrono::steady_clock clock;
+
+    size_t samples = 0;
+    double seconds = 0;
+    clock::time_point start = clock::now();
+
+    do {
+        kernel();
+        samples += BATCH_SIZE;
+        seconds = chrono::duration<double>(clock::now() - start).count();
+    } while (seconds < MIN_SECONDS);
+
+    return samples / seconds;
+}
+
+static float maxDifference(const vector<float> &a, const vector<float> &b) {
+    float diff = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        diff = max(diff, fabsf(a[i] - b[i]));
+    }
+    return diff;
+}
+
+int main() {
+    Points p(BATCH_SIZE);
+    CloudMarcher marcher;
+    CloudNoiseSimd::Layer layer(marcher);
+
+    vector<float> noiseRef(BATCH_SIZE), mapRef(BATCH_SIZE);
+    vector<float> out(BATCH_SIZE);
+
+    CloudNoiseSimd::noise(&p.x[0], &p.y[0], &p.z[0], &p.w[0], &noiseRef[0], BATCH_SIZE, CloudNoiseSimd::ISA_SCALAR);
+    CloudNoiseSimd::cloudMap(layer, &p.x[0], &p.y[0], &p.z[0], &p.w[0], &mapRef[0], BATCH_SIZE, CloudNoiseSimd::ISA_SCALAR);
+
+    CloudNoiseSimd::Isa isas[] = {
+        CloudNoiseSimd::ISA_SCALAR,
+        CloudNoiseSimd::ISA_SSE4,
+        CloudNoiseSimd::ISA_AVX2,
+    };
+
+    int result = 0;
+
+    printf("%-8s %-10s %16s %12s\n", "isa", "kernel", "samples/s", "max error");
+
+    for (CloudNoiseSimd::Isa isa : isas) {
+        const char *name = CloudNoiseSimd::getIsaName(isa);
+
+        if (!CloudNoiseSimd::isSupported(isa)) {
+            printf("%-8s unsupported\n", name);
+            continue;
+        }
+
+        double rate = measure([&] {
+            CloudNoiseSimd::noise(&p.x[0], &p.y[0], &p.z[0], &p.w[0], &out[0], BATCH_SIZE, isa);
+        });
+        float error = maxDifference(out, noiseRef);
+        printf("%-8s %-10s %16.0f %12g\n", name, "noise", rate, error);
+
+        if (error > CloudNoiseSimd::TOLERANCE) {
+            result = 1;
+        }
+
+        rate = measure([&] {
+            CloudNoiseSimd::cloudMap(layer, &p.x[0], &p.y[0], &p.z[0], &p.w[0], &out[0], BATCH_SIZE, isa);
+        });
+        error = maxDifference(out, mapRef);
+        printf("%-8s %-10s %16.0f %12g\n", name, "cloudMap", rate, error);
+
+        if (error > CloudNoiseSimd::TOLERANCE) {
+            result = 1;
+        }
+    }
+
+    if (result) {
+        printf("Error exceeds tolerance %g\n", CloudNoiseSimd::TOLERANCE);
+    }
+
+    return result;
+}
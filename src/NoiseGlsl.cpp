@@ -0,0 +1,37 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "Noise.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Writes GLSL of Noise to the given file or to standard output, the Makefile
+ * keeps shaders/noise.glsl generated by it.
+ */
+
+int main(int argc, char **argv) {
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [OUTPUT.glsl]\n", argv[0]);
+        return 1;
+    }
+
+    string glsl = NoiseBase::generateGlsl();
+
+    if (argc == 1) {
+        cout << glsl;
+        return 0;
+    }
+
+    ofstream out(argv[1]);
+    out << glsl;
+
+    if (!out) {
+        fprintf(stderr, "Cannot write '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <GL/glew.h>
+
+#include "ComputeShaderProgram.hpp"
+#include "Exceptions.hpp"
+#include "HeadlessContext.hpp"
+#include "Noise.hpp"
+#include "ShaderPreprocessor.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks that the shader noise agrees with Noise on CPU.
+ *
+ * First compares shaders/noise.glsl with NoiseBase::generateGlsl(), then
+ * evaluates hash and noise of every dimension on random points in
+ * a compute shader of a headless context. Prints the largest difference of
+ * each function and exits with non-zero code when the file is stale or
+ * a difference exceeds the tolerance. Run from the repository root.
+ */
+
+#define POINT_COUNT 65536
+#define LOCAL_SIZE 64
+// Hashes differ only by rounding of the division, noise also by cos().
+#define HASH_TOLERANCE 1e-6f
+#define NOISE_TOLERANCE 1e-5f
+
+static string noiseFile("./shaders/noise.glsl");
+static string parityFile("./shaders/noise-parity.comp");
+
+static const char *FUNCTIONS[] = {
+    "noise(float)", "noise(vec2)", "noise(vec3)", "noise(vec4)",
+    "hash(int)", "hash(ivec2)", "hash(ivec3)", "hash(ivec4)",
+};
+
+static const int FUNCTION_COUNT = sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]);
+
+static const char *PARITY_SHADER = R"(#version 430
+#define UINT_MAX 4294967295U
+#define PI 3.141592653589793
+
+layout(local_size_x = LOCAL_SIZE) in;
+
+layout(std430, binding = 0) readonly buffer Points {
+  vec4 points[];
+};
+
+layout(std430, binding = 1) writeonly buffer Values {
+  float values[];
+};
+
+#include "noise.glsl"
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+
+  if(i >= uint(points.length())) {
+    return;
+  }
+
+  vec4 p = points[i];
+  ivec4 c = ivec4(floor(p));
+  uint o = i * 8;
+
+  values[o + 0] = noise(p.x);
+  values[o + 1] = noise(p.xy);
+  values[o + 2] = noise(p.xyz);
+  values[o + 3] = noise(p);
+  values[o + 4] = hash(c.x);
+  values[o + 5] = hash(c.xy);
+  values[o + 6] = hash(c.xyz);
+  values[o + 7] = hash(c);
+}
+)";
+
+static void evaluate(const float *p, float *values) {
+    int c[4];
+
+    for (int i = 0; i < 4; i++) {
+        c[i] = floorf(p[i]);
+    }
+
+    values[0] = Noise<1>::noise(p);
+    values[1] = Noise<2>::noise(p);
+    values[2] = Noise<3>::noise(p);
+    values[3] = Noise<4>::noise(p);
+    values[4] = Noise<1>::hash(c);
+    values[5] = Noise<2>::hash(c);
+    values[6] = Noise<3>::hash(c);
+    values[7] = Noise<4>::hash(c);
+}
+
+static vector<float> evaluateShader(const vector<float> &points) {
+    ShaderPreprocessor preprocessor;
+    preprocessor.define("LOCAL_SIZE", LOCAL_SIZE);
+    preprocessor.setLoader([](const string &filename) {
+        return filename == parityFile ? string(PARITY_SHADER) : ShaderPreprocessor::readFile(filename);
+    });
+
+    ComputeShaderProgram program;
+    program.setComputeShaderFromFile(parityFile, preprocessor);
+
+    size_t count = points.size() / 4;
+    vector<float> values(count * FUNCTION_COUNT);
+    GLuint buffers[2];
+
+    glGenBuffers(2, buffers);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, points.size() * sizeof(float), &points[0], GL_STATIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, values.size() * sizeof(float), NULL, GL_STATIC_READ);
+
+    glUseProgram(program.getProgram());
+    glDispatchCompute((count + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, values.size() * sizeof(float), &values[0]);
+    glDeleteBuffers(2, buffers);
+
+    return values;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    try {
+        if (ShaderPreprocessor::readFile(noiseFile) != NoiseBase::generateGlsl()) {
+            fprintf(stderr, "%s is stale, regenerate it by bin/noise-glsl.\n", noiseFile.c_str());
+            return 1;
+        }
+
+        // Noise is used on coordinates of world units divided by 32 to 256,
+        // the far half of points tests wrapping of cell keys.
+        mt19937 rng(1103);
+        uniform_real_distribution<float> near(-64.0f, 64.0f);
+        uniform_real_distribution<float> far(-1e6f, 1e6f);
+        vector<float> points(POINT_COUNT * 4);
+
+        for (int i = 0; i < POINT_COUNT * 4; i++) {
+            points[i] = i < POINT_COUNT * 2 ? near(rng) : far(rng);
+        }
+
+        HeadlessContext context(ivec2(1, 1));
+        vector<float> gpu = evaluateShader(points);
+
+        float maxDifference[FUNCTION_COUNT] = {};
+        float expected[FUNCTION_COUNT];
+
+        for (int i = 0; i < POINT_COUNT; i++) {
+            evaluate(&points[i * 4], expected);
+
+            for (int f = 0; f < FUNCTION_COUNT; f++) {
+                float difference = fabsf(expected[f] - gpu[i * FUNCTION_COUNT + f]);
+                maxDifference[f] = std::max(maxDifference[f], difference);
+            }
+        }
+
+        bool failed = false;
+
+        printf("%-14s %12s\n", "function", "max error");
+
+        for (int f = 0; f < FUNCTION_COUNT; f++) {
+            float tolerance = f < 4 ? NOISE_TOLERANCE : HASH_TOLERANCE;
+            bool fail = !(maxDifference[f] <= tolerance);
+
+            printf("%-14s %12g%s\n", FUNCTIONS[f], maxDifference[f], fail ? "  FAIL" : "");
+            failed |= fail;
+        }
+
+        return failed;
+    } catch (string &e) {
+        fprintf(stderr, "%s\n", e.c_str());
+    } catch (Exception &e) {
+        fprintf(stderr, "%s\n", e.getMessage().c_str());
+    }
+
+    return 1;
+}
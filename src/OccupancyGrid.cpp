@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "OccupancyGrid.hpp"
+
+#define OCTAVE_COUNT 5
+#define BOUND_EPSILON 1e-4f
+#define COLUMNS_PER_JOB 16
+
+using namespace pgp;
+using namespace glm;
+
+// Octaves of CloudMarcher::cloudMap, negative weight is subtracted.
+static const float octaveScales[OCTAVE_COUNT] = {256.0f, 128.0f, 64.0f, 48.0f, 32.0f};
+static const float octaveWeights[OCTAVE_COUNT] = {0.25f, 0.35f, 0.225f, -0.1125f, 0.0625f};
+
+/**
+ * Coordinates where extremes of noise along one axis may lie: range ends
+ * and lattice planes between them.
+ */
+static void candidates(float lo, float hi, vector<float> &out) {
+    out.clear();
+    out.push_back(lo);
+    for (float k = floorf(lo) + 1; k < hi; k++) {
+        out.push_back(k);
+    }
+    out.push_back(hi);
+}
+
+OccupancyGrid::OccupancyGrid(float _cellSize, int _layers, float _timeWindow, int _refreshBudget) :
+    cellSize(_cellSize), layers(_layers), timeWindow(_timeWindow), refreshBudget(_refreshBudget),
+    lowerLayer(0), cellHeight(0), layer(CloudMarcher()), radius(0), size(0), minColumn(0), valid(false) {
+}
+
+int OccupancyGrid::update(const CloudMarcher &marcher, vec3 eyePosition, float time, ThreadPool *pool) {
+    float t = time * marcher.timeFactor;
+    CloudNoiseSimd::Layer newLayer(marcher);
+
+    bool layerChanged = newLayer.lowerLayer != layer.lowerLayer || newLayer.upperLayer != layer.upperLayer
+            || newLayer.layerEase != layer.layerEase || newLayer.layerOffset != layer.layerOffset;
+
+    if (!valid || layerChanged || radius != marcher.maxDistance + cellSize) {
+        layer = newLayer;
+        lowerLayer = marcher.lowerLayer;
+        cellHeight = (marcher.upperLayer - marcher.lowerLayer) / layers;
+        radius = marcher.maxDistance + cellSize;
+
+        size = ivec2(int(ceilf(2 * radius / cellSize)) + 1);
+        keys.assign(size.x * size.y, ivec2(0));
+        starts.assign(size.x * size.y, 0);
+        cells.assign(size.x * layers * size.y, 1);
+        valid = false;
+    }
+
+    vec4 q = CloudMarcher::advect(vec4(eyePosition, t));
+    minColumn = ivec2(int(floorf((q.x - radius) / cellSize)), int(floorf((q.z - radius) / cellSize)));
+
+    vector<std::pair<int, ivec2> > build;
+    vector<std::pair<float, int> > stale;
+
+    for (int z = 0; z < size.y; z++) {
+        for (int x = 0; x < size.x; x++) {
+            int slot = z * size.x + x;
+            ivec2 column = minColumn + ivec2(wrap(x - minColumn.x, size.x), wrap(z - minColumn.y, size.y));
+
+            if (!valid || keys[slot] != column || starts[slot] > t || starts[slot] + timeWindow < t) {
+                build.push_back(std::make_pair(slot, column));
+            } else if (starts[slot] + timeWindow / 2 < t) {
+                stale.push_back(std::make_pair(starts[slot], slot));
+            }
+        }
+    }
+
+    // Columns close to expiry are refreshed oldest first, a few per update.
+    std::sort(stale.begin(), stale.end());
+    for (int i = 0; i < std::min<int>(stale.size(), refreshBudget); i++) {
+        build.push_back(std::make_pair(stale[i].second, keys[stale[i].second]));
+    }
+
+    int jobCount = (build.size() + COLUMNS_PER_JOB - 1) / COLUMNS_PER_JOB;
+
+    auto job = [&](unsigned i) {
+        for (size_t j = i * COLUMNS_PER_JOB; j < std::min(build.size(), size_t(i + 1) * COLUMNS_PER_JOB); j++) {
+            buildColumn(build[j].second, t, build[j].first);
+        }
+    };
+
+    if (pool) {
+        pool->run(jobCount, job);
+    } else {
+        for (int i = 0; i < jobCount; i++) {
+            job(i);
+        }
+    }
+
+    valid = true;
+
+    return build.size();
+}
+
+void OccupancyGrid::buildColumn(ivec2 column, float t, int slot) {
+    vector<float> x, y, z, w;
+    vector<float> cx, cy, cz, cw;
+    // First candidate point of every octave and layer.
+    int offsets[OCTAVE_COUNT][2];
+    vector<int> layerOffsets;
+
+    vec3 lo(column.x * cellSize, lowerLayer, column.y * cellSize);
+    vec3 hi = lo + vec3(cellSize, 0, cellSize);
+
+    for (int o = 0; o < OCTAVE_COUNT; o++) {
+        float s = octaveScales[o];
+
+        candidates(lo.x / s, hi.x / s, cx);
+        candidates(lo.z / s, hi.z / s, cz);
+        candidates(t / s, (t + timeWindow) / s, cw);
+
+        offsets[o][0] = layerOffsets.size();
+
+        for (int l = 0; l < layers; l++) {
+            layerOffsets.push_back(x.size());
+
+            candidates((lowerLayer + l * cellHeight) / s, (lowerLayer + (l + 1) * cellHeight) / s, cy);
+
+            for (float pw : cw) {
+                for (float pz : cz) {
+                    for (float py : cy) {
+                        for (float px : cx) {
+                            x.push_back(px);
+                            y.push_back(py);
+                            z.push_back(pz);
+                            w.push_back(pw);
+                        }
+                    }
+                }
+            }
+        }
+
+        offsets[o][1] = layerOffsets.size();
+    }
+    layerOffsets.push_back(x.size());
+
+    vector<float> values(x.size());
+    CloudNoiseSimd::noise(&x[0], &y[0], &z[0], &w[0], &values[0], values.size());
+
+    int sx = slot % size.x;
+    int sz = slot / size.x;
+
+    for (int l = 0; l < layers; l++) {
+        float f = 0;
+
+        for (int o = 0; o < OCTAVE_COUNT; o++) {
+            int first = layerOffsets[offsets[o][0] + l];
+            int last = layerOffsets[offsets[o][0] + l + 1];
+
+            auto range = std::minmax_element(values.begin() + first, values.begin() + last);
+            f += octaveWeights[o] * (octaveWeights[o] > 0 ? *range.second : *range.first);
+        }
+
+        float ease = maxEase(lowerLayer + l * cellHeight, lowerLayer + (l + 1) * cellHeight);
+        bool empty = f * 1.35f - 0.5f + BOUND_EPSILON <= 0 || ease <= 0;
+
+        cells[(sz * layers + l) * size.x + sx] = empty ? 0 : 1;
+    }
+
+    keys[slot] = column;
+    starts[slot] = t;
+}
+
+float OccupancyGrid::maxEase(float y0, float y1) const {
+    // Ease is piecewise linear in height, extremes lie at range ends or kinks.
+    float kinks[] = {
+        y0,
+        y1,
+        layer.lowerLayer + layer.layerOffset,
+        layer.lowerLayer + layer.layerOffset + layer.layerEase,
+        layer.upperLayer - layer.layerOffset - layer.layerEase,
+        layer.upperLayer - layer.layerOffset,
+    };
+
+    float result = 0;
+
+    for (float y : kinks) {
+        if (y < y0 || y > y1) {
+            continue;
+        }
+
+        float upperEase = clamp((layer.upperLayer - layer.layerOffset - y) / layer.layerEase, 0.0f, 1.0f);
+        float lowerEase = clamp((y - layer.lowerLayer - layer.layerOffset) / layer.layerEase, 0.0f, 1.0f);
+
+        result = std::max(result, 1 - std::abs(upperEase - lowerEase));
+    }
+
+    return result;
+}
+
+bool OccupancyGrid::isEmpty(vec3 q, vec3 direction, float &exitDistance) const {
+    if (!valid) {
+        return false;
+    }
+
+    vec3 cellDims = getCellSize();
+    vec3 base(0, lowerLayer, 0);
+    vec3 local = (q - base) / cellDims;
+    ivec3 cell(int(floorf(local.x)), int(floorf(local.y)), int(floorf(local.z)));
+
+    if (cell.y < 0 || cell.y >= layers
+            || cell.x < minColumn.x || cell.x >= minColumn.x + size.x
+            || cell.z < minColumn.y || cell.z >= minColumn.y + size.y) {
+        return false;
+    }
+
+    if (cells[(wrap(cell.z, size.y) * layers + cell.y) * size.x + wrap(cell.x, size.x)]) {
+        return false;
+    }
+
+    vec3 lo = vec3(cell) * cellDims + base;
+    vec3 hi = lo + cellDims;
+
+    exitDistance = INFINITY;
+    for (int i = 0; i < 3; i++) {
+        if (direction[i] > 0) {
+            exitDistance = std::min(exitDistance, (hi[i] - q[i]) / direction[i]);
+        } else if (direction[i] < 0) {
+            exitDistance = std::min(exitDistance, (lo[i] - q[i]) / direction[i]);
+        }
+    }
+
+    return true;
+}
+
+float OccupancyGrid::getEmptyFraction() const {
+    if (cells.empty()) {
+        return 0;
+    }
+
+    return std::count(cells.begin(), cells.end(), 0) / float(cells.size());
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "CloudMarcher.hpp"
+#include "CloudNoiseSimd.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::ivec2;
+    using glm::ivec3;
+    using glm::vec3;
+
+    /**
+     * Coarse grid marking cells of the cloud slab where cloudMap is provably
+     * zero, so marching rays can jump over them.
+     *
+     * Each noise octave is multilinear in monotonic weights of its lattice
+     * cell, so its extremes over a box lie at box corners or lattice planes
+     * crossing the box. Summing extremes of all octaves bounds the density.
+     *
+     * Cells live in wind advected coordinates (q in cloudMap) and cover a
+     * range of field time. Columns are kept in a ring buffer around the eye,
+     * update() evaluates only columns entering the region or running out of
+     * their time range, so the grid follows both camera and wind
+     * incrementally. Bounds hold for the procedural field, not for the
+     * interpolated DensityVolume.
+     */
+    class OccupancyGrid {
+    private:
+        float cellSize;
+        int layers;
+        float timeWindow;
+        int refreshBudget;
+
+        float lowerLayer;
+        float cellHeight;
+        CloudNoiseSimd::Layer layer;
+        float radius;
+
+        ivec2 size;
+        ivec2 minColumn;
+        // Per column slot: column it holds and field time its bounds start at.
+        vector<ivec2> keys;
+        vector<float> starts;
+        // Non-zero when cell may have density, x fastest, then layer, then z.
+        vector<uint8_t> cells;
+        bool valid;
+
+    public:
+        /**
+         * Cell size is in world units, the slab is split into given number of
+         * layers. Bounds of a column are valid for time window of field time
+         * (shader time multiplied by timeFactor), refresh budget limits the
+         * number of columns re-evaluated ahead of their expiry per update.
+         */
+        OccupancyGrid(float cellSize = 16.0, int layers = 8, float timeWindow = 8.0, int refreshBudget = 256);
+
+        /**
+         * Brings the grid to given eye position and shader time. Returns the
+         * number of re-evaluated columns.
+         */
+        int update(const CloudMarcher &marcher, vec3 eyePosition, float time, ThreadPool *pool = NULL);
+
+        /**
+         * Whether cell containing advected point q is empty. If so, exit
+         * distance is set to the distance along direction to the cell border.
+         */
+        bool isEmpty(vec3 q, vec3 direction, float &exitDistance) const;
+
+        inline const vector<uint8_t> &getCells() const {
+            return cells;
+        }
+
+        /**
+         * Cells in x, layers and z. Cell x, y, z is stored at
+         * x mod size.x, y, z mod size.z.
+         */
+        inline ivec3 getSize() const {
+            return ivec3(size.x, layers, size.y);
+        }
+
+        /**
+         * First cell of the region, cells outside of it are not known.
+         */
+        inline ivec3 getMinCell() const {
+            return ivec3(minColumn.x, 0, minColumn.y);
+        }
+
+        /**
+         * Where the first cell of the region is stored.
+         */
+        inline ivec3 getMinSlot() const {
+            return ivec3(wrap(minColumn.x, size.x), 0, wrap(minColumn.y, size.y));
+        }
+
+        inline vec3 getCellSize() const {
+            return vec3(cellSize, cellHeight, cellSize);
+        }
+
+        inline float getLowerLayer() const {
+            return lowerLayer;
+        }
+
+        /**
+         * Fraction of empty cells.
+         */
+        float getEmptyFraction() const;
+
+    private:
+        void buildColumn(ivec2 column, float t, int slot);
+
+        float maxEase(float y0, float y1) const;
+
+        static inline int wrap(int x, int size) {
+            x %= size;
+            return x < 0 ? x + size : x;
+        }
+    };
+
+}
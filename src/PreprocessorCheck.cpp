@@ -0,0 +1,159 @@
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ShaderPreprocessor.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks ShaderPreprocessor on in-memory sources.
+ *
+ * Output text is compared exactly: includes resolved relative to the
+ * including file and each included once, #line directives after every
+ * include and after the inserted defines, defines right after #version.
+ * Include cycles, missing files, malformed includes and sources without
+ * #version have to throw. Hashes of known strings and of processed
+ * sources have to stay the same between versions. Needs no GL context.
+ * Exits with non-zero code on any failure.
+ */
+
+// FNV-1a of "" and "a".
+#define HASH_EMPTY 14695981039346656037ull
+#define HASH_A 0xaf63dc4c8601ec8cull
+
+static map<string, string> sources = {
+    {"shaders/main.comp",
+        "#version 430\n"
+        "#include \"lib/a.glsl\"\n"
+        "#include \"lib/b.glsl\"\n"
+        "void main() {}\n"},
+    {"shaders/lib/a.glsl",
+        "#include \"b.glsl\"\n"
+        "float a() { return b(); }\n"},
+    {"shaders/lib/b.glsl",
+        "float b() { return 1.0; }\n"},
+    {"shaders/late.comp",
+        "\n"
+        "  #version 430\n"
+        "float late;\n"},
+    {"shaders/cycle.comp",
+        "#version 430\n"
+        "#include \"cycle.glsl\"\n"},
+    {"shaders/cycle.glsl",
+        "#include \"cycle.comp\"\n"},
+    {"shaders/missing.comp",
+        "#version 430\n"
+        "#include \"none.glsl\"\n"},
+    {"shaders/unquoted.comp",
+        "#version 430\n"
+        "#include <b.glsl>\n"},
+    {"shaders/noversion.comp",
+        "#include \"lib/b.glsl\"\n"
+        "#version 430\n"},
+};
+
+static ShaderPreprocessor memoryPreprocessor() {
+    ShaderPreprocessor preprocessor;
+
+    preprocessor.setLoader([](const string &filename) {
+        auto it = sources.find(filename);
+
+        if (it == sources.end()) {
+            throw string("Could not load file '" + filename + "'.");
+        }
+
+        return it->second;
+    });
+
+    return preprocessor;
+}
+
+static bool expect(const char *name, bool ok) {
+    printf("%-36s %s\n", name, ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+static bool expectText(const char *name, const string &actual, const string &expected) {
+    if (actual != expected) {
+        printf("%-36s FAILED\n--- expected\n%s--- got\n%s---\n", name, expected.c_str(), actual.c_str());
+        return false;
+    }
+
+    return expect(name, true);
+}
+
+static bool expectThrow(const char *name, const string &filename) {
+    ShaderPreprocessor preprocessor = memoryPreprocessor();
+
+    try {
+        preprocessor.process(filename);
+    } catch (string &e) {
+        printf("%-36s ok (%s)\n", name, e.c_str());
+        return true;
+    }
+
+    return expect(name, false);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+
+    ShaderPreprocessor preprocessor = memoryPreprocessor();
+    preprocessor.define("STEP_MODE", 2);
+    preprocessor.define("SCALE", 0.5f);
+    preprocessor.define("ONE", 1.0f);
+
+    vector<string> files;
+    string source = preprocessor.process("shaders/main.comp", &files);
+
+    failures += !expectText("includes, defines and #line", source,
+            "#version 430\n"
+            "#define ONE 1.0\n"
+            "#define SCALE 0.5\n"
+            "#define STEP_MODE 2\n"
+            "#line 2 0\n"
+            "#line 1 1\n"
+            "#line 1 2\n"
+            "float b() { return 1.0; }\n"
+            "#line 2 1\n"
+            "float a() { return b(); }\n"
+            "#line 3 0\n"
+            "\n"
+            "void main() {}\n");
+
+    failures += !expect("source string numbers", files == vector<string>({
+            "shaders/main.comp", "shaders/lib/a.glsl", "shaders/lib/b.glsl"}));
+
+    failures += !expectText("#line after late #version", memoryPreprocessor().process("shaders/late.comp"),
+            "\n"
+            "  #version 430\n"
+            "#line 3 0\n"
+            "float late;\n");
+
+    failures += !expectThrow("include cycle throws", "shaders/cycle.comp");
+    failures += !expectThrow("missing include throws", "shaders/missing.comp");
+    failures += !expectThrow("unquoted include throws", "shaders/unquoted.comp");
+    failures += !expectThrow("source without #version throws", "shaders/noversion.comp");
+
+    failures += !expect("hash of known strings", ShaderPreprocessor::hash("") == HASH_EMPTY
+            && ShaderPreprocessor::hash("a") == HASH_A);
+
+    uint64_t first = ShaderPreprocessor::hash(source);
+    bool same = ShaderPreprocessor::hash(preprocessor.process("shaders/main.comp")) == first;
+
+    preprocessor.define("STEP_MODE", 1);
+    bool changed = ShaderPreprocessor::hash(preprocessor.process("shaders/main.comp")) != first;
+
+    failures += !expect("hash follows source and defines", same && changed);
+
+    return failures > 0;
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "ProcessorScheduler.hpp"
+
+using namespace pgp;
+using namespace std;
+
+ProcessorScheduler::ProcessorScheduler() : failed(false) {
+}
+
+int ProcessorScheduler::add(const void *self, const ProcessorAccess &access) {
+    Task task;
+    task.access = access;
+    task.access.writes.push_back(self);
+    task.dependencies = 0;
+
+    int index = tasks.size();
+
+    for (Task &earlier : tasks) {
+        if (conflicts(earlier.access, task.access)) {
+            earlier.dependents.push_back(index);
+            task.dependencies++;
+        }
+    }
+
+    tasks.push_back(task);
+
+    return index;
+}
+
+void ProcessorScheduler::run(ThreadPool *pool, const function<void(int)> &task) {
+    if (!pool || pool->getThreadCount() == 1) {
+        // Adding order is a valid order.
+        for (size_t i = 0; i < tasks.size(); i++) {
+            task(i);
+        }
+        return;
+    }
+
+    ready.clear();
+    pending.resize(tasks.size());
+    failed = false;
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        pending[i] = tasks[i].dependencies;
+
+        if (pending[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    // Ready tasks are taken from the front, in adding order.
+    reverse(ready.begin(), ready.end());
+
+    // Every job runs one task, whichever is ready first. Some unfinished task
+    // is always ready or running, so waiting jobs cannot deadlock.
+    pool->run(tasks.size(), [&](unsigned) {
+        int i;
+
+        {
+            unique_lock<std::mutex> lock(mutex);
+            readyCondition.wait(lock, [this] {
+                return failed || !ready.empty();
+            });
+
+            if (failed) {
+                return;
+            }
+
+            i = ready.back();
+            ready.pop_back();
+        }
+
+        try {
+            task(i);
+        } catch (...) {
+            {
+                lock_guard<std::mutex> lock(mutex);
+                failed = true;
+            }
+            readyCondition.notify_all();
+            throw;
+        }
+
+        int released = 0;
+        {
+            lock_guard<std::mutex> lock(mutex);
+
+            for (int dependent : tasks[i].dependents) {
+                if (--pending[dependent] == 0) {
+                    ready.insert(ready.begin(), dependent);
+                    released++;
+                }
+            }
+        }
+
+        if (released == 1) {
+            readyCondition.notify_one();
+        } else if (released > 1) {
+            readyCondition.notify_all();
+        }
+    });
+}
+
+vector<int> ProcessorScheduler::getDependencies(int i) const {
+    vector<int> dependencies;
+
+    for (int j = 0; j < i; j++) {
+        const vector<int> &dependents = tasks[j].dependents;
+
+        if (find(dependents.begin(), dependents.end(), i) != dependents.end()) {
+            dependencies.push_back(j);
+        }
+    }
+
+    return dependencies;
+}
+
+int ProcessorScheduler::getCriticalPathLength() const {
+    // Dependents always come later, so one pass in adding order suffices.
+    vector<int> length(tasks.size(), 1);
+    int longest = 0;
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        for (int dependent : tasks[i].dependents) {
+            length[dependent] = max(length[dependent], length[i] + 1);
+        }
+        longest = max(longest, length[i]);
+    }
+
+    return longest;
+}
+
+bool ProcessorScheduler::conflicts(const ProcessorAccess &a, const ProcessorAccess &b) {
+    return a.exclusive || b.exclusive || intersects(a.writes, b.writes)
+            || intersects(a.writes, b.reads) || intersects(a.reads, b.writes);
+}
+
+bool ProcessorScheduler::intersects(const vector<const void*> &a, const vector<const void*> &b) {
+    for (const void *x : a) {
+        if (find(b.begin(), b.end(), x) != b.end()) {
+            return true;
+        }
+    }
+
+    return false;
+}
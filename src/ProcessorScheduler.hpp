@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+
+    /**
+     * Objects a processor step reads and writes. Processor always writes
+     * itself. Default access is exclusive, the step is ordered against every
+     * other one, as when all steps ran serially.
+     */
+    struct ProcessorAccess {
+        vector<const void*> reads;
+        vector<const void*> writes;
+        bool exclusive;
+
+        ProcessorAccess() : exclusive(true) {
+        }
+
+        ProcessorAccess(std::initializer_list<const void*> _reads, std::initializer_list<const void*> _writes) :
+            reads(_reads), writes(_writes), exclusive(false) {
+        }
+    };
+
+    /**
+     * Runs tasks in an order respecting their declared access.
+     *
+     * Task depends on every earlier added task it conflicts with, i.e. one of
+     * them writes what the other reads or writes. Tasks without a path
+     * between them run concurrently on the pool, so a step takes the time of
+     * the longest dependency chain rather than the sum of all tasks. With an
+     * exclusive task everywhere the order is the order of adding.
+     */
+    class ProcessorScheduler {
+    private:
+        struct Task {
+            ProcessorAccess access;
+            vector<int> dependents;
+            int dependencies;
+        };
+
+        vector<Task> tasks;
+
+        // State of a running step, guarded by mutex.
+        std::mutex mutex;
+        std::condition_variable readyCondition;
+        vector<int> ready;
+        vector<int> pending;
+        bool failed;
+
+    public:
+        ProcessorScheduler();
+
+        /**
+         * Returns index of the task, passed to run's callback.
+         */
+        int add(const void *self, const ProcessorAccess &access);
+
+        /**
+         * Calls task(i) for every task and returns once all of them finished.
+         * First exception thrown by a task is rethrown, tasks depending on it
+         * are not started.
+         */
+        void run(ThreadPool *pool, const std::function<void(int)> &task);
+
+        inline int getTaskCount() const {
+            return tasks.size();
+        }
+
+        /**
+         * Tasks that have to finish before task i starts, direct ones only.
+         */
+        vector<int> getDependencies(int i) const;
+
+        /**
+         * Number of tasks on the longest dependency chain.
+         */
+        int getCriticalPathLength() const;
+
+    private:
+        static bool conflicts(const ProcessorAccess &a, const ProcessorAccess &b);
+
+        static bool intersects(const vector<const void*> &a, const vector<const void*> &b);
+    };
+
+}
@@ -1,11 +1,33 @@
+#include <algorithm>
+#include <cstdlib>
+#include <typeinfo>
+#include <cxxabi.h>
+
 #include "RegistrablesContainer.hpp"
 
 using namespace pgp;
 
-RegistrablesContainer::RegistrablesContainer() {
+// Steps are short, a few threads are enough for the independent ones.
+#define PROCESSOR_THREADS 4
+
+RegistrablesContainer::RegistrablesContainer(FrameProfiler *_profiler) : profiler(_profiler), ownsProfiler(false),
+    gpuTimer(NULL), processorPool(std::min(unsigned(PROCESSOR_THREADS), ThreadPool::getHardwareThreads())) {
+
+    if (!profiler) {
+        profiler = new FrameProfiler();
+        ownsProfiler = true;
+    }
 }
 
-void RegistrablesContainer::autoregister(IRegisterable *registerable) {
+RegistrablesContainer::~RegistrablesContainer() {
+    delete gpuTimer;
+
+    if (ownsProfiler) {
+        delete profiler;
+    }
+}
+
+void RegistrablesContainer::autoregister(IRegisterable *registerable, const ProcessorAccess &access) {
     IEventListener *listener = dynamic_cast<IEventListener*> (registerable);
     if (listener) {
         registerEventListener(listener);
@@ -13,7 +35,7 @@ void RegistrablesContainer::autoregister(IRegisterable *registerable) {
 
     IProcessor *processor = dynamic_cast<IProcessor*> (registerable);
     if (processor) {
-        registerProcessor(processor);
+        registerProcessor(processor, access);
     }
 
     IRenderer *renderer = dynamic_cast<IRenderer*> (registerable);
@@ -22,3 +44,28 @@ void RegistrablesContainer::autoregister(IRegisterable *registerable) {
     }
 }
 
+void RegistrablesContainer::enableGpuTiming() {
+    if (!gpuTimer) {
+        gpuTimer = new GpuTimer(profiler);
+    }
+}
+
+void RegistrablesContainer::disableGpuTiming() {
+    delete gpuTimer;
+    gpuTimer = NULL;
+}
+
+string RegistrablesContainer::getStageName(IRegisterable *registerable, const char *method) {
+    const char *mangled = typeid (*registerable).name();
+
+    int status;
+    char *demangled = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+    string name = status == 0 ? demangled : mangled;
+    free(demangled);
+
+    if (name.compare(0, 5, "pgp::") == 0) {
+        name = name.substr(5);
+    }
+
+    return name + "." + method;
+}
@@ -1,23 +1,52 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "IRegisterable.hpp"
 #include "IEventListener.hpp"
 #include "IRenderer.hpp"
 #include "IProcessor.hpp"
+#include "FrameProfiler.hpp"
+#include "GpuTimer.hpp"
+#include "ProcessorScheduler.hpp"
+#include "ThreadPool.hpp"
 
 namespace pgp {
 
+    using std::string;
     using std::vector;
 
+    /**
+     * Every processor step and renderer is a stage of the profiler, named
+     * by the class of the object. Renderers are also timed on the GPU once
+     * enableGpuTiming() is called.
+     *
+     * Processors declare what their step reads and writes when registered,
+     * independent steps run concurrently and all of them finish before
+     * runProcessors() returns. Steps must not touch GL.
+     */
     class RegistrablesContainer {
     protected:
         vector<IEventListener*> eventListenerList;
         vector<IRenderer*> rendererList;
         vector<IProcessor*> processorList;
+        vector<int> rendererStages;
+        vector<int> processorStages;
+
+        FrameProfiler *profiler;
+        bool ownsProfiler;
+        GpuTimer *gpuTimer;
+
+        ProcessorScheduler scheduler;
+        ThreadPool processorPool;
     public:
-        RegistrablesContainer();
+        /**
+         * Containers running on more threads can share one profiler, without
+         * profiler the container has its own.
+         */
+        RegistrablesContainer(FrameProfiler *profiler = NULL);
+        ~RegistrablesContainer();
 
         inline void registerEventListener(IEventListener *listener) {
             eventListenerList.push_back(listener);
@@ -25,25 +54,65 @@ namespace pgp {
 
         inline void registerRenderer(IRenderer *renderer) {
             rendererList.push_back(renderer);
+            rendererStages.push_back(profiler->addStage(getStageName(renderer, "render")));
         }
 
-        inline void registerProcessor(IProcessor *processor) {
+        /**
+         * Objects in access are compared by address of the whole object, so
+         * pass pointers to the most derived class, e.g. {camera}.
+         */
+        inline void registerProcessor(IProcessor *processor, const ProcessorAccess &access = ProcessorAccess()) {
             processorList.push_back(processor);
+            processorStages.push_back(profiler->addStage(getStageName(processor, "step")));
+            scheduler.add(dynamic_cast<const void*> (processor), access);
         }
 
         inline void runProcessors(float time, float delta) {
-            for (IProcessor *processor : processorList) {
-                processor->step(time, delta);
-            }
+            scheduler.run(&processorPool, [&](int i) {
+                FrameProfiler::Scope scope(*profiler, processorStages[i]);
+                processorList[i]->step(time, delta);
+            });
         }
 
         inline void runRenderers() {
-            for (IRenderer *renderer : rendererList) {
-                renderer->render();
+            for (size_t i = 0; i < rendererList.size(); i++) {
+                FrameProfiler::Scope scope(*profiler, rendererStages[i]);
+
+                if (gpuTimer) {
+                    gpuTimer->begin(rendererStages[i]);
+                }
+
+                rendererList[i]->render();
+
+                if (gpuTimer) {
+                    gpuTimer->end();
+                }
             }
+
+            if (gpuTimer) {
+                gpuTimer->collect();
+            }
+        }
+
+        /**
+         * Access applies to the step of registerable if it is a processor.
+         */
+        void autoregister(IRegisterable *registerable, const ProcessorAccess &access = ProcessorAccess());
+
+        /**
+         * Needs current GL context, the timer is deleted with the container
+         * or by disableGpuTiming() while the context still exists.
+         */
+        void enableGpuTiming();
+
+        void disableGpuTiming();
+
+        inline FrameProfiler &getProfiler() {
+            return *profiler;
         }
 
-        void autoregister(IRegisterable *registerable);
+    private:
+        static string getStageName(IRegisterable *registerable, const char *method);
     };
 
 }
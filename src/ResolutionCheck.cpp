@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <random>
+
+#include "ResolutionController.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks ResolutionController against synthetic pass timings.
+ *
+ * A pass costs a fixed part plus a part proportional to its pixels, times
+ * noise, and its measurements arrive a few frames late like GPU queries.
+ * In every scenario the controller has to settle within a few changes, stay
+ * on one downscale for the last quarter of the run and end on a downscale
+ * whose noiseless cost fits the budget, or on the coarsest one when none
+ * does. Exits with non-zero code on any failure.
+ */
+
+#define MIN_DOWNSCALE 1
+#define MAX_DOWNSCALE 8
+// Frames between a pass and its measurement.
+#define LAG 3
+// More changes than this in one scenario count as oscillation.
+#define MAX_CHANGES 4
+
+struct Scenario {
+    const char *name;
+    float fixed;
+    float perPixel;
+    // Standard deviation of the relative noise.
+    float noise;
+    float budget;
+    int frames;
+    // Per pixel cost is multiplied by loadStep at frame loadAt, before the
+    // last quarter of the run.
+    int loadAt;
+    float loadStep;
+};
+
+static float passCost(const Scenario &s, float perPixel, int downscale) {
+    return s.fixed + perPixel / float(downscale * downscale);
+}
+
+static bool run(const Scenario &s) {
+    mt19937 rng(2101);
+    normal_distribution<float> noise(1.0f, s.noise);
+
+    ResolutionController controller(s.budget, 4, MIN_DOWNSCALE, MAX_DOWNSCALE);
+    deque<pair<float, int>> pending;
+    float perPixel = s.perPixel;
+    int downscale = controller.getDownscale();
+    int stableFrom = s.frames * 3 / 4;
+    int settledDownscale = -1;
+    bool stable = true;
+
+    for (int frame = 0; frame < s.frames; frame++) {
+        if (frame == s.loadAt) {
+            perPixel *= s.loadStep;
+        }
+
+        pending.push_back(make_pair(passCost(s, perPixel, downscale) * std::max(0.2f, noise(rng)), downscale));
+
+        if (pending.size() > LAG) {
+            downscale = controller.update(pending.front().first, pending.front().second);
+            pending.pop_front();
+        }
+
+        if (frame >= stableFrom) {
+            if (settledDownscale < 0) {
+                settledDownscale = downscale;
+            }
+
+            stable = stable && downscale == settledDownscale;
+        }
+    }
+
+    float finalCost = passCost(s, perPixel, downscale);
+    bool fits = finalCost <= s.budget || downscale == MAX_DOWNSCALE;
+    bool calm = controller.getChanges() <= MAX_CHANGES;
+
+    printf("%-24s downscale %d, %u changes, cost %.2f of budget %.2f%s\n", s.name, downscale,
+            controller.getChanges(), finalCost, s.budget, fits && calm && stable ? "" : "  FAILED");
+
+    return fits && calm && stable;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    Scenario scenarios[] = {
+        {"fits at downscale 2", 0.5f, 40.0f, 0.05f, 16.0f, 5000, -1, 1},
+        {"downscale 4 at budget", 0.5f, 128.0f, 0.1f, 8.6f, 20000, -1, 1},
+        {"noise at budget edge", 0.5f, 128.0f, 0.2f, 8.5f, 20000, -1, 1},
+        {"mostly fixed cost", 4.0f, 60.0f, 0.1f, 10.0f, 20000, -1, 1},
+        {"load step up", 0.5f, 40.0f, 0.05f, 16.0f, 6000, 2000, 3},
+        {"load step down", 0.5f, 120.0f, 0.05f, 16.0f, 6000, 2000, 1 / 3.0f},
+        {"unreachable budget", 20.0f, 100.0f, 0.05f, 10.0f, 3000, -1, 1},
+    };
+
+    int failures = 0;
+
+    for (const Scenario &s : scenarios) {
+        failures += !run(s);
+    }
+
+    return failures > 0;
+}
@@ -0,0 +1,70 @@
+#include <algorithm>
+
+#include "ResolutionController.hpp"
+
+// Weight of a new measurement in the average.
+#define SMOOTHING 0.1f
+// Finer level is taken only when predicted below this part of the budget.
+#define HEADROOM 0.75f
+// Getting coarser aims below this part of the budget.
+#define TARGET 0.9f
+// Measurements ignored for changes after a change.
+#define SETTLE_SAMPLES 10
+// Measurements before a finer level is tried after getting coarser, doubled
+// when the last finer level did not hold for that long.
+#define REFINE_DELAY 120
+#define MAX_REFINE_DELAY 3840
+
+using namespace pgp;
+
+ResolutionController::ResolutionController(float _budget, int _downscale, int _minDownscale, int _maxDownscale) :
+    budget(_budget), minDownscale(_minDownscale), maxDownscale(std::max(_maxDownscale, _minDownscale)),
+    downscale(std::min(std::max(_downscale, minDownscale), maxDownscale)), average(-1),
+    settle(0), refineDelay(0), refineBackoff(REFINE_DELAY), sinceRefine(REFINE_DELAY), changes(0) {
+}
+
+int ResolutionController::update(float time, int measuredDownscale) {
+    float estimate = scaleCost(time, measuredDownscale, downscale);
+    average = average < 0 ? estimate : average + (estimate - average) * SMOOTHING;
+
+    sinceRefine++;
+
+    if (refineDelay > 0) {
+        refineDelay--;
+    }
+
+    if (settle > 0) {
+        settle--;
+        return downscale;
+    }
+
+    if (average > budget) {
+        int to = downscale;
+
+        while (to < maxDownscale && scaleCost(average, downscale, to) > budget * TARGET) {
+            to++;
+        }
+
+        if (to != downscale) {
+            // Finer level failed soon after it was taken.
+            refineBackoff = sinceRefine < refineBackoff ? std::min(refineBackoff * 2, MAX_REFINE_DELAY) : REFINE_DELAY;
+            refineDelay = refineBackoff;
+
+            change(to);
+        }
+    } else if (refineDelay == 0 && downscale > minDownscale
+            && scaleCost(average, downscale, downscale - 1) <= budget * HEADROOM) {
+
+        sinceRefine = 0;
+        change(downscale - 1);
+    }
+
+    return downscale;
+}
+
+void ResolutionController::change(int to) {
+    average = scaleCost(average, downscale, to);
+    downscale = to;
+    settle = SETTLE_SAMPLES;
+    changes++;
+}
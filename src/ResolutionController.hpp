@@ -0,0 +1,78 @@
+#pragma once
+
+namespace pgp {
+
+    /**
+     * Chooses the downscale of a render pass so that its time stays within
+     * a budget.
+     *
+     * Cost is taken as proportional to the rendered pixels, 1 / downscale^2,
+     * so measurements at any downscale estimate the cost at the current one
+     * and late results from before a change are still usable. The estimate
+     * is smoothed over recent frames.
+     *
+     * Hysteresis: the pass gets coarser once the estimate exceeds the
+     * budget, but finer only when the finer level is predicted to fit well
+     * below it. After any change the controller waits for new measurements,
+     * and after getting coarser it waits longer before trying a finer level
+     * again, twice as long each time a finer level fails soon after it was
+     * taken.
+     */
+    class ResolutionController {
+    private:
+        float budget;
+        int minDownscale, maxDownscale;
+        int downscale;
+
+        // Smoothed cost at the current downscale, negative before the first
+        // measurement.
+        float average;
+        // Measurements left before the next change, and before the next
+        // change to a finer level.
+        int settle, refineDelay;
+        int refineBackoff, sinceRefine;
+        unsigned changes;
+
+    public:
+        /**
+         * Budget is in the unit of the measurements given to update().
+         */
+        ResolutionController(float budget, int downscale = 4, int minDownscale = 1, int maxDownscale = 8);
+
+        /**
+         * Adds time of one pass rendered at measured downscale. Returns the
+         * downscale for the next passes.
+         */
+        int update(float time, int measuredDownscale);
+
+        inline int getDownscale() const {
+            return downscale;
+        }
+
+        /**
+         * Smoothed cost at the current downscale.
+         */
+        inline float getAverage() const {
+            return average;
+        }
+
+        inline unsigned getChanges() const {
+            return changes;
+        }
+
+        inline float getBudget() const {
+            return budget;
+        }
+
+        /**
+         * Time at downscale to from time at downscale from.
+         */
+        static inline float scaleCost(float time, int from, int to) {
+            return time * float(from * from) / float(to * to);
+        }
+
+    private:
+        void change(int to);
+    };
+
+}
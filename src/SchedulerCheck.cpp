@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ProcessorScheduler.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks that ProcessorScheduler keeps the order implied by declared access.
+ *
+ * Readers of an object have to start after its writer finished and a later
+ * writer after all of them, independent readers have to run at the same
+ * time, tasks with default access have to run one by one in adding order
+ * and a task that throws has to have its exception rethrown by run() while
+ * the tasks depending on it are never started. Every run is repeated on a
+ * pool of several threads, which does not need as many cores.
+ * Exits with non-zero code on any failure.
+ */
+
+#define THREADS 4
+#define REPEATS 50
+// Work of a task, long enough for the others to start meanwhile.
+#define TASK_MS 2
+// How long a task waits for another one that should run beside it.
+#define MEET_MS 2000
+
+static void work() {
+    this_thread::sleep_for(chrono::milliseconds(TASK_MS));
+}
+
+static bool expect(const char *name, bool ok) {
+    printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+/**
+ * Writer, two readers and a writer after them, all of one object.
+ */
+static bool checkReadAfterWrite(ThreadPool &pool) {
+    int object;
+    char writer, first, second, rewriter;
+
+    ProcessorScheduler scheduler;
+    scheduler.add(&writer, ProcessorAccess({}, {&object}));
+    scheduler.add(&first, ProcessorAccess({&object}, {}));
+    scheduler.add(&second, ProcessorAccess({&object}, {}));
+    scheduler.add(&rewriter, ProcessorAccess({}, {&object}));
+
+    bool structure = scheduler.getDependencies(1) == vector<int>({0})
+            && scheduler.getDependencies(2) == vector<int>({0})
+            && scheduler.getDependencies(3) == vector<int>({0, 1, 2})
+            && scheduler.getCriticalPathLength() == 3;
+
+    bool ordered = true;
+
+    for (int repeat = 0; repeat < REPEATS; repeat++) {
+        atomic<int> value(0);
+        int seen[2] = {-1, -1};
+        int finalValue = -1;
+
+        scheduler.run(&pool, [&](int i) {
+            work();
+
+            if (i == 0) {
+                value = 1;
+            } else if (i == 3) {
+                // Both readers have to be done.
+                finalValue = seen[0] == 1 && seen[1] == 1 ? 2 : -1;
+            } else {
+                seen[i - 1] = value;
+            }
+        });
+
+        ordered = ordered && seen[0] == 1 && seen[1] == 1 && finalValue == 2;
+    }
+
+    structure = expect("read after write dependencies", structure);
+    ordered = expect("read after write order", ordered);
+
+    return structure && ordered;
+}
+
+/**
+ * Readers of one object share nothing they write, so they have to meet.
+ */
+static bool checkConcurrentReaders(ThreadPool &pool) {
+    int object;
+    char first, second;
+
+    ProcessorScheduler scheduler;
+    scheduler.add(&first, ProcessorAccess({&object}, {}));
+    scheduler.add(&second, ProcessorAccess({&object}, {}));
+
+    atomic<int> arrived(0);
+    atomic<int> met(0);
+
+    scheduler.run(&pool, [&](int) {
+        arrived++;
+
+        auto start = chrono::steady_clock::now();
+        while (arrived < 2 && chrono::steady_clock::now() - start < chrono::milliseconds(MEET_MS)) {
+            this_thread::yield();
+        }
+
+        met += arrived == 2;
+    });
+
+    return expect("independent readers run together", scheduler.getDependencies(1).empty()
+            && scheduler.getCriticalPathLength() == 1 && met == 2);
+}
+
+/**
+ * Default access orders a task against all others, also the ones declaring
+ * access to objects it does not know about.
+ */
+static bool checkExclusive(ThreadPool &pool) {
+    int a, b;
+    char tasks[5];
+
+    ProcessorScheduler scheduler;
+    scheduler.add(&tasks[0], ProcessorAccess({}, {&a}));
+    scheduler.add(&tasks[1], ProcessorAccess());
+    scheduler.add(&tasks[2], ProcessorAccess({}, {&b}));
+    scheduler.add(&tasks[3], ProcessorAccess());
+    scheduler.add(&tasks[4], ProcessorAccess());
+
+    // Task 2 does not touch what task 0 writes, it waits for it through 1.
+    bool structure = scheduler.getDependencies(1) == vector<int>({0})
+            && scheduler.getDependencies(2) == vector<int>({1})
+            && scheduler.getDependencies(3) == vector<int>({0, 1, 2})
+            && scheduler.getDependencies(4) == vector<int>({0, 1, 2, 3})
+            && scheduler.getCriticalPathLength() == 5;
+
+    bool serial = true;
+
+    for (int repeat = 0; repeat < REPEATS; repeat++) {
+        mutex orderMutex;
+        vector<int> order;
+        atomic<int> running(0);
+        atomic<int> overlaps(0);
+
+        scheduler.run(&pool, [&](int i) {
+            overlaps += running++ > 0;
+            work();
+            running--;
+
+            lock_guard<mutex> lock(orderMutex);
+            order.push_back(i);
+        });
+
+        serial = serial && overlaps == 0 && order == vector<int>({0, 1, 2, 3, 4});
+    }
+
+    return expect("default access is exclusive", structure && serial);
+}
+
+/**
+ * Task 0 throws, 1 reads what it writes and 2 reads what 1 writes, 3 is
+ * independent of all of them.
+ */
+static bool checkFailure(ThreadPool &pool) {
+    int object, result, other;
+    char tasks[4];
+
+    ProcessorScheduler scheduler;
+    scheduler.add(&tasks[0], ProcessorAccess({}, {&object}));
+    scheduler.add(&tasks[1], ProcessorAccess({&object}, {&result}));
+    scheduler.add(&tasks[2], ProcessorAccess({&result}, {}));
+    scheduler.add(&tasks[3], ProcessorAccess({}, {&other}));
+
+    bool propagated = true, skipped = true;
+
+    for (int repeat = 0; repeat < REPEATS; repeat++) {
+        atomic<int> dependentsRun(0);
+        bool caught = false;
+
+        try {
+            scheduler.run(&pool, [&](int i) {
+                if (i == 0) {
+                    work();
+                    throw string("Task failed on purpose.");
+                }
+
+                if (i == 1 || i == 2) {
+                    dependentsRun++;
+                }
+            });
+        } catch (string &e) {
+            caught = e == "Task failed on purpose.";
+        }
+
+        propagated = propagated && caught;
+        skipped = skipped && dependentsRun == 0;
+    }
+
+    propagated = expect("failed task is rethrown", propagated);
+    skipped = expect("dependents of failed task are skipped", skipped);
+
+    return propagated && skipped;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    ThreadPool pool(THREADS);
+    int failures = 0;
+
+    failures += !checkReadAfterWrite(pool);
+    failures += !checkConcurrentReaders(pool);
+    failures += !checkExclusive(pool);
+    failures += !checkFailure(pool);
+
+    return failures > 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace pgp {
+
+    using std::list;
+    using std::map;
+    using std::string;
+
+    /**
+     * Programs built for a shader, keyed by the hash of their source. Owns
+     * the programs and keeps at most capacity of them, the least recently
+     * put ones are deleted first.
+     */
+    template<typename Program>
+    class ShaderCache {
+    private:
+        map<string, Program*> programs;
+        // Keys from the least to the most recently put.
+        list<string> order;
+        size_t capacity;
+
+    public:
+        ShaderCache(size_t _capacity) : capacity(_capacity) {
+        }
+
+        ShaderCache(const ShaderCache&) = delete;
+        ShaderCache &operator=(const ShaderCache&) = delete;
+
+        ~ShaderCache() {
+            clear();
+        }
+
+        /**
+         * Returns NULL when key is not cached.
+         */
+        Program *find(const string &key) const {
+            auto it = programs.find(key);
+
+            return it == programs.end() ? NULL : it->second;
+        }
+
+        /**
+         * Replaces program of key and makes it the most recent one, so the
+         * program put last is never the one evicted.
+         */
+        void put(const string &key, Program *program) {
+            auto it = programs.find(key);
+
+            if (it != programs.end()) {
+                if (it->second != program) {
+                    delete it->second;
+                }
+
+                order.remove(key);
+            }
+
+            programs[key] = program;
+            order.push_back(key);
+
+            while (programs.size() > capacity && order.size() > 1) {
+                delete programs[order.front()];
+                programs.erase(order.front());
+                order.pop_front();
+            }
+        }
+
+        void clear() {
+            for (auto &p : programs) {
+                delete p.second;
+            }
+
+            programs.clear();
+            order.clear();
+        }
+
+        inline size_t size() const {
+            return programs.size();
+        }
+    };
+
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ShaderPreprocessor.hpp"
+
+using namespace pgp;
+using namespace std;
+
+ShaderPreprocessor::ShaderPreprocessor() : loader(readFile) {
+}
+
+void ShaderPreprocessor::define(const string &name, const string &value) {
+    defines[name] = value;
+}
+
+void ShaderPreprocessor::define(const string &name, int value) {
+    define(name, to_string(value));
+}
+
+void ShaderPreprocessor::define(const string &name, float value) {
+    char buffer[32];
+    snprintf(buffer, sizeof (buffer), "%.9g", value);
+
+    string s = buffer;
+    if (s.find_first_of(".eEn") == string::npos) {
+        s += ".0";
+    }
+
+    define(name, s);
+}
+
+string ShaderPreprocessor::process(const string &filename, vector<string> *files) const {
+    vector<string> stack, included;
+    string body;
+
+    include(filename, stack, included, body);
+
+    // #version has to come first, defines go right after it.
+    size_t start = body.find_first_not_of(" \t\r\n");
+    if (start == string::npos || body.compare(start, 8, "#version") != 0) {
+        throw string("Shader '" + filename + "' does not start with #version.");
+    }
+
+    size_t end = body.find('\n', start);
+    end = end == string::npos ? body.size() : end + 1;
+
+    string out = body.substr(0, end);
+
+    for (const auto &d : defines) {
+        out += "#define " + d.first + " " + d.second + "\n";
+    }
+
+    // Lines before #version are whitespace.
+    int versionLine = count(body.begin(), body.begin() + end, '\n');
+    out += "#line " + to_string(versionLine + 1) + " 0\n";
+    out += body.substr(end);
+
+    if (files) {
+        *files = included;
+    }
+
+    return out;
+}
+
+void ShaderPreprocessor::include(const string &filename, vector<string> &stack, vector<string> &files, string &out) const {
+    if (find(stack.begin(), stack.end(), filename) != stack.end()) {
+        throw string("Shader include cycle at '" + filename + "'.");
+    }
+
+    if (find(files.begin(), files.end(), filename) != files.end()) {
+        return;
+    }
+
+    int index = files.size();
+    files.push_back(filename);
+    stack.push_back(filename);
+
+    istringstream in(loader(filename));
+    string line;
+    int number = 0;
+
+    while (getline(in, line)) {
+        number++;
+
+        size_t p = line.find_first_not_of(" \t");
+
+        if (p == string::npos || line.compare(p, 8, "#include") != 0) {
+            out += line + "\n";
+            continue;
+        }
+
+        size_t open = line.find('"', p + 8);
+        size_t close = open == string::npos ? open : line.find('"', open + 1);
+
+        if (close == string::npos) {
+            throw string("Bad #include in '" + filename + "' on line " + to_string(number) + ".");
+        }
+
+        string path = getDirectory(filename) + line.substr(open + 1, close - open - 1);
+
+        if (find(files.begin(), files.end(), path) != files.end() && find(stack.begin(), stack.end(), path) == stack.end()) {
+            out += "\n";
+            continue;
+        }
+
+        out += "#line 1 " + to_string(files.size()) + "\n";
+        include(path, stack, files, out);
+        out += "#line " + to_string(number + 1) + " " + to_string(index) + "\n";
+    }
+
+    stack.pop_back();
+}
+
+string ShaderPreprocessor::readFile(const string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        throw string("Could not load file '" + filename + "'.");
+    }
+
+    // One read of the whole file, the size is only a hint when the file is
+    // being rewritten.
+    string contents(info.st_size, '\0');
+    size_t length = 0;
+    ssize_t count;
+
+    while ((count = read(fd, &contents[length], contents.size() - length)) > 0) {
+        length += count;
+
+        if (length == contents.size()) {
+            contents.resize(contents.size() * 2 + 4096);
+        }
+    }
+
+    close(fd);
+
+    if (count < 0) {
+        throw string("Could not load file '" + filename + "'.");
+    }
+
+    contents.resize(length);
+
+    return contents;
+}
+
+uint64_t ShaderPreprocessor::hash(const string &source) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+
+    for (unsigned char c : source) {
+        h = (h ^ c) * 1099511628211ull;
+    }
+
+    return h;
+}
+
+string ShaderPreprocessor::getDirectory(const string &filename) {
+    size_t slash = filename.rfind('/');
+
+    return slash == string::npos ? "" : filename.substr(0, slash + 1);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pgp {
+
+    using std::map;
+    using std::string;
+    using std::vector;
+
+    /**
+     * Prepares GLSL source for compilation without touching GL.
+     *
+     * Lines #include "file" are replaced by the file, resolved relative to
+     * the including one; every file is included once. Defines are inserted
+     * right after #version, so a shader can give defaults by #ifndef and
+     * each set of defines yields a specialized permutation. #line directives
+     * keep compiler messages pointing to the original files, source string
+     * number is the index in getFiles().
+     */
+    class ShaderPreprocessor {
+    public:
+        typedef std::function<string(const string&)> Loader;
+
+    private:
+        map<string, string> defines;
+        Loader loader;
+
+    public:
+        /**
+         * Reads files from disk, throws string when a file is missing.
+         */
+        ShaderPreprocessor();
+
+        /**
+         * Source of files, e.g. in-memory sources for tests.
+         */
+        inline void setLoader(const Loader &_loader) {
+            loader = _loader;
+        }
+
+        void define(const string &name, const string &value);
+        void define(const string &name, int value);
+
+        /**
+         * Always written with a decimal point, so it stays float in GLSL.
+         */
+        void define(const string &name, float value);
+
+        inline const map<string, string> &getDefines() const {
+            return defines;
+        }
+
+        /**
+         * Returns the complete source. Files, if given, receives paths of all
+         * read files in the order of their source string numbers. Throws
+         * string on missing file, include cycle or source without #version.
+         */
+        string process(const string &filename, vector<string> *files = NULL) const;
+
+        /**
+         * Reads the whole file at once.
+         */
+        static string readFile(const string &filename);
+
+        /**
+         * 64-bit FNV-1a of source, identifies a processed source including
+         * its defines.
+         */
+        static uint64_t hash(const string &source);
+
+    private:
+        void include(const string &filename, vector<string> &stack, vector<string> &files, string &out) const;
+
+        static string getDirectory(const string &filename);
+    };
+
+}
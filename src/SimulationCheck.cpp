@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SimulationThread.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks that SimulationThread decouples frames from the cost of a tick.
+ *
+ * A render loop of RENDER_MS frames reads snapshots while ticks take from
+ * much less to much more than a frame. Reading a snapshot, the only point
+ * where the loop meets the simulation, may never take longer than
+ * SNAPSHOT_BOUND_MS and the median frame has to stay near RENDER_MS, so the
+ * frame rate does not follow the ticks. Snapshot time must never go back
+ * and ticks have to keep running. A tick that throws has to be rethrown by
+ * stop() even when no snapshot was taken after it. Needs no window or GL
+ * context. Exits with non-zero code on any failure.
+ */
+
+#define STEP (1.0f / 60)
+#define FRAME_COUNT 200
+#define RENDER_MS 5
+#define SNAPSHOT_BOUND_MS 5.0
+// Median frame may exceed RENDER_MS by this, sleeps overshoot.
+#define FRAME_SLACK_MS 3.0
+
+/**
+ * Moves the camera with time, taking cost ms per tick. Throws at tick
+ * failAt when it is not negative.
+ */
+class SlowProcessor : public IProcessor {
+    Camera *camera;
+    int cost;
+    int failAt;
+    int ticks;
+
+public:
+    SlowProcessor(Camera *_camera, int _cost, int _failAt = -1) :
+        camera(_camera), cost(_cost), failAt(_failAt), ticks(0) {
+    }
+
+    virtual void step(float time, float) {
+        if (ticks++ == failAt) {
+            throw string("Tick failed on purpose.");
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(cost));
+        camera->setPose(vec3(time, 0, 0), vec2(0, 0));
+    }
+};
+
+static bool checkDecoupling(int tickCost) {
+    Camera camera(ivec2(100, 100));
+    SlowProcessor processor(&camera, tickCost);
+    SimulationThread simulation(&camera, STEP);
+    simulation.registerProcessor(&processor, ProcessorAccess({}, {&camera}));
+    simulation.start();
+
+    vector<double> frames;
+    double worstSnapshot = 0;
+    float last = -1;
+    int backwards = 0;
+
+    for (int frame = 0; frame < FRAME_COUNT; frame++) {
+        auto start = chrono::steady_clock::now();
+
+        SimulationSnapshot s = simulation.getSnapshot();
+        backwards += s.time < last;
+        last = s.time;
+
+        double snapshotMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        worstSnapshot = std::max(worstSnapshot, snapshotMs);
+
+        // Rendering.
+        this_thread::sleep_for(chrono::milliseconds(RENDER_MS));
+
+        frames.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    simulation.stop();
+
+    nth_element(frames.begin(), frames.begin() + frames.size() / 2, frames.end());
+    double median = frames[frames.size() / 2];
+
+    unsigned long ticks = simulation.getTickCount();
+    bool ok = worstSnapshot <= SNAPSHOT_BOUND_MS && median <= RENDER_MS + FRAME_SLACK_MS
+            && backwards == 0 && ticks > 1;
+
+    printf("Tick cost %d ms: median frame %.1f ms, snapshot %.2f ms at most, %lu ticks, %lu skipped, "
+            "time went back %d times%s\n", tickCost, median, worstSnapshot, ticks, simulation.getSkippedTicks(),
+            backwards, ok ? "" : "  FAILED");
+
+    return ok;
+}
+
+static bool checkFailure() {
+    Camera camera(ivec2(100, 100));
+    SlowProcessor processor(&camera, 0, 3);
+    SimulationThread simulation(&camera, STEP);
+    simulation.registerProcessor(&processor, ProcessorAccess({}, {&camera}));
+    simulation.start();
+
+    // No snapshot is taken after the failing tick.
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    try {
+        simulation.stop();
+    } catch (string &e) {
+        printf("Failed tick rethrown by stop(): %s\n", e.c_str());
+        return true;
+    }
+
+    printf("Failed tick not rethrown by stop()  FAILED\n");
+
+    return false;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+
+    for (int cost : {1, 10, 40}) {
+        failures += !checkDecoupling(cost);
+    }
+
+    failures += !checkFailure();
+
+    return failures > 0;
+}
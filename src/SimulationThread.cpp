@@ -0,0 +1,139 @@
+#include <algorithm>
+
+#include "SimulationThread.hpp"
+
+// Ticks the simulation may lag behind the wall clock before skipping.
+#define MAX_CATCH_UP 5
+
+using namespace pgp;
+using namespace std;
+
+SimulationSnapshot SimulationSnapshot::interpolate(const SimulationSnapshot &a, const SimulationSnapshot &b, float factor) {
+    SimulationSnapshot s;
+    s.tick = factor < 1 ? a.tick : b.tick;
+    s.time = glm::mix(a.time, b.time, factor);
+    s.position = glm::mix(a.position, b.position, factor);
+    s.rotation = glm::mix(a.rotation, b.rotation, factor);
+
+    return s;
+}
+
+SimulationThread::SimulationThread(Camera *_camera, float _step, FrameProfiler *profiler) :
+    RegistrablesContainer(profiler), camera(_camera), step(_step), stopFlag(false), skippedTicks(0) {
+}
+
+SimulationThread::~SimulationThread() {
+    stopFlag = true;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void SimulationThread::start() {
+    tick(0);
+
+    lock_guard<std::mutex> lock(mutex);
+    previous = latest;
+
+    stopFlag = false;
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    stopFlag = true;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void SimulationThread::postEvent(const SDL_Event &evt) {
+    lock_guard<std::mutex> lock(mutex);
+    events.push_back(evt);
+}
+
+SimulationSnapshot SimulationThread::getSnapshot() {
+    lock_guard<std::mutex> lock(mutex);
+
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    // Latest tick is reached one step after it was published.
+    float factor = chrono::duration<float>(clock::now() - latestPublished).count() / step;
+
+    return SimulationSnapshot::interpolate(previous, latest, std::min(std::max(factor, 0.0f), 1.0f));
+}
+
+unsigned long SimulationThread::getTickCount() {
+    lock_guard<std::mutex> lock(mutex);
+    return latest.tick + 1;
+}
+
+unsigned long SimulationThread::getSkippedTicks() {
+    lock_guard<std::mutex> lock(mutex);
+    return skippedTicks;
+}
+
+void SimulationThread::run() {
+    clock::duration stepDuration = chrono::duration_cast<clock::duration>(chrono::duration<float>(step));
+    clock::time_point next = clock::now() + stepDuration;
+    unsigned long index = 1;
+
+    try {
+        while (!stopFlag) {
+            this_thread::sleep_until(next);
+
+            tick(index++);
+            next += stepDuration;
+
+            clock::time_point now = clock::now();
+            if (now - next > stepDuration * MAX_CATCH_UP) {
+                unsigned long skipped = (now - next) / stepDuration;
+                next += stepDuration * skipped;
+
+                lock_guard<std::mutex> lock(mutex);
+                skippedTicks += skipped;
+            }
+        }
+    } catch (...) {
+        lock_guard<std::mutex> lock(mutex);
+        error = current_exception();
+    }
+}
+
+void SimulationThread::tick(unsigned long index) {
+    vector<SDL_Event> pending;
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        pending.swap(events);
+    }
+
+    for (SDL_Event &evt : pending) {
+        for (IEventListener *listener : eventListenerList) {
+            if (listener->onEvent(&evt) == IEventListener::EVT_DROPPED) {
+                break;
+            }
+        }
+    }
+
+    float time = index * step;
+    runProcessors(time, step);
+
+    SimulationSnapshot s;
+    s.tick = index;
+    s.time = time;
+    s.position = camera->getPosition();
+    s.rotation = camera->getRotation();
+
+    lock_guard<std::mutex> lock(mutex);
+    previous = latest;
+    latest = s;
+    latestPublished = clock::now();
+}
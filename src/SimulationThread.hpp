@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+#include <glm/glm.hpp>
+
+#include "Camera.hpp"
+#include "RegistrablesContainer.hpp"
+
+namespace pgp {
+
+    using std::vector;
+    using glm::vec2;
+    using glm::vec3;
+
+    /**
+     * State of the simulation after one tick. Renderers get copies, the
+     * simulation never changes a published snapshot.
+     */
+    struct SimulationSnapshot {
+        unsigned long tick;
+        float time;
+        vec3 position;
+        vec2 rotation;
+
+        static SimulationSnapshot interpolate(const SimulationSnapshot &a, const SimulationSnapshot &b, float factor);
+    };
+
+    /**
+     * Runs its processors on a separate thread with fixed time step and
+     * publishes camera pose and time after every tick.
+     *
+     * Events come from the thread polling SDL through postEvent() and are
+     * passed to the listeners before the next tick. The render thread reads
+     * getSnapshot(), which interpolates between the last two ticks, so the
+     * frame rate does not depend on the cost of a tick and motion stays
+     * smooth when they differ.
+     *
+     * Ticks follow the wall clock. When the simulation falls behind by more
+     * than a few ticks it skips the lost time instead of catching up.
+     */
+    class SimulationThread : public RegistrablesContainer {
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        Camera *camera;
+        float step;
+
+        std::thread thread;
+        std::atomic<bool> stopFlag;
+        std::exception_ptr error;
+
+        // Guards everything below.
+        std::mutex mutex;
+        vector<SDL_Event> events;
+        SimulationSnapshot previous, latest;
+        clock::time_point latestPublished;
+        unsigned long skippedTicks;
+
+    public:
+        /**
+         * Pose of camera is published, camera should be moved only by the
+         * registered processors.
+         */
+        SimulationThread(Camera *camera, float step, FrameProfiler *profiler = NULL);
+        ~SimulationThread();
+
+        /**
+         * Runs the first tick on the calling thread, so a snapshot exists once
+         * this returns, and starts the thread.
+         */
+        void start();
+
+        /**
+         * Waits for the running tick. Rethrows exception of a failed tick.
+         */
+        void stop();
+
+        void postEvent(const SDL_Event &evt);
+
+        /**
+         * Pose between the last two ticks, one step behind the simulation.
+         * Rethrows exception of a failed tick.
+         */
+        SimulationSnapshot getSnapshot();
+
+        inline float getStep() const {
+            return step;
+        }
+
+        unsigned long getTickCount();
+
+        unsigned long getSkippedTicks();
+
+    private:
+        void run();
+
+        void tick(unsigned long index);
+    };
+
+}
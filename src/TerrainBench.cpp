@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "ClipmapTerrain.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Compares clipmap terrain with flat grid of the same resolution.
+ *
+ * For growing number of clipmap levels prints covered width, vertex and
+ * index counts and build time of both. Flat grid is generated from chunks
+ * up to FLAT_MAX_VERTICES, larger ones are only counted. Also checks that
+ * every odd vertex on level borders lies on the coarse edge next to it
+ * and exits with non-zero code when it does not.
+ */
+
+#define MAX_LEVELS 8
+#define FLAT_MAX_VERTICES 5000000
+#define SEAM_TOLERANCE 1e-3f
+
+static double seconds(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static double flatGridTime(int quads, ThreadPool &pool) {
+    int chunks = (quads + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    auto start = chrono::steady_clock::now();
+
+    pool.run(chunks * chunks, [&](unsigned i) {
+        vector<float> heightmap((CHUNK_SIZE + 1) * (CHUNK_SIZE + 1));
+        vector<TerrainVertex> vertices(CHUNK_SIZE * CHUNK_SIZE);
+
+        TerrainGenerator::generateChunk(ivec2(i % chunks, i / chunks), &heightmap[0], &vertices[0]);
+    });
+
+    return seconds(start);
+}
+
+static float seamError(const ClipmapTerrain &clipmap, int levels, vec3 position, const TerrainMesh &mesh) {
+    map<pair<int, int>, float> heights;
+
+    for (const TerrainVertex &v : mesh.vertices) {
+        heights[make_pair(int(lround(v.position.x / RESOLUTION)), int(lround(v.position.z / RESOLUTION)))] = v.position.y;
+    }
+
+    auto heightAt = [&](int x, int z) {
+        auto it = heights.find(make_pair(x, z));
+        return it == heights.end() ? NAN : it->second;
+    };
+
+    float error = 0;
+
+    for (int level = 0; level < levels - 1; level++) {
+        int unit = 1 << level;
+        ivec2 origin = clipmap.getLevelOrigin(position, level);
+
+        for (int i = 1; i < CLIPMAP_SIZE; i += 2) {
+            ivec2 border[4][2] = {
+                {ivec2(0, i), ivec2(0, 1)},
+                {ivec2(CLIPMAP_SIZE, i), ivec2(0, 1)},
+                {ivec2(i, 0), ivec2(1, 0)},
+                {ivec2(i, CLIPMAP_SIZE), ivec2(1, 0)},
+            };
+
+            for (auto &b : border) {
+                ivec2 p = origin + b[0] * unit;
+                ivec2 d = b[1] * unit;
+                float edge = (heightAt(p.x - d.x, p.y - d.y) + heightAt(p.x + d.x, p.y + d.y)) * 0.5f;
+                float diff = fabsf(heightAt(p.x, p.y) - edge);
+
+                // NaN marks missing vertex.
+                error = diff == diff ? max(error, diff) : INFINITY;
+            }
+        }
+    }
+
+    return error;
+}
+
+int main() {
+    ThreadPool pool;
+    vec3 position(123.4f, 0, -567.8f);
+    int result = 0;
+
+    printf("%-6s %10s %12s %12s %10s %12s %12s %10s %10s\n", "levels", "width",
+            "lod verts", "lod indices", "lod ms", "flat verts", "flat indices", "flat ms", "seam err");
+
+    for (int levels = 1; levels <= MAX_LEVELS; levels++) {
+        ClipmapTerrain clipmap(&pool, levels);
+        TerrainMesh mesh;
+
+        auto start = chrono::steady_clock::now();
+        clipmap.build(position, mesh);
+        double lodTime = seconds(start);
+
+        int quads = int(ceilf(clipmap.getExtent() / RESOLUTION));
+        double flatVertices = double(quads + 1) * (quads + 1);
+        double flatIndices = 2.0 * (quads + 1) * quads + quads;
+
+        char flatTime[32] = "-";
+        if (flatVertices <= FLAT_MAX_VERTICES) {
+            snprintf(flatTime, sizeof flatTime, "%.1f", flatGridTime(quads, pool) * 1000);
+        }
+
+        float error = seamError(clipmap, levels, position, mesh);
+        if (!(error <= SEAM_TOLERANCE)) {
+            result = 1;
+        }
+
+        printf("%-6d %10.0f %12zu %12zu %10.1f %12.0f %12.0f %10s %10g\n", levels, clipmap.getExtent(),
+                mesh.vertices.size(), mesh.indices.size(), lodTime * 1000, flatVertices, flatIndices, flatTime, error);
+    }
+
+    if (result) {
+        printf("Seam error exceeds tolerance %g\n", SEAM_TOLERANCE);
+    }
+
+    return result;
+}
@@ -0,0 +1,102 @@
+#include "TerrainBuilder.hpp"
+#include "TerrainGenerator.hpp"
+
+using namespace pgp;
+using namespace std;
+
+// Camera distance from the drawn terrain center that starts a new build.
+#define REBUILD_DISTANCE 15.0f
+
+TerrainBuilder::TerrainBuilder(ITerrainSource *_source) : source(_source), state(IDLE), stopFlag(false) {
+
+    worker = thread(&TerrainBuilder::workerLoop, this);
+}
+
+TerrainBuilder::~TerrainBuilder() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+    condition.notify_all();
+
+    worker.join();
+}
+
+bool TerrainBuilder::request(vec3 position) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+
+        if (state != IDLE) {
+            return false;
+        }
+
+        center = position;
+        state = BUILDING;
+    }
+    condition.notify_all();
+
+    return true;
+}
+
+void TerrainBuilder::follow(vec3 drawnCenter, vec3 position) {
+    if (distance(drawnCenter, position) > REBUILD_DISTANCE) {
+        request(position);
+    }
+}
+
+bool TerrainBuilder::swapIfReady(const function<void()> &swap) {
+    if (!isReady()) {
+        return false;
+    }
+
+    swap();
+    release();
+
+    return true;
+}
+
+void TerrainBuilder::wait() {
+    unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] {
+        return state != BUILDING;
+    });
+}
+
+void TerrainBuilder::release() {
+    lock_guard<std::mutex> lock(mutex);
+
+    if (state == READY) {
+        state = IDLE;
+    }
+}
+
+void TerrainBuilder::workerLoop() {
+    for (;;) {
+        {
+            unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] {
+                return stopFlag || state == BUILDING;
+            });
+
+            if (stopFlag) {
+                return;
+            }
+        }
+
+        // Owner touches neither center nor buffers until the state is READY.
+        source->build(center, mesh);
+
+        if (mesh.isGrid()) {
+            heights.build(&mesh.heightmap[0], ivec2(HEIGHTMAP_SIZE),
+                    vec2(TerrainGenerator::getGridOrigin(center)) * float(RESOLUTION), RESOLUTION);
+        } else {
+            heights.clear();
+        }
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            state = READY;
+        }
+        condition.notify_all();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "HeightPyramid.hpp"
+#include "ITerrainSource.hpp"
+
+namespace pgp {
+
+    /**
+     * Builds terrain from ITerrainSource on a background thread.
+     *
+     * Only one build is in flight at a time. Its result stays available until
+     * the owner calls release(), so the owner can copy it to GPU while the
+     * builder sits idle. Neither request() nor isReady() wait for generation.
+     */
+    class TerrainBuilder {
+    public:
+
+        enum State {
+            IDLE,
+            BUILDING,
+            READY,
+        };
+
+    private:
+        ITerrainSource *source;
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<int> state;
+        bool stopFlag;
+
+        vec3 center;
+        TerrainMesh mesh;
+        HeightPyramid heights;
+
+    public:
+        TerrainBuilder(ITerrainSource *source);
+        ~TerrainBuilder();
+
+        /**
+         * Starts a build around position. Returns false when the previous
+         * build is still running or its result was not released yet.
+         */
+        bool request(vec3 position);
+
+        inline bool isReady() {
+            return state == READY;
+        }
+
+        inline bool isIdle() {
+            return state == IDLE;
+        }
+
+        /**
+         * Step of the owner: requests a build around position once it is
+         * far from center of the drawn terrain. Does not wait when a build
+         * is already running, the next step asks again.
+         */
+        void follow(vec3 drawnCenter, vec3 position);
+
+        /**
+         * Render of the owner: when a finished build waits, calls swap, which
+         * takes over the result, and releases it. Never waits for a running
+         * build. Returns whether swap was called.
+         */
+        bool swapIfReady(const std::function<void()> &swap);
+
+        /**
+         * Blocks until the running build finishes. Meant for startup, when
+         * there is no older terrain to show.
+         */
+        void wait();
+
+        /**
+         * Result accessors, valid only while isReady().
+         */
+        inline vec3 getCenter() {
+            return center;
+        }
+
+        inline const TerrainMesh &getMesh() {
+            return mesh;
+        }
+
+        /**
+         * Height queries over the grid heightmap, empty for other meshes.
+         * The owner may swap it out.
+         */
+        inline HeightPyramid &getHeights() {
+            return heights;
+        }
+
+        inline const TerrainStats &getStats() {
+            return source->getStats();
+        }
+
+        void release();
+
+    private:
+        void workerLoop();
+    };
+
+}
@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "TerrainBuilder.hpp"
+
+using namespace std;
+using namespace pgp;
+
+/**
+ * Checks that terrain generation never blocks a frame.
+ *
+ * Builds of the source are held until the check lets them finish, so a
+ * frame that waited for an unfinished build would never end. Every frame
+ * runs what Landscape does, TerrainBuilder::follow() as its step and
+ * TerrainBuilder::swapIfReady() as its render, while the camera flies
+ * fast enough to need a new terrain all the time. Between frames a build
+ * is let through every FRAMES_PER_BUILD frames, which the next frame has
+ * to swap in. A frame still running after WATCHDOG_S seconds fails the
+ * check. Exits with non-zero code on any failure.
+ */
+
+#define FRAME_COUNT 200
+#define FRAMES_PER_BUILD 8
+#define WATCHDOG_S 10
+// Camera movement per frame, larger than the distance that starts a build.
+#define SPEED 20.0f
+
+/**
+ * Source whose builds finish only when allowed to, builds a single triangle.
+ */
+class GatedSource : public ITerrainSource {
+    TerrainStats stats;
+    mutex gateMutex;
+    condition_variable gate;
+    int allowed;
+
+public:
+    GatedSource() : stats(), allowed(0) {
+    }
+
+    void allow(int builds) {
+        {
+            lock_guard<mutex> lock(gateMutex);
+            allowed += builds;
+        }
+        gate.notify_all();
+    }
+
+    virtual void build(vec3 position, TerrainMesh &mesh) {
+        {
+            unique_lock<mutex> lock(gateMutex);
+            gate.wait(lock, [this] {
+                return allowed > 0;
+            });
+            allowed--;
+        }
+
+        mesh.heightmap.clear();
+        mesh.vertices.resize(3);
+        mesh.indices = {0, 1, 2};
+
+        stats.reloads++;
+    }
+
+    virtual const TerrainStats &getStats() const {
+        return stats;
+    }
+};
+
+static atomic<int> currentFrame(-1);
+static mutex doneMutex;
+static condition_variable doneCondition;
+static bool done = false;
+
+static void watchdog() {
+    unique_lock<mutex> lock(doneMutex);
+
+    if (!doneCondition.wait_for(lock, chrono::seconds(WATCHDOG_S), [] { return done; })) {
+        fprintf(stderr, "Frame %d waited for an unfinished build\n", currentFrame.load());
+        fflush(stderr);
+        _Exit(1);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    thread watchdogThread(watchdog);
+
+    GatedSource source;
+    int failures = 0;
+
+    {
+        TerrainBuilder builder(&source);
+        vec3 position(0, 35, 0), center;
+        int swaps = 0, finished = 0, framesOverBuild = 0;
+        bool swappedUnfinished = false;
+
+        auto swap = [&] {
+            swappedUnfinished = swappedUnfinished || !builder.isReady();
+            center = builder.getCenter();
+            swaps++;
+        };
+
+        // Constructor of Landscape waits for the first terrain.
+        source.allow(1);
+        builder.request(position);
+        builder.wait();
+        builder.swapIfReady(swap);
+        swaps = 0;
+
+        for (int frame = 0; frame < FRAME_COUNT; frame++) {
+            currentFrame = frame;
+            position.z += SPEED;
+
+            // Landscape::step
+            builder.follow(center, position);
+
+            // Landscape::render
+            builder.swapIfReady(swap);
+
+            if (!builder.isIdle() && !builder.isReady()) {
+                framesOverBuild++;
+            }
+
+            // Outside of the frame, the next one has to swap it in.
+            if (frame % FRAMES_PER_BUILD == FRAMES_PER_BUILD - 1 && frame + 1 < FRAME_COUNT
+                    && !builder.isIdle()) {
+                source.allow(1);
+                builder.wait();
+                finished++;
+            }
+        }
+
+        currentFrame = -1;
+
+        printf("%d frames, %d ended with a build unfinished, %d builds finished, %d swapped in\n",
+                FRAME_COUNT, framesOverBuild, finished, swaps);
+
+        int expected = FRAME_COUNT / FRAMES_PER_BUILD - 1;
+
+        if (finished < expected || swaps != finished) {
+            fprintf(stderr, "Expected at least %d builds swapped in right after finishing\n", expected);
+            failures++;
+        }
+
+        if (framesOverBuild < FRAME_COUNT - 2 * finished) {
+            fprintf(stderr, "Builds were not running while frames went on\n");
+            failures++;
+        }
+
+        if (swappedUnfinished) {
+            fprintf(stderr, "Unfinished build was swapped in\n");
+            failures++;
+        }
+
+        // Let a build still requested finish, the builder joins its thread.
+        source.allow(1);
+    }
+
+    {
+        lock_guard<mutex> lock(doneMutex);
+        done = true;
+    }
+    doneCondition.notify_all();
+    watchdogThread.join();
+
+    return failures > 0;
+}
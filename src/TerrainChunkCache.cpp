@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "TerrainChunkCache.hpp"
+
+using namespace pgp;
+using namespace std;
+
+TerrainChunkCache::TerrainChunkCache(ThreadPool *_pool, size_t _capacity) : pool(_pool), capacity(_capacity) {
+    // Grid may start anywhere inside a chunk, so it can touch one more.
+    size_t side = (HEIGHTMAP_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE + 1;
+    capacity = max(capacity, side * side);
+
+    memset(&stats, 0, sizeof stats);
+}
+
+void TerrainChunkCache::build(vec3 position, TerrainMesh &mesh) {
+    auto start = chrono::steady_clock::now();
+
+    mesh.resizeGrid();
+    float *heightmap = &mesh.heightmap[0];
+    TerrainVertex *vertices = &mesh.vertices[0];
+
+    ivec2 origin = TerrainGenerator::getGridOrigin(position);
+    ivec2 first(chunkOf(origin.x), chunkOf(origin.y));
+    ivec2 last(chunkOf(origin.x + HEIGHTMAP_SIZE - 1), chunkOf(origin.y + HEIGHTMAP_SIZE - 1));
+    ivec2 count = last - first + 1;
+
+    vector<TerrainChunk*> grid(count.x * count.y);
+    vector<ivec2> missing;
+
+    for (int i = 0; i < count.x; i++) {
+        for (int j = 0; j < count.y; j++) {
+            ivec2 key = first + ivec2(i, j);
+            auto it = index.find(makeKey(key));
+
+            if (it != index.end()) {
+                chunks.splice(chunks.begin(), chunks, it->second);
+                grid[i * count.y + j] = &chunks.front();
+                stats.hits++;
+            } else {
+                missing.push_back(key);
+            }
+        }
+    }
+
+    vector<TerrainChunk> generated(missing.size());
+
+    auto job = [&](unsigned i) {
+        TerrainChunk &chunk = generated[i];
+
+        chunk.key = missing[i];
+        chunk.heightmap.resize((CHUNK_SIZE + 1) * (CHUNK_SIZE + 1));
+        chunk.vertices.resize(CHUNK_SIZE * CHUNK_SIZE);
+
+        TerrainGenerator::generateChunk(chunk.key, &chunk.heightmap[0], &chunk.vertices[0]);
+    };
+
+    if (pool) {
+        pool->run(generated.size(), job);
+    } else {
+        for (unsigned i = 0; i < generated.size(); i++) {
+            job(i);
+        }
+    }
+
+    for (TerrainChunk &chunk : generated) {
+        chunks.push_front(std::move(chunk));
+        index[makeKey(chunks.front().key)] = chunks.begin();
+
+        ivec2 offset = chunks.front().key - first;
+        grid[offset.x * count.y + offset.y] = &chunks.front();
+    }
+    stats.misses += missing.size();
+
+    // Chunks of this grid are at the front and fit into capacity.
+    while (chunks.size() > capacity) {
+        index.erase(makeKey(chunks.back().key));
+        chunks.pop_back();
+    }
+
+    // Copies rows of the grid from chunks, split where chunk columns end.
+    for (int row = 0; row < HEIGHTMAP_SIZE; row++) {
+        int x = origin.x + row;
+        int cx = chunkOf(x);
+        int localX = x - cx * CHUNK_SIZE;
+
+        for (int col = 0; col < HEIGHTMAP_SIZE;) {
+            int z = origin.y + col;
+            int cz = chunkOf(z);
+            int localZ = z - cz * CHUNK_SIZE;
+            int span = min(CHUNK_SIZE - localZ, HEIGHTMAP_SIZE - col);
+
+            const TerrainChunk *chunk = grid[(cx - first.x) * count.y + (cz - first.y)];
+
+            memcpy(heightmap + row * HEIGHTMAP_SIZE + col,
+                    &chunk->heightmap[localX * (CHUNK_SIZE + 1) + localZ], span * sizeof (float));
+
+            if (row <= LANDSCAPE_SIZE && col <= LANDSCAPE_SIZE) {
+                int vertexSpan = min(span, LANDSCAPE_SIZE + 1 - col);
+
+                memcpy(vertices + row * (LANDSCAPE_SIZE + 1) + col,
+                        &chunk->vertices[localX * CHUNK_SIZE + localZ], vertexSpan * sizeof (TerrainVertex));
+            }
+
+            col += span;
+        }
+    }
+
+    float time = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+
+    stats.reloads++;
+    stats.lastReloadTime = time;
+    stats.totalReloadTime += time;
+}
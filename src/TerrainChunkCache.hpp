@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "ITerrainSource.hpp"
+#include "ThreadPool.hpp"
+
+#define CHUNK_CACHE_SIZE 512
+
+namespace pgp {
+
+    using std::vector;
+
+    typedef struct {
+        ivec2 key;
+        vector<float> heightmap;
+        vector<TerrainVertex> vertices;
+    } TerrainChunk;
+
+    /**
+     * Keeps terrain chunks keyed by chunk coordinates in a bounded LRU cache
+     * and assembles the grid around the camera from them.
+     *
+     * Chunks generated for one position are reused for any other. Only missing chunks are generated, in
+     * parallel on the thread pool. Not thread safe, one build at a time.
+     */
+    class TerrainChunkCache : public ITerrainSource {
+    private:
+        ThreadPool *pool;
+        size_t capacity;
+        // Most recently used chunk first.
+        std::list<TerrainChunk> chunks;
+        std::unordered_map<uint64_t, std::list<TerrainChunk>::iterator> index;
+        TerrainStats stats;
+
+    public:
+        /**
+         * Capacity is raised to the number of chunks one grid needs.
+         */
+        TerrainChunkCache(ThreadPool *pool = NULL, size_t capacity = CHUNK_CACHE_SIZE);
+
+        virtual void build(vec3 position, TerrainMesh &mesh);
+
+        virtual const TerrainStats &getStats() const {
+            return stats;
+        }
+
+        inline size_t getChunkCount() const {
+            return chunks.size();
+        }
+
+        inline size_t getCapacity() const {
+            return capacity;
+        }
+
+    private:
+        static inline uint64_t makeKey(ivec2 chunk) {
+            return (uint64_t(uint32_t(chunk.x)) << 32) | uint32_t(chunk.y);
+        }
+
+        static inline int chunkOf(int lattice) {
+            return lattice >= 0 ? lattice / CHUNK_SIZE : -((CHUNK_SIZE - 1 - lattice) / CHUNK_SIZE);
+        }
+    };
+
+}
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <algorithm>
+
+#include "Noise.hpp"
+#include "TerrainGenerator.hpp"
+
+#define BANDS_PER_THREAD 4
+
+using namespace pgp;
+using namespace glm;
+
+TerrainGenerator::TerrainGenerator(ThreadPool *_pool) : pool(_pool) {
+}
+
+template<typename Band>
+void TerrainGenerator::runBands(int rows, Band band) {
+    int bandCount = pool ? std::min<int>(rows, pool->getThreadCount() * BANDS_PER_THREAD) : 1;
+
+    auto job = [&](unsigned i) {
+        band(rows * i / bandCount, rows * (i + 1) / bandCount);
+    };
+
+    if (pool) {
+        pool->run(bandCount, job);
+    } else {
+        job(0);
+    }
+}
+
+void TerrainGenerator::generate(vec3 position, float *heightmap, TerrainVertex *vertices) {
+    generateHeightmap(position, heightmap);
+    generateVertices(position, heightmap, vertices);
+}
+
+void TerrainGenerator::generateHeightmap(vec3 pos, float *heightmap) {
+    runBands(HEIGHTMAP_SIZE, [&](int first, int last) {
+        float *map = heightmap + first * HEIGHTMAP_SIZE;
+
+        for (int row = first - 1; row < last - 1; row++) {
+            for (int col = -1; col <= LANDSCAPE_SIZE; col++) {
+                float x, z;
+
+                x = ((row - 1) - (LANDSCAPE_SIZEF / 2.0)) * RESOLUTION + pos.x;
+                z = ((col - 1) - (LANDSCAPE_SIZEF / 2.0)) * RESOLUTION + pos.z;
+
+                *map = height(x, z);
+                map++;
+            }
+        }
+    });
+}
+
+void TerrainGenerator::generateVertices(vec3 pos, const float *heightmap, TerrainVertex *vertices) {
+    runBands(LANDSCAPE_SIZE + 1, [&](int first, int last) {
+        TerrainVertex *dataPtr = vertices + first * (LANDSCAPE_SIZE + 1);
+
+        for (int row = first; row < last; row++) {
+            for (int col = 0; col <= LANDSCAPE_SIZE; col++) {
+                TerrainVertex *v = dataPtr++;
+                vec3 a, b, c, d;
+
+                a.x = ((row) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
+                a.y = heightmap[(row) * HEIGHTMAP_SIZE + (col)];
+                a.z = ((col) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
+
+                b.x = ((row + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
+                b.y = heightmap[(row + 1) * HEIGHTMAP_SIZE + (col)];
+                b.z = ((col) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
+
+                c.x = ((row + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
+                c.y = heightmap[(row + 1) * HEIGHTMAP_SIZE + (col + 1)];
+                c.z = ((col + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
+
+                d.x = ((row) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.x;
+                d.y = heightmap[(row) * HEIGHTMAP_SIZE + (col + 1)];
+                d.z = ((col + 1) - (LANDSCAPE_SIZEF / 2)) * RESOLUTION + pos.z;
+
+                quadVertex(a, b, c, d, v);
+            }
+        }
+    });
+}
+
+void TerrainGenerator::generateChunk(ivec2 chunk, float *heightmap, TerrainVertex *vertices) {
+    int x0 = chunk.x * CHUNK_SIZE;
+    int z0 = chunk.y * CHUNK_SIZE;
+
+    for (int row = 0; row <= CHUNK_SIZE; row++) {
+        for (int col = 0; col <= CHUNK_SIZE; col++) {
+            heightmap[row * (CHUNK_SIZE + 1) + col] = latticeHeight(x0 + row, z0 + col);
+        }
+    }
+
+    for (int row = 0; row < CHUNK_SIZE; row++) {
+        for (int col = 0; col < CHUNK_SIZE; col++) {
+            const float *h = heightmap + row * (CHUNK_SIZE + 1) + col;
+
+            latticeVertex(x0 + row, z0 + col, h[0], h[CHUNK_SIZE + 1], h[CHUNK_SIZE + 2], h[1],
+                    &vertices[row * CHUNK_SIZE + col]);
+        }
+    }
+}
+
+void TerrainGenerator::quadVertex(vec3 a, vec3 b, vec3 c, vec3 d, TerrainVertex *v) {
+    vec3 g = (a + b) * 0.5f;
+    vec3 h = (c + d) * 0.5f;
+    v->position = (g + h) * 0.5f;
+
+    a = normalize(a - c);
+    b = normalize(b - d);
+
+    v->normal = normalize(cross(b, a));
+
+    // Calculate color
+    v->color = u8vec3(0, 80, 0); // Color is green, grass is green, what is nice color it is. (Haiku?)
+}
+
+void TerrainGenerator::latticeVertex(int x, int z, float ha, float hb, float hc, float hd, TerrainVertex *v) {
+    vec3 a(x * RESOLUTION, ha, z * RESOLUTION);
+    vec3 b((x + 1) * RESOLUTION, hb, z * RESOLUTION);
+    vec3 c((x + 1) * RESOLUTION, hc, (z + 1) * RESOLUTION);
+    vec3 d(x * RESOLUTION, hd, (z + 1) * RESOLUTION);
+
+    quadVertex(a, b, c, d, v);
+}
+
+ivec2 TerrainGenerator::getGridOrigin(vec3 position) {
+    return ivec2(int(floor(position.x / RESOLUTION + 0.5)), int(floor(position.z / RESOLUTION + 0.5))) - LANDSCAPE_SIZE / 2;
+}
+
+float TerrainGenerator::height(float x, float z) {
+    float y = 0;
+
+    y += parametrizedNoise(x, z, 4.0 / BASE_FREQUENCY, 2.0 / BASE_FREQUENCY, 65.0);
+    y += parametrizedNoise(x + 7769.0, z + 1103.0, 16.0 / BASE_FREQUENCY, 18.0 / BASE_FREQUENCY, 5.0);
+    y += parametrizedNoise(x - 356.0, z + 32776.0, 64.0 / BASE_FREQUENCY, 64.0 / BASE_FREQUENCY, 0.5);
+
+    return y;
+}
+
+float TerrainGenerator::smoothNoise2D(float _x, float _y) {
+    int x0 = floor(_x);
+    int y0 = floor(_y);
+
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    float r[] = { _x - x0, _y - y0 };
+
+    // Corners in the order of Noise<2>.
+    float values[] = {
+        noise2D(x0, y0), noise2D(x1, y0),
+        noise2D(x0, y1), noise2D(x1, y1),
+    };
+
+    return Noise<2>::interpolate(values, r);
+}
+
+float TerrainGenerator::noise2D(int x, int y) {
+    x += 338573;
+    y += 77313501;
+    unsigned int n = ((((x * x) << 3) * 23) + ((y * y) << 1) * 51);
+
+    return NoiseBase::scramble(n);
+}
+
+float TerrainGenerator::interpolateCos(float a, float b, float factor) {
+    return NoiseBase::mixCos(a, b, factor);
+}
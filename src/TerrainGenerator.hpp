@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.hpp"
+
+#define LANDSCAPE_SIZE 350
+#define LANDSCAPE_SIZEF float(LANDSCAPE_SIZE)
+#define HEIGHTMAP_SIZE (LANDSCAPE_SIZE + 2)
+#define BASE_FREQUENCY 100
+#define RESOLUTION 0.85
+#define CHUNK_SIZE 25
+
+namespace pgp {
+
+    using glm::ivec2;
+    using glm::u8vec3;
+    using glm::vec3;
+
+    typedef struct {
+        vec3 position;
+        vec3 normal;
+        u8vec3 color;
+    } TerrainVertex;
+
+    /**
+     * Builds landscape heightmap and vertices around given position.
+     *
+     * Both passes are split into bands of rows processed on the thread pool.
+     * Every value depends only on its own row and column, so the result is
+     * the same for any number of threads.
+     */
+    class TerrainGenerator {
+    private:
+        ThreadPool *pool;
+
+    public:
+        /**
+         * Without pool the terrain is generated on the calling thread.
+         */
+        TerrainGenerator(ThreadPool *pool = NULL);
+
+        /**
+         * Heightmap has HEIGHTMAP_SIZE^2 values,
+         * vertex array has (LANDSCAPE_SIZE + 1)^2 vertices.
+         */
+        void generate(vec3 position, float *heightmap, TerrainVertex *vertices);
+
+        void generateHeightmap(vec3 position, float *heightmap);
+
+        void generateVertices(vec3 position, const float *heightmap, TerrainVertex *vertices);
+
+        /**
+         * Generates one chunk on the calling thread. Chunk covers lattice
+         * points chunk * CHUNK_SIZE up to CHUNK_SIZE further on both axes.
+         * Heightmap has (CHUNK_SIZE + 1)^2 values including the far border,
+         * vertex array has CHUNK_SIZE^2 vertices.
+         */
+        static void generateChunk(ivec2 chunk, float *heightmap, TerrainVertex *vertices);
+
+        /**
+         * Vertex in the middle of quad abcd.
+         */
+        static void quadVertex(vec3 a, vec3 b, vec3 c, vec3 d, TerrainVertex *vertex);
+
+        /**
+         * Vertex of lattice quad starting at x, z. Heights are given for
+         * corners (x, z), (x + 1, z), (x + 1, z + 1) and (x, z + 1).
+         */
+        static void latticeVertex(int x, int z, float ha, float hb, float hc, float hd, TerrainVertex *vertex);
+
+        /**
+         * Lattice coordinates of the first sample of grid around position.
+         * Grids from chunks and ring buffers are aligned to world lattice,
+         * so their samples can be reused at any position.
+         */
+        static ivec2 getGridOrigin(vec3 position);
+
+        static inline float latticeHeight(int x, int z) {
+            return height(x * RESOLUTION, z * RESOLUTION);
+        }
+
+        static float height(float x, float z);
+
+        static inline float parametrizedNoise(float x, float y, float xPeriod, float yPeriod, float amplitude) {
+            return smoothNoise2D(x * xPeriod, y * yPeriod) * amplitude;
+        }
+
+        static float smoothNoise2D(float x, float y);
+
+        static float noise2D(int x, int y);
+
+        static float interpolateCos(float a, float b, float factor);
+
+    private:
+        template<typename Band>
+        void runBands(int rows, Band band);
+    };
+
+}
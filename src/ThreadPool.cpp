@@ -0,0 +1,120 @@
+#include "ThreadPool.hpp"
+
+using namespace pgp;
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threadCount) : job(NULL), jobCount(0), nextJob(0), busyWorkers(0), generation(0), stopFlag(false) {
+    if (threadCount == 0) {
+        threadCount = getHardwareThreads();
+    }
+
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+    wakeCondition.notify_all();
+
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::getHardwareThreads() {
+    unsigned count = thread::hardware_concurrency();
+
+    return count > 0 ? count : 1;
+}
+
+void ThreadPool::run(unsigned count, const function<void(unsigned)> &fn) {
+    if (count == 0) {
+        return;
+    }
+
+    lock_guard<std::mutex> runLock(runMutex);
+
+    if (workers.empty() || count == 1) {
+        for (unsigned i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        nextJob = 0;
+        busyWorkers = workers.size();
+        error = nullptr;
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    work();
+
+    unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] {
+        return busyWorkers == 0;
+    });
+
+    job = NULL;
+
+    if (error) {
+        exception_ptr e = error;
+        error = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        unsigned i = nextJob.fetch_add(1);
+
+        if (i >= jobCount) {
+            break;
+        }
+
+        try {
+            (*job)(i);
+        } catch (...) {
+            lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seenGeneration = 0;
+
+    for (;;) {
+        {
+            unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] {
+                return stopFlag || generation != seenGeneration;
+            });
+
+            if (stopFlag) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        work();
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
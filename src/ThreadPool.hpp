@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pgp {
+
+    using std::vector;
+
+    /**
+     * Fixed set of worker threads executing indexed jobs.
+     *
+     * Calling thread takes part in the work, so pool with N threads spawns
+     * only N - 1 workers.
+     */
+    class ThreadPool {
+    private:
+        vector<std::thread> workers;
+        std::mutex mutex;
+        std::mutex runMutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable doneCondition;
+
+        const std::function<void(unsigned)> *job;
+        unsigned jobCount;
+        std::atomic<unsigned> nextJob;
+        unsigned busyWorkers;
+        uint64_t generation;
+        bool stopFlag;
+        std::exception_ptr error;
+
+    public:
+        /**
+         * Thread count 0 means one thread per hardware thread.
+         */
+        ThreadPool(unsigned threadCount = 0);
+        ~ThreadPool();
+
+        inline unsigned getThreadCount() {
+            return workers.size() + 1;
+        }
+
+        /**
+         * Calls job(0) .. job(jobCount - 1) and waits until all of them finish.
+         * First exception thrown by a job is rethrown here.
+         *
+         * Must not be called from within a job of the same pool.
+         */
+        void run(unsigned jobCount, const std::function<void(unsigned)> &job);
+
+        static unsigned getHardwareThreads();
+
+    private:
+        void work();
+        void workerLoop();
+    };
+
+}
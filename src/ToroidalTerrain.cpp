@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "ToroidalTerrain.hpp"
+
+#define BANDS_PER_THREAD 4
+
+using namespace pgp;
+using namespace std;
+
+ToroidalTerrain::ToroidalTerrain(ThreadPool *_pool) : pool(_pool),
+    heightmap(HEIGHTMAP_SIZE * HEIGHTMAP_SIZE), vertices((LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1)), origin(0), valid(false) {
+
+    memset(&stats, 0, sizeof stats);
+}
+
+void ToroidalTerrain::build(vec3 position, TerrainMesh &mesh) {
+    auto start = chrono::steady_clock::now();
+
+    ivec2 next = TerrainGenerator::getGridOrigin(position);
+    vector<Span> spans;
+
+    newSpans(origin, next, HEIGHTMAP_SIZE, !valid, spans);
+
+    unsigned long generated = 0;
+    for (const Span &span : spans) {
+        generated += span.last - span.first;
+    }
+
+    runSpans(spans, [&](int x, int z) {
+        heightmap[wrap(x, HEIGHTMAP_SIZE) * HEIGHTMAP_SIZE + wrap(z, HEIGHTMAP_SIZE)] = TerrainGenerator::latticeHeight(x, z);
+    });
+
+    // Quad of an old vertex has only old samples, which did not change.
+    newSpans(origin, next, LANDSCAPE_SIZE + 1, !valid, spans);
+
+    runSpans(spans, [&](int x, int z) {
+        int x0 = wrap(x, HEIGHTMAP_SIZE) * HEIGHTMAP_SIZE;
+        int x1 = wrap(x + 1, HEIGHTMAP_SIZE) * HEIGHTMAP_SIZE;
+        int z0 = wrap(z, HEIGHTMAP_SIZE);
+        int z1 = wrap(z + 1, HEIGHTMAP_SIZE);
+
+        TerrainGenerator::latticeVertex(x, z, heightmap[x0 + z0], heightmap[x1 + z0], heightmap[x1 + z1], heightmap[x0 + z1],
+                &vertices[wrap(x, LANDSCAPE_SIZE + 1) * (LANDSCAPE_SIZE + 1) + wrap(z, LANDSCAPE_SIZE + 1)]);
+    });
+
+    origin = next;
+    valid = true;
+
+    mesh.resizeGrid();
+    unwrap(heightmap, origin, HEIGHTMAP_SIZE, &mesh.heightmap[0]);
+    unwrap(vertices, origin, LANDSCAPE_SIZE + 1, &mesh.vertices[0]);
+
+    float time = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+
+    stats.hits += HEIGHTMAP_SIZE * HEIGHTMAP_SIZE - generated;
+    stats.misses += generated;
+    stats.reloads++;
+    stats.lastReloadTime = time;
+    stats.totalReloadTime += time;
+}
+
+void ToroidalTerrain::newSpans(ivec2 from, ivec2 to, int size, bool all, vector<Span> &spans) {
+    spans.clear();
+
+    ivec2 shift = to - from;
+
+    if (all || abs(shift.x) >= size || abs(shift.y) >= size) {
+        for (int x = to.x; x < to.x + size; x++) {
+            spans.push_back({x, to.y, to.y + size});
+        }
+        return;
+    }
+
+    // Columns entering the grid on rows which stay.
+    int first = shift.y > 0 ? from.y + size : to.y;
+    int last = shift.y > 0 ? to.y + size : from.y;
+
+    for (int x = to.x; x < to.x + size; x++) {
+        if (x < from.x || x >= from.x + size) {
+            spans.push_back({x, to.y, to.y + size});
+        } else if (first < last) {
+            spans.push_back({x, first, last});
+        }
+    }
+}
+
+template<typename Point>
+void ToroidalTerrain::runSpans(const vector<Span> &spans, Point point) {
+    if (spans.empty()) {
+        return;
+    }
+
+    int bandCount = pool ? min<int>(spans.size(), pool->getThreadCount() * BANDS_PER_THREAD) : 1;
+
+    auto job = [&](unsigned i) {
+        for (size_t s = spans.size() * i / bandCount; s < spans.size() * (i + 1) / bandCount; s++) {
+            for (int z = spans[s].first; z < spans[s].last; z++) {
+                point(spans[s].x, z);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->run(bandCount, job);
+    } else {
+        job(0);
+    }
+}
+
+template<typename T>
+void ToroidalTerrain::unwrap(const vector<T> &ring, ivec2 origin, int size, T *out) {
+    int split = size - wrap(origin.y, size);
+
+    for (int row = 0; row < size; row++) {
+        const T *in = &ring[wrap(origin.x + row, size) * size];
+
+        memcpy(out, in + size - split, split * sizeof (T));
+        memcpy(out + split, in, (size - split) * sizeof (T));
+        out += size;
+    }
+}
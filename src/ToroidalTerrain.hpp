@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "ITerrainSource.hpp"
+#include "ThreadPool.hpp"
+
+namespace pgp {
+
+    using std::vector;
+
+    /**
+     * Keeps heightmap and vertices of the grid in ring buffers which scroll
+     * with the camera.
+     *
+     * Lattice point x, z is stored at x mod size, z mod size, so after a move
+     * only strips entering the grid are evaluated, with cost proportional to
+     * the distance travelled. Vertices are recomputed only for new quads
+     * along the same border. Stats count height samples.
+     */
+    class ToroidalTerrain : public ITerrainSource {
+    private:
+        ThreadPool *pool;
+        vector<float> heightmap;
+        vector<TerrainVertex> vertices;
+        ivec2 origin;
+        bool valid;
+        TerrainStats stats;
+
+        /**
+         * Run of lattice points on row x, from column first to last - 1.
+         */
+        typedef struct {
+            int x;
+            int first;
+            int last;
+        } Span;
+
+    public:
+        ToroidalTerrain(ThreadPool *pool = NULL);
+
+        virtual void build(vec3 position, TerrainMesh &mesh);
+
+        virtual const TerrainStats &getStats() const {
+            return stats;
+        }
+
+    private:
+        /**
+         * Spans of square size^2 at to, which are not in the one at from.
+         */
+        static void newSpans(ivec2 from, ivec2 to, int size, bool all, vector<Span> &spans);
+
+        template<typename Point>
+        void runSpans(const vector<Span> &spans, Point point);
+
+        static inline int wrap(int x, int size) {
+            x %= size;
+            return x < 0 ? x + size : x;
+        }
+
+        /**
+         * Copies ring of size^2 items starting at origin into linear array.
+         */
+        template<typename T>
+        static void unwrap(const vector<T> &ring, ivec2 origin, int size, T *out);
+    };
+
+}